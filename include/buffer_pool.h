@@ -0,0 +1,246 @@
+#pragma once
+
+#include "error.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+/* Statistics of a `BufferPool`. A hit is a request served by a recycled
+   buffer and a miss is a request that had to allocate a new one. */
+struct BufferPoolStatistics
+{
+    uint64_t nof_hits;
+    uint64_t nof_misses;
+    uint64_t nof_discarded;
+    size_t nof_buffers_held;
+    size_t bytes_held;
+    size_t capacity;
+};
+
+/* This class recycles heap-allocated objects of type `T`. The buffers are
+   handed out as `std::shared_ptr<T>` whose deleter returns the object to the
+   pool once the last reference is dropped, wherever that happens. Returned
+   buffers are kept in free lists bucketed by their size in bytes, holding at
+   most `capacity` buffers in total. Buffers beyond that are freed, so the
+   memory held by the pool is a few buffers' worth of whatever size is in use.
+   A bucket that hasn't been requested in the last `capacity` requests is
+   stale, e.g. after a change of record length, and its buffers are freed. The
+   buffer pool may be destroyed before the buffers it has handed out, which
+   are then freed instead of recycled.
+
+   An optional `recycle` function is called with each returned buffer before
+   it's put back into the free list, e.g. to release any resources it refers
+   to. Otherwise, the caller is responsible for resetting the contents of a
+   recycled buffer. */
+template <typename T>
+class BufferPool
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 4;
+
+    BufferPool(size_t capacity = DEFAULT_CAPACITY, std::function<void(T &)> recycle = {})
+        : m_state{std::make_shared<State>()}
+    {
+        m_state->capacity = capacity;
+        m_state->recycle = std::move(recycle);
+    }
+
+    /* Delete copy constructors. */
+    BufferPool(const BufferPool &other) = delete;
+    BufferPool &operator=(const BufferPool &other) = delete;
+
+    /* Get a buffer of `size` bytes, reusing a returned one if possible. The
+       `args` are passed on to the constructor if we have to allocate a new
+       buffer. */
+    template <typename... Args>
+    int Get(std::shared_ptr<T> &buffer, size_t size, Args &&... args)
+    {
+        std::unique_ptr<T> object{};
+        std::map<size_t, Bucket> discarded{};
+        try
+        {
+            std::unique_lock lock{m_state->mutex};
+            auto &bucket = m_state->buckets[size];
+            bucket.last_request = ++m_state->nof_requests;
+            if (!bucket.buffers.empty())
+            {
+                object = std::move(bucket.buffers.back());
+                bucket.buffers.pop_back();
+                m_state->bytes_held -= size;
+                m_state->nof_buffers_held--;
+                m_state->nof_hits++;
+            }
+            else
+            {
+                m_state->nof_misses++;
+            }
+
+            DiscardStaleBuckets(discarded);
+        }
+        catch (const std::bad_alloc &)
+        {
+            return SCAPE_EINTERNAL;
+        }
+
+        try
+        {
+            if (object == NULL)
+                object = std::make_unique<T>(std::forward<Args>(args)...);
+
+            /* The deleter takes care of the object if this throws. */
+            buffer = std::shared_ptr<T>(object.release(), Recycler{m_state, size});
+            return SCAPE_EOK;
+        }
+        catch (const std::bad_alloc &)
+        {
+            return SCAPE_EINTERNAL;
+        }
+    }
+
+    /* Set the maximum number of buffers held by the pool, freeing buffers if
+       we're currently above the new limit. */
+    void SetCapacity(size_t capacity)
+    {
+        std::vector<std::unique_ptr<T>> discarded{};
+        {
+            std::unique_lock lock{m_state->mutex};
+            m_state->capacity = capacity;
+
+            /* Trim the least recently requested buckets first. */
+            while (m_state->nof_buffers_held > capacity)
+            {
+                auto oldest = m_state->buckets.end();
+                for (auto it = m_state->buckets.begin(); it != m_state->buckets.end(); ++it)
+                {
+                    if (!it->second.buffers.empty() &&
+                        (oldest == m_state->buckets.end() ||
+                         it->second.last_request < oldest->second.last_request))
+                    {
+                        oldest = it;
+                    }
+                }
+
+                discarded.emplace_back(std::move(oldest->second.buffers.back()));
+                oldest->second.buffers.pop_back();
+                m_state->bytes_held -= oldest->first;
+                m_state->nof_buffers_held--;
+                m_state->nof_discarded++;
+            }
+        }
+    }
+
+    /* Free every buffer held by the pool. */
+    void Clear()
+    {
+        decltype(m_state->buckets) discarded{};
+        {
+            std::unique_lock lock{m_state->mutex};
+            std::swap(discarded, m_state->buckets);
+            m_state->nof_discarded += m_state->nof_buffers_held;
+            m_state->bytes_held = 0;
+            m_state->nof_buffers_held = 0;
+        }
+    }
+
+    BufferPoolStatistics GetStatistics() const
+    {
+        std::unique_lock lock{m_state->mutex};
+        return {m_state->nof_hits,         m_state->nof_misses, m_state->nof_discarded,
+                m_state->nof_buffers_held, m_state->bytes_held, m_state->capacity};
+    }
+
+private:
+    struct Bucket
+    {
+        std::vector<std::unique_ptr<T>> buffers{};
+        uint64_t last_request{0};
+    };
+
+    struct State
+    {
+        std::mutex mutex{};
+        std::map<size_t, Bucket> buckets{};
+        std::function<void(T &)> recycle{};
+        size_t capacity{};
+        size_t bytes_held{0};
+        size_t nof_buffers_held{0};
+        uint64_t nof_requests{0};
+        uint64_t nof_hits{0};
+        uint64_t nof_misses{0};
+        uint64_t nof_discarded{0};
+    };
+
+    /* Move the stale buckets into `discarded`. The lock must be held by the
+       caller, who frees the buffers once it's been released. Moving the map
+       nodes doesn't allocate, so this cannot throw. */
+    void DiscardStaleBuckets(std::map<size_t, Bucket> &discarded)
+    {
+        for (auto it = m_state->buckets.begin(); it != m_state->buckets.end();)
+        {
+            auto current = it++;
+            if (m_state->nof_requests - current->second.last_request <= m_state->capacity)
+                continue;
+
+            const size_t nof_buffers = current->second.buffers.size();
+            m_state->bytes_held -= nof_buffers * current->first;
+            m_state->nof_buffers_held -= nof_buffers;
+            m_state->nof_discarded += nof_buffers;
+            discarded.insert(m_state->buckets.extract(current));
+        }
+    }
+
+    /* The deleter of the buffers we hand out. We only keep a weak reference
+       to the state so that outstanding buffers don't keep the pool alive. */
+    struct Recycler
+    {
+        Recycler(const std::shared_ptr<State> &state, size_t size)
+            : state(state)
+            , size(size)
+        {}
+
+        void operator()(T *buffer) const
+        {
+            std::unique_ptr<T> object{buffer};
+            if (auto locked = state.lock())
+            {
+                /* The function is only set on construction, so we can call it
+                   without holding the lock. */
+                if (locked->recycle)
+                    locked->recycle(*object);
+
+                /* A buffer whose bucket has gone stale is freed. */
+                std::unique_lock lock{locked->mutex};
+                auto bucket = locked->buckets.find(size);
+                if (bucket != locked->buckets.end() &&
+                    locked->nof_buffers_held < locked->capacity)
+                {
+                    try
+                    {
+                        bucket->second.buffers.emplace_back(std::move(object));
+                        locked->bytes_held += size;
+                        locked->nof_buffers_held++;
+                        return;
+                    }
+                    catch (const std::bad_alloc &)
+                    {
+                        /* Fall through and free the buffer. */
+                    }
+                }
+
+                locked->nof_discarded++;
+            }
+        }
+
+        std::weak_ptr<State> state;
+        size_t size;
+    };
+
+    std::shared_ptr<State> m_state;
+};
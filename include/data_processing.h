@@ -1,12 +1,20 @@
 #pragma once
 
 #include "smart_buffer_thread.h"
+#include "spsc_queue.h"
+#include "buffer_pool.h"
 #include "window.h"
+#include "fourier_transform.h"
+#include "downconverter.h"
+#include "worker_pool.h"
 #include "data_types.h"
 #include "error.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <cmath>
+#include <mutex>
 
 enum class FrequencyDomainScaling
 {
@@ -17,6 +25,29 @@ enum class FrequencyDomainScaling
 
 #define FREQUENCY_DOMAIN_SCALING_LABELS {"Amplitude", "Energy"}
 
+enum class FrequencyDomainAveraging
+{
+    MOVING,      /* Boxcar average of the last N spectra. */
+    EXPONENTIAL, /* Exponential average with the weight 1/N. */
+    CUMULATIVE,  /* Average of every spectrum since the last clear. */
+    NOF_ENTRIES
+};
+
+#define FREQUENCY_DOMAIN_AVERAGING_LABELS {"Moving", "Exponential", "Cumulative"}
+
+/* The policy used to pick the FFT length given the record length. Transforming
+   the exact length of a long record with large prime factors takes a lot of
+   time and memory, so that has to be asked for. */
+enum class TransformLength
+{
+    TRUNCATE, /* Discard samples to reach the previous fast length. */
+    ZERO_PAD, /* Pad with zeros to reach the next fast length. */
+    EXACT,    /* Transform the full record, whatever its length. */
+    NOF_ENTRIES
+};
+
+#define TRANSFORM_LENGTH_LABELS {"Truncate", "Zero pad", "Exact"}
+
 enum class DataProcessingMessageId
 {
     SET_AFE_PARAMETERS,
@@ -30,13 +61,23 @@ struct DataProcessingParameters
 
     WindowType window_type;
     FrequencyDomainScaling fft_scaling;
+    TransformLength fft_length;
+    size_t fft_parallel_threshold;
+    size_t waterfall_depth;
+    size_t nof_recycled_records;
+    size_t welch_segment_length;
+    double zoom_center_frequency;
+    double zoom_span;
     int nof_skirt_bins;
+    FrequencyDomainAveraging fft_averaging;
     int nof_fft_averages;
     double fundamental_frequency;
     bool convert_horizontal;
     bool convert_vertical;
     bool fullscale_enob;
     bool fft_maximum_hold;
+    bool tone_tracking;
+    bool full_rate_metrics;
 };
 
 struct DataProcessingMessage
@@ -68,8 +109,10 @@ struct DataProcessingMessage
     DataProcessingParameters processing;
 };
 
+/* The processed records are ejected from the strand and read by a single
+   consumer, so the outbound queue is an `SpscQueue`. */
 class DataProcessing
-    : public SmartBufferThread<ProcessedRecord, DataProcessingMessage>
+    : public SmartBufferThread<ProcessedRecord, DataProcessingMessage, false, SpscQueue>
 {
 public:
     DataProcessing(void *handle, int index, int channel, const std::string &label,
@@ -81,8 +124,10 @@ public:
     void MainLoop() override;
 
 private:
-    static const size_t WATERFALL_SIZE = 20;
+    static constexpr size_t WATERFALL_MEMORY_BUDGET = size_t{64} * 1024 * 1024;
+    static constexpr size_t WATERFALL_MAX_COLUMNS = 8192;
     static const size_t NOISE_MOVING_AVERAGE_SIZE = 50;
+    static const size_t MAX_RECORDS_IN_FLIGHT = 2;
     void *m_handle;
     int m_index;
     int m_channel;
@@ -90,22 +135,113 @@ private:
     ADQAnalogFrontendParametersChannel m_afe;
     ADQConstantParameters m_constant;
     WindowCache m_window_cache;
+    FourierTransformCache m_fourier_transform_cache;
+    std::vector<double> m_fft_input;
+    std::vector<std::complex<double>> m_fft_output;
+    std::vector<double> m_periodogram;
     DataProcessingParameters m_parameters;
     TimeDomainMetrics m_time_domain_metrics;
-    std::deque<std::shared_ptr<FrequencyDomainRecord>> m_waterfall;
+    std::shared_ptr<Waterfall> m_waterfall;
     std::deque<double> m_noise_moving_average;
     MovingAverage m_fft_moving_average;
+    ExponentialAverage m_fft_exponential_average;
     MaximumHold m_fft_maximum_hold;
 
-    template <typename T>
-    static size_t NextPowerOfTwo(T i);
+    /* The processed records and their parts are recycled once every reference
+       to them has been dropped, i.e. once the UI lets go of the record. */
+    BufferPool<ProcessedRecord> m_processed_record_pool;
+    BufferPool<TimeDomainRecord> m_time_domain_pool;
+    BufferPool<FrequencyDomainRecord> m_frequency_domain_pool;
+
+    /* A copy of a record from the digitizer in host memory. This lets us hand
+       the DMA buffer back as soon as we've received it instead of holding on
+       to it until the record has been processed. */
+    struct HostRecord
+    {
+        HostRecord();
 
-    template <typename T>
-    static size_t PreviousPowerOfTwo(T i);
+        /* Copy the header and the first `size` bytes of the data of `raw`. */
+        void Assign(const ADQGen4Record *raw, size_t size);
 
-    template <typename T>
-    static void TransformToUnitRange(const T *data, double code_normalization,
-                                     const Window *window, std::vector<double> &y);
+        ADQGen4RecordHeader header;
+        std::vector<uint8_t> data;
+    };
+    BufferPool<HostRecord> m_host_record_pool;
+
+    /* Set the number of records kept for reuse by each pool and get the
+       combined statistics of the pools. */
+    void SetRecycledRecords(size_t nof_records);
+    BufferPoolStatistics GetRecycledRecordStatistics() const;
+
+    /* The thread waiting for records from the digitizer hands them over to
+       the shared worker pool. The strand processes the records (and the
+       messages) of this channel in order, one at a time. We limit the number
+       of records in flight and wait for them to finish before stopping. */
+    WorkerPool::Strand m_strand;
+    std::mutex m_records_mutex;
+    std::condition_variable m_records_signal;
+    size_t m_nof_records_in_flight;
+
+    /* In the full-rate metrics mode, every record is analyzed, whether it's
+       shown or not. The thread waiting for records needs to know this, so we
+       keep a copy of the parameter outside of the strand. */
+    std::atomic<bool> m_full_rate_metrics;
+
+    /* Post a task processing the `time_domain` record to the strand. The
+       record may be NULL, in which case the task only processes messages. */
+    void PostRecord(std::shared_ptr<HostRecord> time_domain, double estimated_trigger_frequency,
+                    double estimated_throughput);
+    void WaitForRecordsInFlight(size_t limit);
+
+    /* Welch's method: each slot transforms a share of the segments with its
+       own plan and working memory, accumulating the squared magnitudes. The
+       slots run in parallel on the shared pool. */
+    struct WelchSlot
+    {
+        std::unique_ptr<FourierTransformPlan> plan;
+        std::vector<double> input;
+        std::vector<std::complex<double>> output;
+        std::vector<double> power;
+    };
+    std::vector<WelchSlot> m_welch_slots;
+
+    /* The zoom transform: the record is downconverted to complex baseband and
+       the decimated signal is transformed with a short complex transform. */
+    Downconverter m_downconverter;
+    std::vector<std::complex<double>> m_zoom_baseband;
+    std::unique_ptr<ComplexFourierTransform> m_zoom_transform;
+    std::vector<std::complex<double>> m_zoom_scratch;
+
+    /* Estimate the power spectrum of the `nof_samples` samples in `x` with
+       Welch's method, i.e. by averaging the periodograms of segments of
+       `segment_length` samples overlapping by half their length. Each segment
+       is multiplied by the `window` (if not NULL) before it's transformed.
+       The result is written to `m_periodogram`. */
+    int EstimateWelch(const double *x, size_t nof_samples, size_t segment_length,
+                      const Window *window);
+
+    /* Downconvert the `nof_samples` samples in `x` to the band set by the
+       parameters, moving the band into the first Nyquist zone if needed.
+       Returns the number of samples available for the zoom transform in
+       `nof_baseband_samples`. */
+    int Downconvert(const double *x, size_t nof_samples, double sampling_frequency,
+                    size_t &nof_baseband_samples);
+
+    /* Transform the first `length` samples of the baseband signal, multiplied
+       by the `window` (if not NULL), and write the periodogram of the bins
+       inside the span to `m_periodogram`, ordered by frequency. The frequency
+       of the first bin is written to `start`. */
+    int TransformZoom(size_t length, const Window *window, double &start);
+
+    /* Insert the spectrum of the `record` as the newest row of the waterfall,
+       creating a new one if the depth or the length of the spectrum changes. */
+    int InsertIntoWaterfall(ProcessedRecord &record);
+
+    /* Given the `record_length` and the length `policy`, determine the number
+       of samples to transform and the length of the transform. The samples
+       beyond `nof_samples` are zero if the transform is longer. */
+    static void GetTransformLength(size_t record_length, TransformLength policy,
+                                   size_t &nof_samples, size_t &fft_length);
 
     struct Tone
     {
@@ -150,19 +286,49 @@ private:
     static size_t FoldIndex(size_t f, size_t fs);
 
     /* Process the raw data from the digitizer, filling the `time_domain` and
-       `frequency_domain` members of the `processed_record`. The parameter
-       `raw_time_domain` _must not_ be NULL. */
-    int ProcessRecord(const ADQGen4Record *raw_time_domain, ProcessedRecord &processed_record);
-
-    /* Analyze the fourier transform contained in `fft` of and store the results
-       in the processed `record`. */
-    void AnalyzeFrequencyDomain(
-        const std::vector<std::complex<double>> &fft, ProcessedRecord &record);
-
-    /* Identify the fundamental tone and the worst spur. The spectrum is
-       converted into decibels (in place). */
-    void ProcessAndIdentify(const std::vector<std::complex<double>> &fft, ProcessedRecord &record,
-                            Tone &dc, Tone &fundamental, Tone &spur, double &power);
+       `frequency_domain` members of the `processed_record`. Unless the record
+       is going to be shown (`display`), we stop once the metrics have been
+       computed, leaving out the trace, the spectrum in decibels and the
+       waterfall. */
+    int ProcessRecord(const HostRecord &raw_time_domain, bool display,
+                      ProcessedRecord &processed_record);
+
+    /* Compute the periodogram of the `fft`, i.e. the nonredundant bins of a
+       real transform of `nof_samples` samples (possibly zero padded), into
+       `m_periodogram`. */
+    void ComputePeriodogram(const std::vector<std::complex<double>> &fft, size_t nof_samples);
+
+    /* Analyze the `periodogram` and store the results in the processed
+       `record`. Each bin of the `periodogram` holds the power (2 |X| / N)^2,
+       i.e. before any averaging or window correction. */
+    void AnalyzeFrequencyDomain(const std::vector<double> &periodogram, bool zoom,
+                                ProcessedRecord &record);
+
+    /* Measure the fundamental tone at the fixed frequency, its harmonics and
+       the interleaving spurs directly from the `nof_samples` windowed samples
+       in `x` with one Goertzel filter per tone, skipping the transform. The
+       samples are expected to be multiplied by the `window` (NULL if none).
+       The record's power spectrum is left empty. */
+    void TrackTones(const double *x, size_t nof_samples, const Window *window,
+                    ProcessedRecord &record);
+
+    /* Compute the metrics relating the `fundamental` to the noise and the
+       distortion, given the tones and the `total_power` of a spectrum of
+       `nof_bins` bins. The tones are expected to be free of overlaps. */
+    void AnalyzeTones(const Tone &dc, const Tone &fundamental, const Tone &spur,
+                      std::vector<Tone> &harmonics, Tone &gain_phase_spur, Tone &offset_spur,
+                      double total_power, size_t nof_bins, FrequencyDomainRecord &record);
+
+    /* Identify the fundamental tone and the worst spur, writing the linear
+       power of each bin to the record's power spectrum. A `zoom` spectrum
+       doesn't contain DC. */
+    void ProcessAndIdentify(const std::vector<double> &periodogram, bool zoom,
+                            ProcessedRecord &record, Tone &dc, Tone &fundamental, Tone &spur,
+                            double &power);
+
+    /* Update the noise density metrics of the `record` given the total
+       `noise_power` spread over `nof_bins` bins. */
+    void UpdateNoiseDensity(double noise_power, size_t nof_bins, FrequencyDomainRecord &record);
 
     /* Given a fundamental tone, place the harmonic overtones into the spectrum. */
     void PlaceHarmonics(const Tone &fundamental, const ProcessedRecord &record,
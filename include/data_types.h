@@ -1,9 +1,12 @@
 #pragma once
 
 #include "fmt/format.h"
+#include "buffer_pool.h"
 #include "format.h"
 #include "imgui_extensions.h"
+#include "sample_conversion.h"
 
+#include <cmath>
 #include <cstdint>
 #include <cstddef>
 #include <complex>
@@ -11,11 +14,24 @@
 #include <cstring>
 #include <vector>
 #include <deque>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <utility>
 
 #include "ADQAPI.h"
 
+/* The type used to store the record data, i.e. the traces, the spectra and the
+   waterfall. Building with `SINGLE_PRECISION_RECORDS` halves the memory
+   footprint of the records. The processing itself (averaging, power sums and
+   the derived metrics) is always carried out in double precision. */
+#if defined(SINGLE_PRECISION_RECORDS)
+typedef float RecordValue;
+#else
+typedef double RecordValue;
+#endif
+
 /* The `Value` type groups together a `double` with a few properties to greatly
    simplify its formatting for UI presentation. This is handled through the
    various `Format` functions. */
@@ -54,18 +70,41 @@ struct Value
         double lowest_prefix;
     };
 
+    /* The properties are immutable and shared between all the values (and
+       records) with the same unit and format. This way, creating a value never
+       has to copy any strings. */
+    typedef std::shared_ptr<const Properties> SharedProperties;
+
+    /* Create shared properties from the arguments to a `Properties` constructor. */
+    template <typename... Args>
+    static SharedProperties MakeProperties(Args &&... args)
+    {
+        return std::make_shared<Properties>(std::forward<Args>(args)...);
+    }
+
+    /* The properties of a default-constructed value. */
+    static const SharedProperties &EmptyProperties()
+    {
+        static const SharedProperties properties = MakeProperties("", "", 1.0, 1.0);
+        return properties;
+    }
+
     Value()
         : value{0}
-        , properties{}
+        , properties{EmptyProperties()}
         , valid{true}
     {}
 
-    Value(double value, const Properties &properties, bool valid = true)
+    Value(double value, const SharedProperties &properties, bool valid = true)
         : value{value}
         , properties{properties}
         , valid{valid}
     {}
 
+    Value(double value, const Properties &properties, bool valid = true)
+        : Value(value, MakeProperties(properties), valid)
+    {}
+
     Value &operator=(const double &lhs)
     {
         value = lhs;
@@ -92,14 +131,14 @@ struct Value
     std::string FormatInverseDelta(double other, const std::string &precision, bool show_sign = false) const;
 
     double value;
-    Properties properties;
+    SharedProperties properties;
     bool valid;
 };
 
 class ValueWithStatistics : public Value
 {
 public:
-    ValueWithStatistics(const Value::Properties &properties = {})
+    ValueWithStatistics(const Value::SharedProperties &properties = Value::EmptyProperties())
         : Value{0, properties}
         , min{std::numeric_limits<double>::max()}
         , max{std::numeric_limits<double>::lowest()}
@@ -107,6 +146,10 @@ public:
         , nof_values{0}
     {}
 
+    ValueWithStatistics(const Value::Properties &properties)
+        : ValueWithStatistics(Value::MakeProperties(properties))
+    {}
+
     ValueWithStatistics &operator=(const double &lhs)
     {
         value = lhs;
@@ -147,6 +190,11 @@ public:
         return Value(min, properties);
     }
 
+    size_t Count() const
+    {
+        return nof_values;
+    }
+
 private:
     double min;
     double max;
@@ -154,19 +202,63 @@ private:
     size_t nof_values;
 };
 
+/* The base record holds the values in the y-dimension. The x-axis is uniform
+   and is thus stored implicitly as the `start` value and the `step` between
+   samples, i.e. x[i] = start + i * step. */
 struct BaseRecord
 {
-    BaseRecord(size_t count, const Value::Properties &x_properties,
-               const Value::Properties &y_properties)
-        : x(count)
-        , y(count)
+    BaseRecord(size_t count, const Value::SharedProperties &x_properties,
+               const Value::SharedProperties &y_properties)
+        : y(count)
         , x_properties(x_properties)
         , y_properties(y_properties)
+        , start(0.0)
         , step(0.0)
     {}
 
     virtual ~BaseRecord() = 0;
 
+    /* Get the x-value of sample `i`. */
+    double X(size_t i) const
+    {
+        return start + static_cast<double>(i) * step;
+    }
+
+    /* Get the x-value of the last sample. */
+    double BackX() const
+    {
+        return X(y.empty() ? 0 : y.size() - 1);
+    }
+
+    /* Get the index of the sample closest to `x`, clamped to the range of the
+       record. Returns zero for an empty record. */
+    size_t ClosestIndex(double x) const
+    {
+        if (y.empty() || !(step > 0.0) || !(x > start))
+            return 0;
+
+        const double index = std::round((x - start) / step);
+        if (!(index < static_cast<double>(y.size() - 1)))
+            return y.size() - 1;
+        return static_cast<size_t>(index);
+    }
+
+    /* Get the index of the sample closest to the point (x, y) as perceived in
+       a view with the limits [x_min, x_max] and [y_min, y_max]. Returns false
+       if the record is empty, leaving `index` untouched. */
+    bool ClosestIndex(double point_x, double point_y, double x_min, double x_max, double y_min,
+                      double y_max, size_t &index) const;
+
+    /* Construct the x-axis explicitly. Only use this when an explicit
+       representation is required, e.g. when exporting the data. */
+    std::vector<double> MaterializeX() const
+    {
+        std::vector<double> x(y.size());
+        for (size_t i = 0; i < x.size(); ++i)
+            x[i] = X(i);
+        return x;
+    }
+
     /* Object-bound constructor of a value in the x-dimension. */
     Value ValueX(double value, bool valid = true) const
     {
@@ -179,17 +271,28 @@ struct BaseRecord
         return Value(value, y_properties, valid);
     }
 
-    std::vector<double> x;
-    std::vector<double> y;
-    Value::Properties x_properties;
-    Value::Properties y_properties;
+    std::vector<RecordValue> y;
+    Value::SharedProperties x_properties;
+    Value::SharedProperties y_properties;
+    double start;
     double step;
 };
 
+/* Statistics of a single time domain record, in the unit of the trace. */
+struct TimeDomainStatistics
+{
+    double max;
+    double min;
+    double mean;
+    double sdev;
+    size_t nof_clipped_low;
+    size_t nof_clipped_high;
+};
+
 struct TimeDomainMetrics
 {
     TimeDomainMetrics() = default;
-    TimeDomainMetrics(const Value::Properties &properties)
+    TimeDomainMetrics(const Value::SharedProperties &properties)
         : max{properties}
         , min{properties}
         , mean{properties}
@@ -223,101 +326,74 @@ struct TimeDomainRecord : public BaseRecord
 {
     inline static const std::string PRECISION = "8.2";
     inline static const std::string PRECISION_UNCONVERTED = "8.0";
-
-    TimeDomainRecord(const ADQGen4Record *raw,
-                     const ADQAnalogFrontendParametersChannel &afe,
-                     double code_normalization,
-                     bool convert_horizontal = true, bool convert_vertical = true)
-        : BaseRecord(raw->header->record_length,
-                     convert_horizontal ? Value::Properties{"s", PRECISION, 1e-3, 1e-12, "Hz"}
-                                        : Value::Properties{"S", PRECISION_UNCONVERTED, 1.0, 1.0},
-                     convert_vertical ? Value::Properties{"V", PRECISION, 1e-3, 1e-12}
-                                      : Value::Properties{"", PRECISION_UNCONVERTED, 1.0, 1.0})
-        , header(*raw->header)
+    inline static const Value::SharedProperties X_PROPERTIES =
+        Value::MakeProperties("s", PRECISION, 1e-3, 1e-12, "Hz");
+    inline static const Value::SharedProperties X_PROPERTIES_UNCONVERTED =
+        Value::MakeProperties("S", PRECISION_UNCONVERTED, 1.0, 1.0);
+    inline static const Value::SharedProperties Y_PROPERTIES =
+        Value::MakeProperties("V", PRECISION, 1e-3, 1e-12);
+    inline static const Value::SharedProperties Y_PROPERTIES_UNCONVERTED =
+        Value::MakeProperties("", PRECISION_UNCONVERTED, 1.0, 1.0);
+    inline static const Value::SharedProperties SAMPLING_FREQUENCY_PROPERTIES =
+        Value::MakeProperties("Hz", PRECISION, 1e9);
+    inline static const Value::SharedProperties SAMPLING_PERIOD_PROPERTIES =
+        Value::MakeProperties("s", PRECISION, 1e-3);
+
+    /* Construct an empty record of `count` samples, to be filled by `Convert()`. */
+    TimeDomainRecord(size_t count)
+        : BaseRecord(count, X_PROPERTIES, Y_PROPERTIES)
+        , header{}
+        , statistics{}
         , metrics(y_properties)
-        , sampling_frequency(0.0, {"Hz", PRECISION, 1e9})
-        , sampling_period(0.0, {"s", PRECISION, 1e-3})
+        , sampling_frequency(0.0, SAMPLING_FREQUENCY_PROPERTIES)
+        , sampling_period(0.0, SAMPLING_PERIOD_PROPERTIES)
         , range_max(ValueY(0.0))
         , range_min(ValueY(0.0))
         , range_mid(ValueY(0.0))
-    {
-        /* The time unit is specified in picoseconds at most. Given that we're
-           using a 32-bit float, we truncate any information beyond that point. */
-        int time_unit_ps = static_cast<int>(raw->header->time_unit * 1e12);
-        double time_unit = static_cast<double>(time_unit_ps) * 1e-12;
-
-        sampling_period.value = static_cast<double>(raw->header->sampling_period) * time_unit;
-        sampling_frequency.value = std::round(1.0 / sampling_period.value);
-
-        double record_start;
-        if (convert_horizontal)
-        {
-            step = sampling_period.value;
-            record_start = static_cast<double>(raw->header->record_start) * time_unit;
-        }
-        else
-        {
-            /* We intentionally always start with the first sample at zero to
-               keep the horizontal grid in sync w/ the sampling grid. */
-            /* TODO: At some point we could add visualization of the trigger point. */
-            step = 1.0;
-            record_start = 0.0; /* T: Always start at 0? */
-        }
-
-        if (convert_vertical)
-        {
-            range_max.value = (afe.input_range / 2 - afe.dc_offset) / 1e3;
-            range_min.value = (-afe.input_range / 2 - afe.dc_offset) / 1e3;
-            range_mid.value = (range_max.value + range_min.value) / 2;
-        }
-        else
-        {
-            range_max.value = code_normalization / 2 - 1;
-            range_min.value = -(code_normalization / 2);
-            range_mid.value = 0.0;
-        }
-
-        switch (raw->header->data_format)
-        {
-        case ADQ_DATA_FORMAT_INT16:
-            Transform(static_cast<const int16_t *>(raw->data), record_start, step,
-                      code_normalization, afe.input_range, afe.dc_offset, x, y, convert_vertical);
-            break;
-
-        case ADQ_DATA_FORMAT_INT32:
-            Transform(static_cast<const int32_t *>(raw->data), record_start, step,
-                      code_normalization, afe.input_range, afe.dc_offset, x, y, convert_vertical);
-            break;
-
-        default:
-            throw std::invalid_argument(
-                fmt::format("Unknown data format '{}' when transforming time domain record.",
-                            raw->header->data_format));
-        }
-
-    }
+    {}
 
-    template <typename T>
-    static void Transform(const T *data, double record_start, double sampling_period,
-                          double code_normalization, double input_range, double dc_offset,
-                          std::vector<double> &x, std::vector<double> &y, bool convert_vertial)
+    /* Construct a time domain record from the `raw` data. See `Convert()`. */
+    TimeDomainRecord(const ADQGen4Record *raw,
+                     const ADQAnalogFrontendParametersChannel &afe,
+                     double code_normalization,
+                     bool convert_horizontal = true, bool convert_vertical = true,
+                     double *fft = NULL, size_t nof_fft_samples = 0,
+                     const double *window = NULL)
+        : TimeDomainRecord(raw->header->record_length)
     {
-        for (size_t i = 0; i < x.size(); ++i)
-        {
-            x[i] = record_start + static_cast<double>(i) * sampling_period;
-
-            if (convert_vertial)
-            {
-                y[i] = static_cast<double>(data[i]) / code_normalization * input_range - dc_offset;
-                y[i] /= 1e3; /* The value is in millivolts before we scale it. */
-            }
-            else
-            {
-                y[i] = static_cast<double>(data[i]);
-            }
-        }
+        Convert(raw, afe, code_normalization, convert_horizontal, convert_vertical, fft,
+                nof_fft_samples, window);
     }
 
+    /* Fill the record from the `raw` data, overwriting any previous contents.
+       This allows a record to be reused, in which case no memory is allocated
+       as long as the record length stays the same. If `fft` is not NULL, the
+       first `nof_fft_samples` samples are also written to `fft`, scaled to the
+       unit range and multiplied by the `window` (if not NULL), in the same
+       pass over the raw data. The `statistics` are gathered in that pass too.
+       Throws `std::invalid_argument` if the data
+       format is unsupported. */
+    void Convert(const ADQGen4Record *raw,
+                 const ADQAnalogFrontendParametersChannel &afe,
+                 double code_normalization,
+                 bool convert_horizontal = true, bool convert_vertical = true,
+                 double *fft = NULL, size_t nof_fft_samples = 0,
+                 const double *window = NULL);
+
+    /* Same as above, given the header and the data of the record separately.
+       If `trace` is false, the trace is left empty and only the transform
+       input and the statistics are produced. */
+    void Convert(const ADQGen4RecordHeader &raw_header, const void *raw_data,
+                 const ADQAnalogFrontendParametersChannel &afe,
+                 double code_normalization,
+                 bool convert_horizontal = true, bool convert_vertical = true,
+                 double *fft = NULL, size_t nof_fft_samples = 0,
+                 const double *window = NULL, bool trace = true);
+
+    /* Get the sampling period in seconds described by the `header`, i.e. the
+       value `Convert()` assigns to `sampling_period`. */
+    static double GetSamplingPeriod(const ADQGen4RecordHeader &header);
+
     /* Delete copy constructors until we need them. */
     TimeDomainRecord(const TimeDomainRecord &other) = delete;
     TimeDomainRecord &operator=(const TimeDomainRecord &other) = delete;
@@ -370,6 +446,14 @@ struct TimeDomainRecord : public BaseRecord
                 metrics.sdev.Format(),
                 {metrics.sdev.Mean().Format(), StatisticalMeasureHover(metrics.sdev)},
             },
+            {
+                "Clipped samples",
+                {
+                    fmt::format("{: >8d} S", statistics.nof_clipped_low + statistics.nof_clipped_high),
+                    fmt::format("Low:{}\nHigh:{}", statistics.nof_clipped_low,
+                                statistics.nof_clipped_high),
+                },
+            },
             {"Sampling frequency", sampling_frequency.Format()},
             {"Sampling period", sampling_period.Format()},
         };
@@ -378,6 +462,9 @@ struct TimeDomainRecord : public BaseRecord
     /* The record header, as given to us by the ADQAPI. */
     ADQGen4RecordHeader header;
 
+    /* The statistics of this record, gathered while converting the raw data. */
+    TimeDomainStatistics statistics;
+
     /* The time domain metrics that we keep statistics for. */
     TimeDomainMetrics metrics;
 
@@ -393,35 +480,63 @@ struct TimeDomainRecord : public BaseRecord
 struct FrequencyDomainRecord : public BaseRecord
 {
     inline static const std::string PRECISION = "7.2";
-
+    inline static const Value::SharedProperties X_PROPERTIES =
+        Value::MakeProperties("Hz", PRECISION, 1e6, 1.0);
+    inline static const Value::SharedProperties Y_PROPERTIES =
+        Value::MakeProperties("dBFS", "dB", PRECISION, 1.0, 1.0);
+    inline static const Value::SharedProperties DB_PROPERTIES =
+        Value::MakeProperties("dB", PRECISION, 1.0);
+    inline static const Value::SharedProperties DBC_PROPERTIES =
+        Value::MakeProperties("dBc", PRECISION, 1.0);
+    inline static const Value::SharedProperties DBFS_PROPERTIES =
+        Value::MakeProperties("dBFS", PRECISION, 1.0);
+    inline static const Value::SharedProperties NPSD_PROPERTIES =
+        Value::MakeProperties("dBFS/Hz", PRECISION, 1.0);
+    inline static const Value::SharedProperties BITS_PROPERTIES =
+        Value::MakeProperties("bits", PRECISION, 1.0);
+    inline static const Value::SharedProperties SIZE_PROPERTIES =
+        Value::MakeProperties("pts", "7.0", 1.0);
+    inline static const Value::SharedProperties RBW_PROPERTIES =
+        Value::MakeProperties("Hz", PRECISION, 1e6);
+
+    /* The plotted values `y` are left empty until the record is converted
+       for presentation with `ConvertToDecibels()`. */
     FrequencyDomainRecord(size_t count)
-        : BaseRecord(count,
-                     Value::Properties{"Hz", PRECISION, 1e6, 1.0},
-                     Value::Properties{"dBFS", "dB", PRECISION, 1.0, 1.0})
+        : BaseRecord(0, X_PROPERTIES, Y_PROPERTIES)
         , fundamental{}
         , spur{}
         , harmonics{}
         , gain_phase_spur{}
         , offset_spur{}
-        , snr(0.0, {"dB", PRECISION, 1.0})
-        , sinad(0.0, {"dB", PRECISION, 1.0})
-        , enob(0.0, {"bits", PRECISION, 1.0})
-        , sfdr_dbc(0.0, {"dBc", PRECISION, 1.0})
-        , sfdr_dbfs(0.0, {"dBFS", PRECISION, 1.0})
-        , thd(0.0, {"dB", PRECISION, 1.0})
-        , npsd(0.0, {"dBFS/Hz", PRECISION, 1.0})
-        , noise_moving_average(0.0, {"dBFS", PRECISION, 1.0})
-        , size(0.0, {"pts", "7.0", 1.0})
-        , rbw(0.0, {"Hz", PRECISION, 1e6})
+        , snr(0.0, DB_PROPERTIES)
+        , sinad(0.0, DB_PROPERTIES)
+        , enob(0.0, BITS_PROPERTIES)
+        , sfdr_dbc(0.0, DBC_PROPERTIES)
+        , sfdr_dbfs(0.0, DBFS_PROPERTIES)
+        , thd(0.0, DB_PROPERTIES)
+        , npsd(0.0, NPSD_PROPERTIES)
+        , noise_moving_average(0.0, DBFS_PROPERTIES)
+        , size(0.0, SIZE_PROPERTIES)
+        , rbw(0.0, RBW_PROPERTIES)
         , scale_factor(1.0)
         , energy_factor(1.0)
         , relative_power()
+        , power(count)
     {}
 
+    /* Restore the state after construction with `count` bins, keeping the
+       memory allocated for the vectors. */
+    void Reset(size_t count);
+
     /* Delete copy constructors until we need them. */
     FrequencyDomainRecord(const FrequencyDomainRecord &other) = delete;
     FrequencyDomainRecord &operator=(const FrequencyDomainRecord &other) = delete;
 
+    /* Convert the linear `power` spectrum into decibels, writing the result to
+       `y`. The values are scaled with `scale_factor` (relative to the energy
+       factor the `power` spectrum is scaled with). */
+    void ConvertToDecibels();
+
     /* Convert the metrics into a presentable format suitable for a table. */
     std::vector<std::vector<ImGui::TableCell>> FormatMetrics() const
     {
@@ -555,72 +670,103 @@ struct FrequencyDomainRecord : public BaseRecord
         double offset_spur;
         std::vector<double> harmonics;
     } relative_power;
+
+    /* The energy-accurate power of each bin. The analysis operates on these
+       values, while `y` holds the values presented in the plot. */
+    std::vector<double> power;
 };
 
+/* The waterfall is a circular buffer of spectra, inserted one row at a time.
+   The rows are stored newest first, so the contents can be plotted from (at
+   most) two contiguous spans of rows without making a copy. Long spectra are
+   decimated to at most `max_columns` columns by keeping the maximum value of
+   each group of `decimation` bins, preserving the peaks.
+
+   The waterfall is shared between the processing thread, which inserts rows,
+   and the records referring to it. Each record remembers the number of rows
+   inserted up to and including its own spectrum, which is what `GetSpans()`
+   expects as its `sequence` argument. The lock must be held while reading the
+   spans. A reader that takes its time with the rows, e.g. the UI plotting
+   them, should `Copy()` them instead, to avoid stalling the processing. */
 struct Waterfall
 {
-    Waterfall(const std::deque<std::shared_ptr<FrequencyDomainRecord>> &waterfall)
-        : data{}
-        , rows(0)
-        , columns(0)
-    {
-        /* Create a waterfall from a dequeue of frequency domain records. These
-           must be of the same size. Otherwise, we exit without making the copy. */
-
-        bool exit_without_copy = false;
-        if (waterfall.size() == 0)
-        {
-            exit_without_copy = true;
-        }
-        else
-        {
-            /* +1 for the Nyquist bin */
-            for (const auto &record : waterfall)
-            {
-                if (record->x.size() != waterfall.front()->x.size())
-                {
-                    exit_without_copy = true;
-                    break;
-                }
-            }
-        }
-
-        if (exit_without_copy)
-            return;
-
-        /* Perform the actual allocation and linear copy of the objects in the deque. */
-        columns = waterfall.front()->x.size();
-        rows = waterfall.size();
-        data.resize(rows * columns);
-
-        size_t idx = 0;
-        for (const auto &record : waterfall)
-        {
-            std::memcpy(data.data() + idx, record->y.data(), columns * sizeof(*data.data()));
-            idx += columns;
-        }
-    }
+    /* The spectra have their first bin at the frequency `start` and the bins
+       are `step` apart, see `FrequencyDomainRecord`. */
+    Waterfall(size_t rows, size_t size, size_t max_columns, double start, double step);
 
     /* Delete copy constructors until we need them. */
     Waterfall(const Waterfall &other) = delete;
     Waterfall &operator=(const Waterfall &other) = delete;
 
-    std::vector<double> data;
-    size_t rows;
-    size_t columns;
+    struct Span
+    {
+        const RecordValue *data;
+        size_t rows;
+    };
+
+    /* Insert the spectrum `y` of `size` values as the newest row, returning
+       the sequence number of the row. The `size` must match the size the
+       waterfall was created for. */
+    uint64_t Insert(const RecordValue *y, size_t size);
+
+    /* Get the spans holding the rows up to and including the row with the
+       `sequence` number, newest first. Rows that have since been overwritten
+       are left out. Returns the total number of rows in the spans. */
+    size_t GetSpans(uint64_t sequence, Span &first, Span &second) const;
+
+    /* Copy the rows up to and including the row with the `sequence` number
+       into `data`, newest first, holding the lock only while copying. Returns
+       the number of rows copied. */
+    size_t Copy(uint64_t sequence, std::vector<RecordValue> &data) const;
+
+    /* Lock the waterfall for reading. */
+    std::unique_lock<std::mutex> Lock() const
+    {
+        return std::unique_lock<std::mutex>(m_mutex);
+    }
+
+    /* The number of rows, the size of the spectra we accept and the number of
+       columns they're decimated to. */
+    const size_t rows;
+    const size_t size;
+    const size_t decimation;
+    const size_t columns;
+
+    /* The position of the bins and the frequency range covered by the
+       columns, from the lower edge of the first bin to the upper edge of the
+       last. A spectrum with other bins goes into a new waterfall, so these
+       hold for every row, even if the settings have changed since. */
+    const double start;
+    const double step;
+    const double x_min;
+    const double x_max;
+
+private:
+    std::vector<RecordValue> m_data;
+    size_t m_head;
+    uint64_t m_nof_inserted;
+    mutable std::mutex m_mutex;
 };
 
 struct ProcessedRecord
 {
     inline static const std::string PRECISION = "8.2";
+    inline static const Value::SharedProperties TRIGGER_FREQUENCY_PROPERTIES =
+        Value::MakeProperties("Hz", PRECISION, 1e6);
+    inline static const Value::SharedProperties THROUGHPUT_PROPERTIES =
+        Value::MakeProperties("B/s", PRECISION, 1e6);
+    inline static const Value::SharedProperties MEMORY_PROPERTIES =
+        Value::MakeProperties("B", PRECISION, 1e6);
 
     ProcessedRecord(const std::string &label, double trigger_frequency, double throughput)
         : time_domain(NULL)
         , frequency_domain(NULL)
         , waterfall(NULL)
+        , waterfall_sequence(0)
         , label(label)
-        , trigger_frequency(trigger_frequency, {"Hz", PRECISION, 1e6})
-        , throughput(throughput, {"B/s", PRECISION, 1e6})
+        , trigger_frequency(trigger_frequency, TRIGGER_FREQUENCY_PROPERTIES)
+        , throughput(throughput, THROUGHPUT_PROPERTIES)
+        , recycled_records{}
     {}
 
     /* Delete copy constructors until we need them. */
@@ -632,22 +778,31 @@ struct ProcessedRecord
         return {
             {"Trigger frequency", trigger_frequency.Format()},
             {"Throughput", throughput.Format()},
+            {"Recycled memory",
+             {Value(static_cast<double>(recycled_records.bytes_held), MEMORY_PROPERTIES).Format(),
+              fmt::format("Buffers: {} of {}\nHits: {}\nMisses: {}",
+                          recycled_records.nof_buffers_held, recycled_records.capacity,
+                          recycled_records.nof_hits, recycled_records.nof_misses)}},
         };
     }
 
     std::shared_ptr<TimeDomainRecord> time_domain;
     std::shared_ptr<FrequencyDomainRecord> frequency_domain;
     std::shared_ptr<Waterfall> waterfall;
+    uint64_t waterfall_sequence;
 
     std::string label;
     Value trigger_frequency;
     Value throughput;
+
+    /* The combined statistics of the pools recycling the records. */
+    BufferPoolStatistics recycled_records;
 };
 
 struct SensorRecord : public BaseRecord
 {
     SensorRecord()
-        : BaseRecord(0, {"s", "8.2"}, {"N/A", "8.2"})
+        : BaseRecord(0, Value::MakeProperties("s", "8.2"), Value::MakeProperties("N/A", "8.2"))
         , status(-1)
         , id()
         , group_id()
@@ -655,7 +810,7 @@ struct SensorRecord : public BaseRecord
     {}
 
     SensorRecord(uint32_t id, uint32_t group_id, const std::string &y_unit)
-        : BaseRecord(0, {"s", "8.2", 1.0}, {y_unit, "8.2"})
+        : BaseRecord(0, Value::MakeProperties("s", "8.2", 1.0), Value::MakeProperties(y_unit, "8.2"))
         , status(-1)
         , id(id)
         , group_id(group_id)
@@ -683,7 +838,9 @@ public:
 
     /* Prepare a new log entry of the target `size`. This function must be
        called before `InsertAndAverage()`, whose purpose is to fill the entry
-       set up by this operation. */
+       set up by this operation. The log is cleared if the size differs from
+       that of the previous entry, e.g. if the user has changed the record
+       length in the middle of an ongoing acquisition. */
     void PrepareNewEntry(size_t size);
 
     /* Insert y[i] into the latest entry in the rolling log of FFTs and return
@@ -695,21 +852,89 @@ public:
        similar quantity for which the averaging operation above is valid.
 
        `PrepareNewEntry()` _must_ have been called prior to this and `i` cannot
-       exceed the size given in that call. */
+       exceed the size given in that call. Each bin is expected to be inserted
+       once per entry but inserting the same value again is harmless.
+
+       The average is formed from a running sum, making the cost independent
+       of the number of averages. */
     double InsertAndAverage(size_t i, double y);
 
-    /* Clear the rolling log. */
+    /* Clear the rolling log. The memory of the entries is kept for reuse. */
     void Clear();
 
+    /* Clear the rolling log and release its memory, e.g. when switching to a
+       mode that doesn't use the moving average. */
+    void Release();
+
 private:
-    /* The rolling log of FFTs as a double-ended queue to be able to manipulate
-       both ends to insert new entries and evict old ones. */
-    std::deque<std::vector<double>> m_log;
+    /* The rolling log of FFTs as a ring buffer. The entries are allocated as
+       the log fills up and are then reused. When the log is full, the entry at
+       `m_head` holds the oldest values, which are subtracted from the running
+       sum as they are overwritten. */
+    std::vector<std::vector<double>> m_log;
+    size_t m_head;
+    size_t m_nof_entries;
+    size_t m_size;
+
+    /* The running sum per bin. The values span many orders of magnitude (the
+       noise floor vs. a full scale tone), so we use compensated summation to
+       keep the rounding errors from large values that have left the log from
+       swamping the small values. This bounds the drift well enough that the sum
+       is never formed from scratch, which would make every Nth record cost
+       O(N) per bin. */
+    std::vector<double> m_sum;
+    std::vector<double> m_compensation;
+
+    /* Add `value` to the compensated sum of bin `i`. */
+    void Accumulate(size_t i, double value);
 
     /* The number of averages (maximum size of the log). */
     size_t m_nof_averages;
 };
 
+class ExponentialAverage
+{
+public:
+    ExponentialAverage();
+
+    /* Delete copy constructors until we need them. */
+    ExponentialAverage(const ExponentialAverage &other) = delete;
+    ExponentialAverage &operator=(const ExponentialAverage &other) = delete;
+
+    /* Set the number of averages N, which determines the weight 1/N of a new
+       entry once the average has settled. Setting zero yields the cumulative
+       average of every entry since the average was last cleared. This
+       operation clears the average if the number of averages differs from the
+       current value. */
+    void SetNumberOfAverages(size_t nof_averages);
+
+    /* Prepare a new entry of the target `size`. This function must be called
+       before `InsertAndAverage()`. The average is cleared if the size differs
+       from that of the previous entry. */
+    void PrepareNewEntry(size_t size);
+
+    /* Insert y[i] into the average and return the result, i.e.
+
+         a[i] = a[i] + w * (y[i] - a[i])
+
+       where the weight w is 1/k for the k:th entry, until k reaches the number
+       of averages. This makes the average unbiased while it's filling up. Like
+       for `MovingAverage`, y[i] is expected to be the _energy_ in bin `i`.
+       Unlike `MovingAverage`, each bin must only be inserted _once_ per
+       entry. Only a single spectrum of state is kept, regardless of the
+       number of averages. */
+    double InsertAndAverage(size_t i, double y);
+
+    /* Clear the average. */
+    void Clear();
+
+private:
+    std::vector<double> m_average;
+    size_t m_nof_entries;
+    size_t m_nof_averages;
+    double m_weight;
+};
+
 class MaximumHold
 {
 public:
@@ -10,6 +10,7 @@
 #include "file_watcher.h"
 #include "system_manager.h"
 #include "embedded_python_thread.h"
+#include "event.h"
 
 #include "ADQAPI.h"
 
@@ -249,6 +250,11 @@ private:
     std::vector<std::unique_ptr<DataProcessing>> m_processing_threads;
     int m_no_activity_threshold_ms;
     bool m_notified_no_activity;
+    int m_next_activity_check_ms;
+
+    /* The main loop sleeps on this event, set by incoming messages and by
+       messages from the file watchers, between the periodic tasks. */
+    std::shared_ptr<Event> m_wakeup;
 
     /* Sensor records. */
     std::vector<SensorRecord> m_sensor_records;
@@ -271,6 +277,7 @@ private:
     void UpdateSystemManagerObjects();
     void CheckActivity();
     void CheckStatus();
+    std::chrono::high_resolution_clock::time_point NextDeadline() const;
 
     void StartDataAcquisition();
     void StopDataAcquisition();
@@ -309,6 +316,7 @@ private:
     static constexpr double STATUS_SAMPLING_PERIOD_MS = 1000.0;
     static constexpr int DEFAULT_ACTIVITY_THRESHOLD_MS = 1000;
     static constexpr int ACTIVITY_HYSTERESIS_MS = 500;
+    static constexpr int ACTIVITY_POLL_PERIOD_MS = 250;
 };
 
 template<>
@@ -1,11 +1,14 @@
 #pragma once
 
-#include "message_thread.h"
+#include "message_channels.h"
+#include "file_system_notifier.h"
 
 #include <string>
 #include <filesystem>
 #include <vector>
 #include <map>
+#include <memory>
+#include <set>
 
 enum class DirectoryWatcherMessageId
 {
@@ -31,14 +34,16 @@ struct DirectoryWatcherMessage
     std::filesystem::path path;
 };
 
-class DirectoryWatcher : public MessageThread<DirectoryWatcher, DirectoryWatcherMessage>
+/* Like the file watcher, the directory watcher runs on the shared `EventLoop`. */
+class DirectoryWatcher : public MessageChannels<DirectoryWatcherMessage>
 {
 public:
     DirectoryWatcher(const std::filesystem::path &path, const std::string &extension_filter = "");
     ~DirectoryWatcher() override;
     const std::filesystem::path &GetPath();
 
-    void MainLoop() override;
+    int Start();
+    int Stop();
 
 private:
     struct FileState
@@ -48,7 +53,14 @@ private:
         std::filesystem::file_time_type timestamp;
     };
 
+    /* The polling period used if the file system notifications are unavailable. */
+    static constexpr int POLL_PERIOD_MS = 1000;
+
     std::filesystem::path m_path;
     std::filesystem::path m_extension_filter;
     std::map<std::filesystem::path, FileState> m_files;
+    bool m_is_running;
+    FileSystemNotifier m_notifier;
+
+    void CheckDirectory(const std::set<std::string> &modified);
 };
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "worker_pool.h"
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+/* A digital downconverter translating a narrow band of a real-valued signal to
+   complex baseband at a reduced sampling rate, e.g. to zoom in on the spectrum
+   around a carrier. The signal is mixed with a numerically controlled
+   oscillator (NCO) at the center frequency, low-pass filtered and decimated by
+   the factor D.
+
+   The decimation is split into a cascade of stages. A large factor is written
+   as D = 2^S R with R in [4, 8). The first S stages are halfband filters, each
+   decimating by two, and the last stage is a lowpass filter decimating by R.
+   Each halfband filter only has to keep the images of the band from aliasing
+   into it, so the filters are short while the rate is high and the long
+   filter runs at the lowest rate. The cost per input sample thus tends to a
+   small constant as D grows, instead of growing with the length of a single
+   filter. A small factor is handled by a single stage.
+
+   The NCO is folded into the (complex) taps of the first stage and only every
+   d:th output of a stage is computed. The data flows through the stages in
+   blocks, so the memory needed is set by the filter lengths and not by the
+   length of the record.
+
+   The decimation factor is chosen to leave a guard band of at least a fifth
+   of the output sampling rate. The filters are Blackman-windowed sincs,
+   suppressing anything aliasing into the band by more than 70 dB. The output
+   has the same scaling as the mixer output, i.e. a tone of amplitude A shows
+   up with the amplitude A / 2. */
+class Downconverter
+{
+public:
+    Downconverter();
+
+    /* Delete copy constructors until we need them. */
+    Downconverter(const Downconverter &other) = delete;
+    Downconverter &operator=(const Downconverter &other) = delete;
+
+    /* Set up the downconverter to pass the band of width `span` centered on
+       `center_frequency` of a signal sampled at `sampling_frequency`. The band
+       has to fit within the first Nyquist zone. The filters are only
+       recomputed if one of the parameters changes. A narrow span needs a long
+       impulse response, so the configuration is rejected if one output would
+       depend on more than `max_length` input samples (capped at `MAX_LENGTH`),
+       e.g. the length of the record. */
+    int Configure(double sampling_frequency, double center_frequency, double span,
+                  size_t max_length = MAX_LENGTH);
+
+    /* The number of output samples produced from `nof_samples` input samples.
+       We only produce the outputs for which the filters are fully inside the
+       input, i.e. the outputs are free of any transients. */
+    size_t OutputLength(size_t nof_samples) const;
+
+    /* Downconvert the `nof_samples` samples in `x`, writing `OutputLength()`
+       samples to `y`. The work is distributed over the `pool` if not NULL. */
+    void Process(const double *x, size_t nof_samples, std::vector<std::complex<double>> &y,
+                 WorkerPool *pool = NULL) const;
+
+    double CenterFrequency() const { return m_center_frequency; }
+    double Span() const { return m_span; }
+    size_t Decimation() const { return m_decimation; }
+    double OutputSamplingFrequency() const { return m_sampling_frequency / m_decimation; }
+
+    /* The number of input samples that one output depends on. */
+    size_t Length() const { return m_length; }
+
+    /* The number of stages and the total number of nonzero taps. */
+    size_t Stages() const { return m_stages.size(); }
+    size_t Taps() const;
+
+    /* The number of real multiply-adds per input sample, counting the filters
+       and the NCO. */
+    double MultiplyAddsPerSample() const;
+
+    /* The longest impulse response we accept. */
+    static constexpr size_t MAX_LENGTH = size_t{1} << 31;
+
+private:
+    /* The minimum ratio between the output sampling rate and the span. */
+    static constexpr double OVERSAMPLING = 1.25;
+
+    /* The range of the decimation factor of the last stage. */
+    static constexpr size_t MIN_FINAL_DECIMATION = 4;
+
+    /* The largest error allowed in the passband and the stopband of the
+       halfband filters (-80 dB). */
+    static constexpr double HALFBAND_TOLERANCE = 1e-4;
+
+    /* The number of outputs of the first stage between the points where the
+       NCO phase is computed from scratch. */
+    static constexpr size_t NCO_BLOCK = 1024;
+
+    /* The number of outputs of the first stage that flow through the other
+       stages at a time. */
+    static constexpr size_t BLOCK = 4096;
+
+    struct Stage
+    {
+        /* The offsets of the nonzero taps and their values. */
+        std::vector<size_t> offsets;
+        std::vector<double> taps;
+        size_t length;
+        size_t decimation;
+
+        /* The number of outputs of this stage that go into one output of the
+           downconverter, and the distance between the first outputs that go
+           into two consecutive outputs of the downconverter. */
+        size_t support;
+        size_t stride;
+    };
+
+    double m_sampling_frequency;
+    double m_center_frequency;
+    double m_span;
+    size_t m_decimation;
+    size_t m_length;
+    std::vector<Stage> m_stages;
+
+    /* The taps of the first stage multiplied by the NCO exp(-i w k). */
+    std::vector<std::complex<double>> m_mixer_taps;
+
+    /* A lowpass filter of `nof_taps` taps for a decimation by `decimation`.
+       The taps at the multiples of `decimation` from the center are zero. */
+    static std::vector<double> LowPass(size_t nof_taps, size_t decimation);
+
+    /* The shortest halfband filter passing [0, `edge`] and stopping
+       [1/2 - `edge`, 1/2] (normalized frequencies) within the tolerance. */
+    static std::vector<double> Halfband(double edge);
+
+    /* Compute the outputs [begin, end) of the downconverter into `y`. */
+    void Run(const double *x, size_t begin, size_t end, std::complex<double> *y) const;
+};
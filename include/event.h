@@ -0,0 +1,53 @@
+/* An auto-resetting event that lets a thread sleep until something happens
+   somewhere else, e.g. a write to one of several queues, or until a deadline.
+   Any thread may `Set` the event. Setting an event that nobody is waiting for
+   is remembered until the next wait, so a wakeup is never lost. A derived
+   class may extend `Set` to also wake a thread blocked somewhere else. */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+class Event
+{
+public:
+    Event()
+        : m_mutex()
+        , m_signal()
+        , m_is_set(false)
+    {
+    }
+
+    virtual ~Event() = default;
+
+    /* Delete copy constructors. */
+    Event(const Event &other) = delete;
+    Event &operator=(const Event &other) = delete;
+
+    virtual void Set()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_is_set = true;
+        }
+        m_signal.notify_all();
+    }
+
+    /* Wait until the event is set or the deadline passes, returning true in
+       the first case. The event is reset before returning. */
+    template <class Clock, class Duration>
+    bool WaitUntil(const std::chrono::time_point<Clock, Duration> &deadline)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const bool is_set = m_signal.wait_until(lock, deadline, [&]() { return m_is_set; });
+        m_is_set = false;
+        return is_set;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_signal;
+    bool m_is_set;
+};
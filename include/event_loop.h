@@ -0,0 +1,129 @@
+/* A reactor running the handlers of many small components on one shared
+   thread, instead of each component owning a thread that mostly sleeps. A
+   handler is registered for one of three kinds of sources:
+
+     - a file descriptor, e.g. inotify or a udev monitor, whose handler runs
+       when there's data to read (Linux only);
+     - a timer, armed and rearmed with `SetTimer`; and
+     - a signal, whose handler runs after a call to `Signal` from any thread.
+
+   On Linux, the thread blocks in `epoll_wait` with an eventfd for the signals
+   and the nearest timer deadline as the timeout. Elsewhere, only timers and
+   signals are supported, using a condition variable.
+
+   The handlers run one at a time on the loop thread without any lock held,
+   so a handler may add, arm or remove sources, including itself. A handler
+   for a file descriptor must consume what's readable, or it'll be called
+   again right away. */
+
+#pragma once
+
+#include "event.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+class EventLoop
+{
+public:
+    using Handler = std::function<void()>;
+
+    EventLoop();
+    ~EventLoop();
+
+    /* Delete copy constructors. */
+    EventLoop(const EventLoop &other) = delete;
+    EventLoop &operator=(const EventLoop &other) = delete;
+
+    /* Get the loop shared by the application. */
+    static EventLoop &Shared();
+
+    /* Run `handler` when `fd` becomes readable. The caller keeps ownership of
+       the file descriptor and must remove the source before closing it. */
+    int AddDescriptor(int fd, Handler handler, uint64_t &id);
+
+    /* Add a timer. The timer is disarmed until `SetTimer` is called. */
+    int AddTimer(Handler handler, uint64_t &id);
+
+    /* Run the handler of a timer `delay_ms` milliseconds from now, and then
+       every `period_ms` milliseconds if the period is positive. A negative
+       delay disarms the timer. */
+    int SetTimer(uint64_t id, int delay_ms, int period_ms = 0);
+
+    /* Add a signal, i.e. a handler that runs once after one or more calls to
+       `Signal`. */
+    int AddSignal(Handler handler, uint64_t &id);
+    int Signal(uint64_t id);
+
+    /* Remove a source. Unless called from the loop thread, this blocks until
+       the handler has returned if it's running, so the caller may destroy
+       anything the handler refers to once this returns. */
+    int Remove(uint64_t id);
+
+    bool IsLoopThread() const;
+
+private:
+    enum class SourceType
+    {
+        DESCRIPTOR,
+        TIMER,
+        SIGNAL,
+    };
+
+    struct Source
+    {
+        SourceType type;
+        std::shared_ptr<Handler> handler;
+        int fd;
+        bool is_armed;
+        bool is_ready;
+        std::chrono::steady_clock::time_point deadline;
+        std::chrono::milliseconds period;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::condition_variable m_idle;
+    std::map<uint64_t, Source> m_sources;
+    std::set<uint64_t> m_ready;
+    uint64_t m_next_id;
+    uint64_t m_running_id;
+    bool m_is_woken;
+    bool m_should_stop;
+    int m_epoll;
+    int m_eventfd;
+    std::thread m_thread;
+
+    int Add(Source &&source, uint64_t &id);
+    void Wake();
+    void WaitForSources(std::unique_lock<std::mutex> &lock,
+                        std::chrono::steady_clock::time_point deadline, bool has_deadline);
+    void MainLoop();
+};
+
+/* An event that also runs a handler on the event loop when it's set. Attached
+   to a message queue, this lets a component react to incoming messages on the
+   loop thread. The event is inert until connected. */
+class EventLoopSignal : public Event
+{
+public:
+    EventLoopSignal(EventLoop &loop = EventLoop::Shared());
+    ~EventLoopSignal() override;
+
+    int Connect(EventLoop::Handler handler);
+    int Disconnect();
+
+    void Set() override;
+
+private:
+    EventLoop &m_loop;
+    std::atomic<uint64_t> m_id;
+};
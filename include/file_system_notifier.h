@@ -0,0 +1,78 @@
+/* Change notifications for the entries of a directory, shared by the file and
+   directory watchers. The notifier runs on an `EventLoop`: on Linux, the
+   changes are reported by the kernel through inotify and the loop wakes up
+   when the inotify descriptor becomes readable. Elsewhere, or while the
+   directory cannot be watched (e.g. because it doesn't exist yet), the
+   notifier falls back to polling, retrying the watch every period.
+
+   Bursts of changes, like an editor truncating and rewriting a file, or
+   writing a temporary file and renaming it, are collected into a single
+   callback. The callback receives the names of the entries whose contents may
+   have changed. Other changes, e.g. removals, have to be found by inspecting
+   the directory. Polling calls back with an empty set. */
+
+#pragma once
+
+#include "event_loop.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <set>
+#include <string>
+
+class FileSystemNotifier
+{
+public:
+    using Callback = std::function<void(const std::set<std::string> &names)>;
+
+    FileSystemNotifier(EventLoop &loop = EventLoop::Shared());
+    ~FileSystemNotifier();
+
+    /* Delete copy constructors. */
+    FileSystemNotifier(const FileSystemNotifier &other) = delete;
+    FileSystemNotifier &operator=(const FileSystemNotifier &other) = delete;
+
+    /* Start watching `directory`, calling `callback` on the loop thread when
+       there's a change, or every `poll_period_ms` milliseconds if the
+       directory isn't watched. The callback is also called once right after
+       starting, so the caller can take its initial look at the directory on
+       the loop thread without missing a change. */
+    int Start(const std::filesystem::path &directory, int poll_period_ms, Callback callback);
+
+    /* Stop watching. Once this returns, the callback is not running and won't
+       be called again. */
+    int Stop();
+
+    /* The watch is lost if the directory is removed or moved. */
+    bool IsWatching() const;
+
+private:
+    /* Keep collecting events until the directory has been quiet this long, or
+       at most for the longer period. */
+    static constexpr int DEBOUNCE_MS = 20;
+    static constexpr int MAX_DEBOUNCE_MS = 200;
+
+    EventLoop &m_loop;
+    int m_inotify;
+    int m_watch;
+    bool m_is_started;
+    std::filesystem::path m_directory;
+    int m_poll_period_ms;
+    Callback m_callback;
+
+    /* The event loop sources. The handlers only touch the state below. */
+    uint64_t m_descriptor_id;
+    uint64_t m_debounce_id;
+    uint64_t m_poll_id;
+    bool m_is_debouncing;
+    std::chrono::steady_clock::time_point m_debounce_deadline;
+    std::set<std::string> m_names;
+
+    int Watch();
+    void ReadEvents();
+    void OnReadable();
+    void OnDebounce();
+    void OnPoll();
+};
@@ -1,9 +1,12 @@
 #pragma once
 
-#include "message_thread.h"
+#include "message_channels.h"
+#include "event_loop.h"
+#include "file_system_notifier.h"
 
 #include <string>
 #include <filesystem>
+#include <memory>
 
 enum class FileWatcherMessageId
 {
@@ -36,21 +39,31 @@ struct FileWatcherMessage
     std::shared_ptr<std::string> contents{};
 };
 
-class FileWatcher : public MessageThread<FileWatcher, FileWatcherMessage>
+/* The file watcher doesn't own a thread. Its checks and its handling of
+   incoming messages run on the shared `EventLoop`. */
+class FileWatcher : public MessageChannels<FileWatcherMessage>
 {
 public:
     FileWatcher(const std::filesystem::path &path);
     ~FileWatcher() override;
     const std::filesystem::path &GetPath();
 
-    void MainLoop() override;
+    int Start();
+    int Stop();
 
 private:
+    /* The polling period used if the file system notifications are unavailable. */
+    static constexpr int POLL_PERIOD_MS = 250;
+
     std::filesystem::path m_path;
     std::filesystem::file_time_type m_timestamp;
+    bool m_is_running;
     bool m_is_watching;
     bool m_ignore_next_update;
+    FileSystemNotifier m_notifier;
+    std::shared_ptr<EventLoopSignal> m_message_signal;
 
+    void CheckFile(bool is_modified);
     void ReadContents(std::string &str);
     void WriteContents(const std::string &str);
     void HandleMessages();
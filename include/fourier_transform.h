@@ -0,0 +1,195 @@
+#pragma once
+
+#include "worker_pool.h"
+
+#include <memory>
+#include <vector>
+#include <complex>
+#include <cstdint>
+
+/* A precomputed plan for the discrete Fourier transform of a complex sequence
+   of a fixed length M. Lengths whose only prime factors are 2, 3 and 5 (the
+   'fast' lengths) are transformed with a mixed-radix decimation-in-time
+   algorithm. Any other length is transformed using Bluestein's algorithm,
+   which expresses the transform as a convolution that is evaluated with a
+   power-of-two transform of at least 2M - 1 points.
+
+   A plan constructed with a nonzero number of `nof_workers` can also
+   distribute a transform over a pool of (at most) that many worker threads. A fast length M is then split into M = M1 * M2
+   with M1 close to the square root of M, and the transform is computed with
+   the four-step algorithm: M2 transforms of length M1 over the columns of the
+   input (viewed as an M1 x M2 matrix), a multiplication with the twiddle
+   factors and M1 transforms of length M2 over the rows. Each of the short
+   transforms fits in the cache of the core computing it. For other lengths,
+   the convolution in Bluestein's algorithm is evaluated this way. */
+class ComplexFourierTransform
+{
+public:
+    ComplexFourierTransform() = delete;
+    ComplexFourierTransform(size_t length, size_t nof_workers = 0);
+
+    /* Delete copy constructors until we need them. */
+    ComplexFourierTransform(const ComplexFourierTransform &other) = delete;
+    ComplexFourierTransform &operator=(const ComplexFourierTransform &other) = delete;
+
+    /* Check if `length` only has 2, 3 and 5 as its prime factors. */
+    static bool IsFast(size_t length);
+
+    /* Get the smallest fast length greater than or equal to `length`. */
+    static size_t NextFastLength(size_t length);
+
+    /* Get the largest fast length less than or equal to `length`. */
+    static size_t PreviousFastLength(size_t length);
+
+    /* Transform `y` in place. The transform requires `ScratchSize()` elements
+       of working memory in `scratch`, which may be NULL if that size is zero. */
+    void Forward(std::complex<double> *y, std::complex<double> *scratch) const;
+
+    /* Transform `y` in place, expecting the input to already have been
+       permuted, i.e. input sample `n` is located at `y[Permutation()[n]]`. This
+       is only available for fast lengths and lets the caller fold the
+       permutation into the loading of the data. */
+    void ForwardPermuted(std::complex<double> *y) const;
+
+    /* Transform `y` in place, distributing the work over the `pool`. The
+       transform requires `ParallelScratchSize()` elements of working memory in
+       `scratch`. Only available if `IsParallel()`. */
+    void ForwardParallel(std::complex<double> *y, std::complex<double> *scratch,
+                         WorkerPool &pool) const;
+
+    size_t Length() const { return m_length; }
+    size_t ScratchSize() const { return m_scratch_size; }
+    size_t ParallelScratchSize() const { return m_parallel_scratch_size; }
+    bool IsPermutable() const { return !m_permutation.empty(); }
+    bool IsParallel() const { return m_parallel_scratch_size > 0; }
+    const std::vector<uint32_t> &Permutation() const { return m_permutation; }
+
+private:
+    size_t m_length;
+    size_t m_nof_workers;
+    size_t m_scratch_size;
+    size_t m_parallel_scratch_size;
+
+    /* The number of adjacent columns (or rows) processed together by the
+       four-step algorithm. */
+    static constexpr size_t BLOCK_SIZE = 8;
+
+    /* The radices of the mixed-radix stages, in the order they are applied. */
+    std::vector<size_t> m_radices;
+
+    /* The factors exp(-2 pi i k / M) for k = 0, 1, ..., M - 1. */
+    std::vector<std::complex<double>> m_twiddles;
+
+    /* The digit-reversal permutation of the input indices. */
+    std::vector<uint32_t> m_permutation;
+
+    /* Bluestein's algorithm: the chirp exp(-i pi n^2 / M), the transform of
+       the (normalized) convolution kernel and the power-of-two transform used
+       to evaluate the convolution. */
+    std::vector<std::complex<double>> m_chirp;
+    std::vector<std::complex<double>> m_kernel;
+    std::unique_ptr<ComplexFourierTransform> m_convolution;
+
+    /* The four-step algorithm: the transforms over the columns (length M1) and
+       over the rows (length M2). The parallel scratch holds the intermediate
+       matrix followed by a block of `BLOCK_SIZE * max(M1, M2)` elements for
+       each worker. */
+    std::unique_ptr<ComplexFourierTransform> m_columns;
+    std::unique_ptr<ComplexFourierTransform> m_rows;
+
+    void Bluestein(std::complex<double> *y, std::complex<double> *scratch) const;
+    void BluesteinParallel(std::complex<double> *y, std::complex<double> *scratch,
+                           WorkerPool &pool) const;
+    void FourStep(std::complex<double> *y, std::complex<double> *scratch,
+                  WorkerPool &pool) const;
+};
+
+/* A precomputed plan for the discrete Fourier transform of a real-valued
+   sequence of a fixed length N. The plan holds the twiddle factors, the input
+   permutation and the scratch memory so that repeated transforms of the same
+   length don't have to recompute or allocate anything. A real sequence of even
+   length is transformed by packing it into a complex sequence of length N/2
+   (even samples in the real part, odd samples in the imaginary part),
+   transforming that and then splitting the result into the N/2 + 1
+   nonredundant bins of the real transform. This roughly halves the arithmetic
+   compared to a complex transform of the full length. Sequences of odd length
+   are transformed as complex sequences.
+
+   If the plan is constructed with a worker `pool`, the transform is
+   distributed over the threads of that pool. */
+class FourierTransformPlan
+{
+public:
+    FourierTransformPlan() = delete;
+    FourierTransformPlan(size_t length, std::shared_ptr<WorkerPool> pool = NULL);
+
+    /* Delete copy constructors until we need them. */
+    FourierTransformPlan(const FourierTransformPlan &other) = delete;
+    FourierTransformPlan &operator=(const FourierTransformPlan &other) = delete;
+
+    /* Check if the plan supports transforms of the target `length`. */
+    static bool IsSupported(size_t length);
+
+    /* Transform the real-valued input `x` (`length` samples) into the `length /
+       2 + 1` nonredundant bins of the spectrum, written to `y`. */
+    void Forward(const double *x, std::complex<double> *y);
+
+    /* Vector overload of the transform above, with size checks. Returns
+       `SCAPE_EINVAL` if the buffers do not match the length of the plan. */
+    int Forward(const std::vector<double> &x, std::vector<std::complex<double>> &y);
+
+    size_t Length() const { return m_length; }
+
+    /* The number of output bins, i.e. `length / 2 + 1`. */
+    size_t Bins() const { return m_length / 2 + 1; }
+
+    bool IsParallel() const { return m_pool != NULL; }
+
+private:
+    /* The length N of the real transform. */
+    size_t m_length;
+
+    /* The worker pool for a parallel transform, otherwise NULL. */
+    std::shared_ptr<WorkerPool> m_pool;
+
+    /* The complex transform of length N/2 (even N) or N (odd N). */
+    ComplexFourierTransform m_transform;
+
+    /* The factors exp(-2 pi i k / N) for k = 0, 1, ..., N/4, used to split the
+       transform of the packed sequence. */
+    std::vector<std::complex<double>> m_twiddles;
+
+    /* Working memory for the complex transform. */
+    std::vector<std::complex<double>> m_scratch;
+
+    /* Call `function(begin, end)` for ranges covering [0, count), in parallel
+       if the plan has a worker pool. */
+    void For(size_t count, const std::function<void(size_t, size_t)> &function);
+};
+
+/* A cache of the transform plan for the most recent length. A plan may use a
+   lot of memory, e.g. a Bluestein plan for a long record, so we don't hold on
+   to the plans of lengths we've moved on from. */
+class FourierTransformCache
+{
+public:
+    FourierTransformCache();
+
+    /* Get a plan for a transform of the target `length`, creating it on a
+       cache miss and replacing the cached plan. Returns NULL if the length is
+       not supported. */
+    std::shared_ptr<FourierTransformPlan> GetPlan(size_t length);
+
+    /* Transforms of at least `threshold` points are distributed over the
+       threads of the `pool`. A threshold of zero or a NULL pool disables the
+       parallel transforms. Plans affected by a change are dropped. */
+    void SetParallel(std::shared_ptr<WorkerPool> pool, size_t threshold);
+
+    /* Drop the cached plan. */
+    void Clear();
+
+private:
+    std::shared_ptr<FourierTransformPlan> m_plan;
+    std::shared_ptr<WorkerPool> m_pool;
+    size_t m_parallel_threshold;
+};
@@ -1,5 +1,7 @@
 /* This is an abstract base class to define a common interface for hotplug
-   events on different platforms. */
+   events on different platforms. The Linux implementation doesn't need a
+   thread of its own and provides the same interface on top of the shared
+   `EventLoop` instead. */
 
 #pragma once
 
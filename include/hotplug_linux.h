@@ -1,23 +1,37 @@
-/* Hotplug events on Linux using libudev. */
+/* Hotplug events on Linux using libudev. Instead of owning a thread, the
+   detector listens to the udev monitor on the shared `EventLoop` and only
+   enumerates the devices when the kernel reports a change to the PCI bus. If
+   the monitor cannot be set up, we fall back to enumerating periodically. */
 #pragma once
 
 #include "hotplug.h"
+#include "message_channels.h"
+#include "event_loop.h"
 #include <libudev.h>
 
-class HotplugLinux : public Hotplug
+class HotplugLinux : public MessageChannels<HotplugEvent>
 {
 public:
     HotplugLinux();
     ~HotplugLinux() override;
 
-    void MainLoop() override;
-    int Stop() override;
+    int Start();
+    int Stop();
 
 private:
+    static constexpr int POLL_PERIOD_MS = 1000;
+
+    EventLoop &m_loop;
     struct udev *m_handle;
+    struct udev_monitor *m_monitor;
     int m_nof_devices;
+    bool m_is_running;
+    uint64_t m_monitor_id;
+    uint64_t m_check_id;
 
     void CheckForEvents();
+    void ReceiveEvents();
     int CreateHandle();
+    int CreateMonitor();
     void DestroyHandle();
 };
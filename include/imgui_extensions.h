@@ -1,6 +1,7 @@
 #pragma once
 
 #include "imgui.h"
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -35,8 +36,10 @@ void RenderTableContents(const std::vector<std::vector<TableCell>> &rows);
 struct InputDoubleMetric
 {
 public:
+    /* Values below `minimum` are raised to the minimum when entered. */
     InputDoubleMetric(const std::string &label, double value, const std::string &format,
-                      double highest_prefix, ImGuiInputTextFlags flags = 0);
+                      double highest_prefix, ImGuiInputTextFlags flags = 0,
+                      double minimum = -std::numeric_limits<double>::infinity());
 
     /* We use Changed() to emulate the behavior of calling ImGui::InputDouble(). */
     bool Changed();
@@ -57,6 +60,7 @@ private:
     std::string format;
     double highest_prefix;
     ImGuiInputTextFlags flags;
+    double minimum;
 
     static int Callback(ImGuiInputTextCallbackData *data);
 };
@@ -43,6 +43,13 @@ public:
         StopMessageChannels();
     }
 
+    /* Attach an event that's set whenever there's a new message to receive
+       with `WaitForMessage`, e.g. to wait on several threads at once. */
+    void SetMessageEvent(std::shared_ptr<Event> event)
+    {
+        m_read_message_queue.SetEvent(std::move(event));
+    }
+
     /* Wait for a message, requiring a matching id. This function only returns
        messages that were pushed _with_ an id. */
     int WaitForMessage(T &message, int timeout, uint32_t id)
@@ -152,6 +159,13 @@ protected:
         uint32_t id{0};
     };
 
+    /* Attach an event that's set whenever a message is pushed to the derived
+       class, and when the message channels are stopped. */
+    void _SetMessageEvent(std::shared_ptr<Event> event)
+    {
+        m_write_message_queue.SetEvent(std::move(event));
+    }
+
     int StartMessageChannels()
     {
         RETURN_CALL(m_read_message_queue.Start());
@@ -56,9 +56,10 @@ public:
         /* We have to stop the message channels to be sure that we can join the
            thread. However, once the thread has finished, we want to restart the
            channels since we'd like to be able to queue up messages to the
-           thread while it's not running. */
-        this->StopMessageChannels();
+           thread while it's not running. The stop event is set first so that a
+           thread woken up by the stopped channels sees it right away. */
         m_signal_stop.set_value();
+        this->StopMessageChannels();
 
         m_thread.join();
         m_is_running = false;
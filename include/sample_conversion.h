@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* Statistics of the raw codes, gathered in the same pass as the conversion.
+   The sums are kept relative to the first code to avoid cancellation when the
+   mean is large compared to the spread. The codes are integers, so the sums
+   are exact as long as they fit in the 53-bit mantissa of a double. For
+   16-bit codes, a squared deviation fits in 32 bits and the sum of squares is
+   exact for at least 2^21 samples. For 32-bit codes, a single squared
+   deviation may exceed the mantissa and the sum of squares is rounded like
+   any other floating point sum. A code at (or beyond) either end of the code
+   range counts as clipped. */
+struct SampleStatistics
+{
+    double min;
+    double max;
+    double reference;
+    double sum;
+    double sum_of_squares;
+    size_t count;
+    size_t nof_clipped_low;
+    size_t nof_clipped_high;
+
+    double Mean() const
+    {
+        return count > 0 ? reference + sum / static_cast<double>(count) : 0.0;
+    }
+
+    double Variance() const
+    {
+        if (count == 0)
+            return 0.0;
+        const double n = static_cast<double>(count);
+        const double result = (sum_of_squares - sum * sum / n) / n;
+        return result > 0.0 ? result : 0.0;
+    }
+};
+
+/* The conversion of raw ADC codes into the values we process. Every sample of
+   every record passes through here, so the conversion is performed in a single
+   pass that produces both the time domain trace and the (windowed) input to the
+   Fourier transform, gathering the statistics of the codes on the way. The
+   kernels are specialized at compile time for the data format, the presence of
+   a window and the vertical conversion mode, and use SIMD instructions if the
+   processor supports them (selected at runtime).
+
+   The conversion of a linear power spectrum into decibels for presentation
+   shares the same instruction set selection. */
+class SampleConversion
+{
+public:
+    enum class InstructionSet
+    {
+        SCALAR,
+        SSE41,
+        AVX2,
+    };
+
+    /* Construct a conversion using the best instruction set the processor
+       supports. The time domain trace is converted into Volts if
+       `convert_vertical` is set, otherwise the codes are kept as they are. The
+       `input_range` and `dc_offset` are expected in millivolts. */
+    SampleConversion(double code_normalization, double input_range, double dc_offset,
+                     bool convert_vertical);
+
+    /* Construct a conversion using (at most) the target instruction set. */
+    SampleConversion(double code_normalization, double input_range, double dc_offset,
+                     bool convert_vertical, InstructionSet instruction_set);
+
+    /* Get the best instruction set supported by the processor. */
+    static InstructionSet GetSupportedInstructionSet();
+
+    /* Convert `count` samples from `data` into the time domain trace `y`. If
+       `fft` is not NULL, the first `nof_fft_samples` samples (at most `count`)
+       are also scaled to the unit range [-1, 1] and multiplied by the `window`
+       (if not NULL) before being written to `fft`. The trace may be stored in
+       single precision but the transform input is always double precision. The
+       trace is skipped if `y` is NULL. The `statistics` of the codes are
+       written to the target if not NULL. */
+    void Convert(const int16_t *data, size_t count, double *y, double *fft,
+                 size_t nof_fft_samples, const double *window,
+                 SampleStatistics *statistics = NULL) const;
+    void Convert(const int32_t *data, size_t count, double *y, double *fft,
+                 size_t nof_fft_samples, const double *window,
+                 SampleStatistics *statistics = NULL) const;
+    void Convert(const int16_t *data, size_t count, float *y, double *fft,
+                 size_t nof_fft_samples, const double *window,
+                 SampleStatistics *statistics = NULL) const;
+    void Convert(const int32_t *data, size_t count, float *y, double *fft,
+                 size_t nof_fft_samples, const double *window,
+                 SampleStatistics *statistics = NULL) const;
+
+    /* Convert `count` values of the linear power spectrum `power` into
+       decibels, i.e. `y[i] = 10 * log10(power[i]) + offset`, using (at most)
+       the target instruction set. The result is identical for every
+       instruction set. */
+    static void Decibels(const double *power, size_t count, double offset, double *y,
+                         InstructionSet instruction_set = GetSupportedInstructionSet());
+    static void Decibels(const double *power, size_t count, double offset, float *y,
+                         InstructionSet instruction_set = GetSupportedInstructionSet());
+
+    InstructionSet GetInstructionSet() const { return m_instruction_set; }
+
+    /* The trace is the affine transformation `code * TraceScale() + TraceOffset()`. */
+    double TraceScale() const { return m_convert_vertical ? m_trace_scale : 1.0; }
+    double TraceOffset() const { return m_convert_vertical ? m_trace_offset : 0.0; }
+
+private:
+    /* The trace is `code * m_trace_scale + m_trace_offset` and the transform
+       input is `code * m_unit_scale * window[i]`. Codes at or beyond either end
+       of the range [`m_code_low`, `m_code_high`] count as clipped. */
+    double m_trace_scale;
+    double m_trace_offset;
+    double m_unit_scale;
+    double m_code_low;
+    double m_code_high;
+    bool m_convert_vertical;
+    InstructionSet m_instruction_set;
+
+    template <typename T, typename U>
+    void Dispatch(const T *data, size_t count, U *y, double *fft, size_t nof_fft_samples,
+                  const double *window, SampleStatistics *statistics) const;
+
+    template <typename U>
+    static void DispatchDecibels(const double *power, size_t count, double offset, U *y,
+                                 InstructionSet instruction_set);
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "message_thread.h"
+#include "buffer_pool.h"
+#include "thread_safe_queue.h"
 #include <map>
 #include <deque>
 
@@ -8,16 +10,23 @@
    for objects of type `T` and channel-like interface to receive and return
    these objects. The assumption is that the derived class has a need to
    continuously create heap-allocated objects of type `T` and emit these to the
-   outside world. */
+   outside world. The objects are recycled through a `BufferPool` once every
+   reference to them has been dropped.
 
-template <typename T, typename M, bool PRESERVE = false>
+   The outbound queues are of type `Q<std::shared_ptr<T>>`. A derived class
+   that ejects buffers from a single thread (at a time) to a single reader may
+   use the bounded `SpscQueue` instead of the default `ThreadSafeQueue`. */
+
+template <typename T, typename M, bool PRESERVE = false,
+          template <typename> class Q = ThreadSafeQueue>
 class SmartBufferThread
-    : public MessageThread<SmartBufferThread<T, M, PRESERVE>, M>
+    : public MessageThread<SmartBufferThread<T, M, PRESERVE, Q>, M>
 {
 public:
     SmartBufferThread(size_t nof_channels = 1, size_t capacity = 0, bool persistent = false)
         : m_read_queues{}
         , m_preserved_buffers{}
+        , m_buffer_pool{}
         , m_mutex{}
     {
         for (size_t i = 0; i < nof_channels; ++i)
@@ -39,7 +48,7 @@ public:
         for (auto &q : m_read_queues)
             q.Start();
 
-        return MessageThread<SmartBufferThread<T, M, PRESERVE>, M>::Start();
+        return MessageThread<SmartBufferThread<T, M, PRESERVE, Q>, M>::Start();
     }
 
     virtual int Stop() override
@@ -47,7 +56,7 @@ public:
         for (auto &q : m_read_queues)
             q.Stop();
 
-        int result = MessageThread<SmartBufferThread<T, M, PRESERVE>, M>::Stop();
+        int result = MessageThread<SmartBufferThread<T, M, PRESERVE, Q>, M>::Stop();
 
         m_preserved_buffers.clear();
         return result;
@@ -75,14 +84,24 @@ public:
 
     virtual int ReturnBuffer(std::shared_ptr<T> buffer)
     {
-        /* We maintain a wait/return interface to potentially reuse memory
-           manually in the future. For now though, we always allocate/free and
-           let the OS handle the rest. As far as this function is concerned that
-           means just letting the use count drop to zero after removing it from
-           any active tracking. */
+        /* The memory is handed back to the buffer pool by the deleter of the
+           shared pointer. As far as this function is concerned that means just
+           letting the use count drop to zero after removing it from any active
+           tracking. */
         return ReturnBuffer(buffer.get());
     }
 
+    BufferPoolStatistics GetBufferPoolStatistics() const
+    {
+        return m_buffer_pool.GetStatistics();
+    }
+
+    /* Set the maximum number of buffers kept around for reuse. */
+    void SetBufferPoolCapacity(size_t capacity)
+    {
+        m_buffer_pool.SetCapacity(capacity);
+    }
+
     int GetTimeSinceLastActivity(int &milliseconds, int channel = 0)
     {
         return m_read_queues.at(channel).GetTimeSinceLastActivity(milliseconds);
@@ -104,25 +123,29 @@ public:
     }
 
 protected:
+    /* Get a buffer constructed as `T(count)` with `count` being the size in
+       bytes. A recycled buffer is returned as is, so it's up to the caller to
+       initialize the contents. */
     int ReuseOrAllocateBuffer(std::shared_ptr<T> &buffer, size_t count)
     {
-        try
-        {
-            /* Always allocate for now. */
-            buffer = std::make_shared<T>(count);
+        int result = m_buffer_pool.Get(buffer, count, count);
+        if (result != SCAPE_EOK)
+            return result;
 
-            if (PRESERVE)
+        if (PRESERVE)
+        {
+            try
             {
                 std::unique_lock<std::mutex> lock{m_mutex};
                 m_preserved_buffers.emplace(buffer.get(), buffer);
             }
-
-            return SCAPE_EOK;
-        }
-        catch (const std::bad_alloc &)
-        {
-            return SCAPE_EINTERNAL;
+            catch (const std::bad_alloc &)
+            {
+                return SCAPE_EINTERNAL;
+            }
         }
+
+        return SCAPE_EOK;
     }
 
     int EjectBuffer(const std::shared_ptr<T> &buffer, int channel = 0)
@@ -149,10 +172,10 @@ protected:
     }
 
 private:
-    /* We need a `std::deque` (and not `std::vector`) because the
-       `ThreadSafeQueue` cannot be moved or copied, which are requirements for
-       `std::vector`. */
-    std::deque<ThreadSafeQueue<std::shared_ptr<T>>> m_read_queues;
+    /* We need a `std::deque` (and not `std::vector`) because the queues
+       cannot be moved or copied, which are requirements for `std::vector`. */
+    std::deque<Q<std::shared_ptr<T>>> m_read_queues;
     std::map<const T *, std::shared_ptr<T>> m_preserved_buffers;
+    BufferPool<T> m_buffer_pool;
     std::mutex m_mutex;
 };
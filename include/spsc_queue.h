@@ -0,0 +1,294 @@
+/* This is a template class for a bounded, lock-free queue connecting exactly
+   one producer (calling `Write`) with exactly one consumer (calling `Read`).
+   It's a drop-in alternative to `ThreadSafeQueue` for the data paths where
+   that holds, e.g. the outbound record queues of a `SmartBufferThread`. The
+   producer may move between threads as long as the calls are serialized with
+   a happens-before relation, e.g. through a strand.
+
+   The entries are kept in a ring of `capacity` slots rounded up to a power of
+   two. The producer only writes the tail index and the consumer only writes
+   the head index, so the common case is a slot copy and an index store. The
+   two indices live on separate cache lines so the threads don't invalidate
+   each other's line on every call. Blocking is optional: a nonzero timeout
+   parks the thread on a condition variable that the other side only signals
+   if there's someone waiting.
+
+   Unlike `ThreadSafeQueue`, the capacity must be finite and there's no
+   persistent mode or read predicate. `Start` returns SCAPE_EINVAL or
+   SCAPE_EUNSUPPORTED respectively if asked for either. Restarting the queue
+   discards its contents, but the entries are released by the consumer as it
+   skips past them on its next read. */
+
+#pragma once
+
+#include "error.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class SpscQueue
+{
+public:
+    SpscQueue(size_t capacity, bool is_persistent = false)
+        : m_head(0)
+        , m_tail(0)
+        , m_discard(0)
+        , m_capacity(capacity)
+        , m_mask(RingSize(capacity) - 1)
+        , m_is_persistent(is_persistent)
+        , m_slots(RingSize(capacity))
+        , m_is_started(false)
+        , m_stop_count(0)
+        , m_last_write_timestamp(0)
+        , m_nof_waiting(0)
+        , m_mutex()
+        , m_not_empty()
+        , m_not_full()
+    {
+    }
+
+    virtual ~SpscQueue()
+    {
+        Stop();
+    }
+
+    SpscQueue(const SpscQueue &other) = delete;
+    SpscQueue &operator=(const SpscQueue &other) = delete;
+
+    /* Start the queue, discarding any entries left over from an earlier
+       session. This may be called from the producer's side while the consumer
+       is running. */
+    int Start()
+    {
+        if (m_capacity == 0)
+            return SCAPE_EINVAL;
+        if (m_is_persistent)
+            return SCAPE_EUNSUPPORTED;
+        if (m_is_started)
+            return SCAPE_ENOTREADY;
+
+        m_discard.store(m_tail.load(std::memory_order_relaxed), std::memory_order_release);
+        m_last_write_timestamp = Now();
+        m_is_started = true;
+        return SCAPE_EOK;
+    }
+
+    /* Stop the queue, interrupting any blocked `Read` or `Write`. */
+    int Stop()
+    {
+        if (!m_is_started)
+            return SCAPE_ENOTREADY;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            ++m_stop_count;
+            m_is_started = false;
+        }
+
+        m_not_empty.notify_all();
+        m_not_full.notify_all();
+        return SCAPE_EOK;
+    }
+
+    /* Consumer side. A negative timeout waits indefinitely. */
+    int Read(T &value, int timeout)
+    {
+        if (!m_is_started)
+            return SCAPE_ENOTREADY;
+
+        /* Skip past any discarded entries and publish the new head before we
+           wait, so the producer sees the freed slots right away. */
+        size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t discard = m_discard.load(std::memory_order_acquire);
+        if (static_cast<std::ptrdiff_t>(discard - head) > 0)
+        {
+            while (head != discard)
+                m_slots[head++ & m_mask] = T{};
+            m_head.store(head, std::memory_order_seq_cst);
+            Notify(m_not_full);
+        }
+
+        RETURN_CALL(Wait(m_not_empty, timeout, [&]() {
+            return m_tail.load(std::memory_order_acquire) != head;
+        }));
+
+        /* Move the entry out and leave the slot empty so that we don't hold on
+           to any resources until the ring wraps around. */
+        value = std::move(m_slots[head & m_mask]);
+        m_slots[head & m_mask] = T{};
+        m_head.store(head + 1, std::memory_order_seq_cst);
+        Notify(m_not_full);
+        return SCAPE_EOK;
+    }
+
+    /* Producer side. A negative timeout waits indefinitely. */
+    int Write(const T &value, int timeout = 0)
+    {
+        if (!m_is_started)
+            return SCAPE_ENOTREADY;
+
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        int result = Wait(m_not_full, timeout, [&]() {
+            return tail - m_head.load(std::memory_order_acquire) < m_capacity;
+        });
+        if (result != SCAPE_EOK)
+            return result;
+
+        m_slots[tail & m_mask] = value;
+        m_last_write_timestamp.store(Now(), std::memory_order_relaxed);
+        m_tail.store(tail + 1, std::memory_order_seq_cst);
+        Notify(m_not_empty);
+        return SCAPE_EOK;
+    }
+
+    template <class... Args>
+    int EmplaceWrite(Args &&... args)
+    {
+        return Write(T(std::forward<Args>(args)...), 0);
+    }
+
+    bool IsFull()
+    {
+        /* If the queue is not started, we report it as full (and empty). */
+        if (!m_is_started)
+            return true;
+
+        return Size() >= m_capacity;
+    }
+
+    bool IsEmpty()
+    {
+        /* If the queue is not started, we report it as empty (and full). */
+        if (!m_is_started)
+            return true;
+
+        return Size() == 0;
+    }
+
+    double GetOccupancy()
+    {
+        if (m_capacity == 0)
+            return 0.0;
+        return static_cast<double>(Size()) / static_cast<double>(m_capacity);
+    }
+
+    int GetTimeSinceLastActivity(int &milliseconds)
+    {
+        if (!m_is_started)
+            return SCAPE_ENOTREADY;
+
+        const auto delta = std::chrono::nanoseconds(Now() - m_last_write_timestamp.load());
+        milliseconds =
+            static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(delta).count());
+        return SCAPE_EOK;
+    }
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    /* The indices increase monotonically and are mapped to a slot by masking.
+       The entries in [m_discard, m_tail) are discarded if m_discard is ahead
+       of m_head. */
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_discard;
+
+    alignas(CACHE_LINE_SIZE) const size_t m_capacity;
+    const size_t m_mask;
+    const bool m_is_persistent;
+    std::vector<T> m_slots;
+    std::atomic_bool m_is_started;
+    uint64_t m_stop_count;
+    std::atomic<int64_t> m_last_write_timestamp;
+
+    /* The slow path used when a thread has to block. */
+    std::atomic_int m_nof_waiting;
+    std::mutex m_mutex;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+
+    static size_t RingSize(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+    static int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    size_t Size() const
+    {
+        /* Load the head first, since it can only catch up with the tail. */
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t discard = m_discard.load(std::memory_order_acquire);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        if (static_cast<std::ptrdiff_t>(discard - head) > 0)
+            return tail - discard;
+        return tail - head;
+    }
+
+    /* Wait on `condition_variable` until `condition` is true, SCAPE_EAGAIN if
+       the deadline passes and SCAPE_EINTERRUPTED if the queue is stopped. We
+       announce ourselves through `m_nof_waiting` before checking the
+       condition under the lock. Paired with the sequentially consistent index
+       store in `Notify`, either we see the new index or the other side sees
+       us waiting and takes the lock to signal. The caller checks
+       `m_is_started` without the lock, so we check it again under the lock in
+       case a `Stop` completed before the snapshot of the stop count. */
+    template <typename Condition>
+    int Wait(std::condition_variable &condition_variable, int timeout, Condition condition)
+    {
+        if (condition())
+            return SCAPE_EOK;
+        if (timeout == 0)
+            return SCAPE_EAGAIN;
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_is_started)
+            return condition() ? SCAPE_EOK : SCAPE_EINTERRUPTED;
+
+        const uint64_t stop_count = m_stop_count;
+        const auto IsDone = [&]() {
+            return m_stop_count != stop_count || !m_is_started || condition();
+        };
+
+        m_nof_waiting.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool is_done = true;
+        if (timeout < 0)
+            condition_variable.wait(lock, IsDone);
+        else
+            is_done = condition_variable.wait_until(lock, deadline, IsDone);
+        m_nof_waiting.fetch_sub(1, std::memory_order_relaxed);
+
+        if (condition())
+            return SCAPE_EOK;
+        return is_done ? SCAPE_EINTERRUPTED : SCAPE_EAGAIN;
+    }
+
+    void Notify(std::condition_variable &condition_variable)
+    {
+        if (m_nof_waiting.load(std::memory_order_seq_cst) == 0)
+            return;
+
+        /* Taking the lock orders us after the waiter's check of the condition. */
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+        }
+        condition_variable.notify_all();
+    }
+};
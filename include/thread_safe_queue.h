@@ -8,32 +8,42 @@
 
    Additionally, a predicate can be supplied to `Read` for remove-if-style
    functionality. This can be used to implement traced queue entries on a higher
-   level. */
+   level.
+
+   Blocking calls sleep on a condition variable until the queue changes state,
+   the deadline passes or the queue is stopped. A thread that has to wait for
+   several sources at once can instead attach an `Event` that's set on every
+   write and when the queue is stopped. */
 
 #pragma once
 
 #include "error.h"
+#include "event.h"
 
 #include <queue>
 #include <mutex>
-#include <future>
+#include <condition_variable>
 #include <chrono>
 #include <functional>
 #include <atomic>
+#include <cstdint>
+#include <memory>
 
 template <typename T>
 class ThreadSafeQueue
 {
 public:
     ThreadSafeQueue(size_t capacity = 0, bool is_persistent = false)
-        : m_signal_stop()
-        , m_should_stop()
+        : m_stop_count(0)
         , m_is_started(false)
         , m_is_persistent(is_persistent)
         , m_mutex()
+        , m_not_empty()
+        , m_not_full()
         , m_queue()
         , m_capacity(capacity)
         , m_last_write_timestamp()
+        , m_event()
     {
     }
 
@@ -50,9 +60,8 @@ public:
         if (m_is_started)
             return SCAPE_ENOTREADY;
 
+        std::unique_lock<std::mutex> lock(m_mutex);
         m_queue = {}; /* TODO: Not ok if we ever want to have stuff prequeued. */
-        m_signal_stop = std::promise<void>();
-        m_should_stop = m_signal_stop.get_future();
         m_last_write_timestamp = std::chrono::high_resolution_clock::now();
         m_is_started = true;
         return SCAPE_EOK;
@@ -63,20 +72,43 @@ public:
         if (!m_is_started)
             return SCAPE_ENOTREADY;
 
-        m_signal_stop.set_value();
-        m_is_started = false;
+        /* Bumping the stop count interrupts any thread blocked in `Read` or
+           `Write`, even if the queue is restarted before it gets to run. */
+        std::shared_ptr<Event> event;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            ++m_stop_count;
+            m_is_started = false;
+            event = m_event;
+        }
+
+        m_not_empty.notify_all();
+        m_not_full.notify_all();
+        if (event)
+            event->Set();
         return SCAPE_EOK;
     }
 
+    /* Attach an event to set on every write, or detach it with NULL. */
+    void SetEvent(std::shared_ptr<Event> event)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_event = std::move(event);
+    }
+
     /* Only compiles when <T> is a pointer type. */
     void Free()
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        while (!m_queue.empty())
         {
-            delete m_queue.front();
-            m_queue.pop();
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_queue.empty())
+            {
+                delete m_queue.front();
+                m_queue.pop();
+            }
         }
+
+        m_not_full.notify_all();
     }
 
     int Read(
@@ -86,46 +118,29 @@ public:
         if (!m_is_started)
             return SCAPE_ENOTREADY;
 
-        if (timeout < 0)
+        std::unique_lock<std::mutex> lock(m_mutex);
+        int result = Wait(lock, m_not_empty, timeout, [&]() {
+            return m_queue.size() > 0 && predicate(m_queue.front());
+        });
+        if (result != SCAPE_EOK)
+            return result;
+
+        const size_t size = m_queue.size();
+        result = Pop(value);
+        const bool popped = m_queue.size() < size;
+        const bool more = !m_queue.empty();
+        lock.unlock();
+
+        /* Readers with a different predicate may be waiting for the entry that
+           is now at the front of the queue. */
+        if (popped)
         {
-            /* Waiting indefinitely */
-            for (;;)
-            {
-                std::unique_lock<std::mutex> lock(m_mutex);
-                if (m_queue.size() > 0 && predicate(m_queue.front()))
-                    return Pop(value);
-                lock.unlock();
-
-                if (m_should_stop.wait_for(std::chrono::milliseconds(10)) == std::future_status::ready)
-                    return SCAPE_EINTERRUPTED;
-            }
+            m_not_full.notify_one();
+            if (more)
+                m_not_empty.notify_all();
         }
-        else if (timeout == 0)
-        {
-            /* Immediate */
-            std::unique_lock<std::mutex> lock(m_mutex);
-            if (m_queue.size() > 0 && predicate(m_queue.front()))
-                return Pop(value);
-            else
-                return SCAPE_EAGAIN;
-        }
-        else
-        {
-            int waited_ms = 0;
-            while (waited_ms < timeout)
-            {
-                std::unique_lock<std::mutex> lock(m_mutex);
-                if (m_queue.size() > 0 && predicate(m_queue.front()))
-                    return Pop(value);
-                lock.unlock();
-
-                ++waited_ms;
-                if (m_should_stop.wait_for(std::chrono::milliseconds(1)) == std::future_status::ready)
-                    return SCAPE_EINTERRUPTED;
-            }
 
-            return SCAPE_EAGAIN;
-        }
+        return result;
     }
 
     int Write(const T &value, int timeout = 0)
@@ -133,64 +148,25 @@ public:
         if (!m_is_started)
             return SCAPE_ENOTREADY;
 
-        std::unique_lock<std::mutex> lock(m_mutex);
-
         /* The timeout is only applicable if the queue has a finite capacity. */
-        if (m_capacity > 0 && m_queue.size() >= m_capacity)
-        {
-            lock.unlock();
-
-            if (timeout < 0)
-            {
-                /* Waiting indefinitely */
-                for (;;)
-                {
-                    lock.lock();
-                    if (m_queue.size() < m_capacity)
-                    {
-                        m_last_write_timestamp = std::chrono::high_resolution_clock::now();
-                        m_queue.emplace(value);
-                        return SCAPE_EOK;
-                    }
-                    lock.unlock();
-
-                    if (m_should_stop.wait_for(std::chrono::milliseconds(10)) == std::future_status::ready)
-                        return SCAPE_EINTERRUPTED;
-                }
-            }
-            else if (timeout == 0)
-            {
-                /* Immediate */
-                return SCAPE_EAGAIN;
-            }
-            else
-            {
-                int waited_ms = 0;
-                while (waited_ms < timeout)
-                {
-                    lock.lock();
-                    if (m_queue.size() < m_capacity)
-                    {
-                        m_last_write_timestamp = std::chrono::high_resolution_clock::now();
-                        m_queue.emplace(value);
-                        return SCAPE_EOK;
-                    }
-                    lock.unlock();
-
-                    ++waited_ms;
-                    if (m_should_stop.wait_for(std::chrono::milliseconds(1)) == std::future_status::ready)
-                        return SCAPE_EINTERRUPTED;
-                }
-
-                return SCAPE_EAGAIN;
-            }
-        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        int result = Wait(lock, m_not_full, timeout, [&]() {
+            return m_capacity == 0 || m_queue.size() < m_capacity;
+        });
+        if (result != SCAPE_EOK)
+            return result;
 
         m_last_write_timestamp = std::chrono::high_resolution_clock::now();
         m_queue.emplace(value);
+        const auto event = m_event;
+        lock.unlock();
+
+        /* Every reader has to get a chance to evaluate its predicate. */
+        m_not_empty.notify_all();
+        if (event)
+            event->Set();
         return SCAPE_EOK;
     }
-
     /* An `emplace_back`-style call, forwarding the arguments to a matching
        constructor for a new object of type `T`. */
     template<class... Args>
@@ -241,14 +217,57 @@ public:
     }
 
 private:
-    std::promise<void> m_signal_stop;
-    std::future<void> m_should_stop;
+    uint64_t m_stop_count;
     std::atomic_bool m_is_started;
     std::atomic_bool m_is_persistent;
     std::mutex m_mutex;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
     std::queue<T> m_queue;
     size_t m_capacity;
     std::chrono::high_resolution_clock::time_point m_last_write_timestamp;
+    std::shared_ptr<Event> m_event;
+
+    /* Wait on `condition_variable` until `condition` is true. The mutex must
+       be held through `lock`. A negative timeout waits indefinitely and a
+       zero timeout doesn't wait at all. We return SCAPE_EINTERRUPTED if the
+       queue is stopped while waiting and SCAPE_EAGAIN if the deadline passes.
+       The deadline is fixed on entry so wakeups that find the condition false
+       don't extend the total wait. The caller checks `m_is_started` without
+       the lock, so we check it again here: a `Stop` that completes before we
+       take the snapshot of the stop count would otherwise go unnoticed. */
+    template <typename Condition>
+    int Wait(std::unique_lock<std::mutex> &lock, std::condition_variable &condition_variable,
+             int timeout, Condition condition)
+    {
+        if (condition())
+            return SCAPE_EOK;
+        if (!m_is_started)
+            return SCAPE_EINTERRUPTED;
+        if (timeout == 0)
+            return SCAPE_EAGAIN;
+
+        const uint64_t stop_count = m_stop_count;
+        const auto IsDone = [&]() {
+            return m_stop_count != stop_count || !m_is_started || condition();
+        };
+
+        if (timeout < 0)
+        {
+            condition_variable.wait(lock, IsDone);
+        }
+        else
+        {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+            if (!condition_variable.wait_until(lock, deadline, IsDone))
+                return SCAPE_EAGAIN;
+        }
+
+        /* A pending entry takes precedence over the stop. */
+        if (condition())
+            return SCAPE_EOK;
+        return SCAPE_EINTERRUPTED;
+    }
 
     int Pop(T &value)
     {
@@ -23,6 +23,7 @@
 #endif
 
 #include <vector>
+#include <map>
 #include <set>
 #include <filesystem>
 
@@ -212,6 +213,10 @@ private:
     } m_libadq;
     ImGui::FileBrowser m_file_browser;
 
+    /* The rows of the waterfall being shown, copied out of the ring buffer
+       shared with the processing. The memory is reused from frame to frame. */
+    std::vector<RecordValue> m_waterfall_rows;
+
     void InitializeEmbeddedPython();
 
     void ClearChannelSelection();
@@ -279,7 +284,7 @@ private:
     static void RemoveDoubleClickedMarkers(Markers &markers);
 
     static void SnapX(double x, const BaseRecord *record, double &snap_x, double &snap_y);
-    static void GetClosestSampleIndex(double x, double y, const BaseRecord *record,
+    static bool GetClosestSampleIndex(double x, double y, const BaseRecord *record,
                                       const ImPlotRect &view, size_t &index);
 
     void PlotSensorsSelected();
@@ -1,8 +1,8 @@
 #pragma once
 
-#include <map>
 #include <memory>
 #include <functional>
+#include <vector>
 
 enum class WindowType
 {
@@ -29,6 +29,9 @@ struct Window
     double amplitude_to_energy;
 };
 
+/* A cache of the window of the most recent length, per window type. With the
+   transform length following the record length, we can't keep a window for
+   every length we come across. */
 class WindowCache
 {
 public:
@@ -36,16 +39,16 @@ public:
     std::shared_ptr<Window> GetWindow(WindowType type, size_t length);
 
 private:
-    std::shared_ptr<Window> GetWindow(std::map<size_t, std::shared_ptr<Window>> &windows,
-                                      size_t length, std::function<double(size_t, size_t)> f);
+    std::shared_ptr<Window> GetWindow(std::shared_ptr<Window> &cached, size_t length,
+                                      std::function<double(size_t, size_t)> f);
 
     static double Hamming(size_t i, size_t length);
     static double BlackmanHarris(size_t i, size_t length);
     static double Hanning(size_t i, size_t length);
     static double FlatTop(size_t i, size_t length);
 
-    std::map<size_t, std::shared_ptr<Window>> hamming_windows;
-    std::map<size_t, std::shared_ptr<Window>> blackman_harris_windows;
-    std::map<size_t, std::shared_ptr<Window>> hanning_windows;
-    std::map<size_t, std::shared_ptr<Window>> flat_top_windows;
+    std::shared_ptr<Window> hamming_window;
+    std::shared_ptr<Window> blackman_harris_window;
+    std::shared_ptr<Window> hanning_window;
+    std::shared_ptr<Window> flat_top_window;
 };
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* A work-stealing pool of worker threads shared by all the digitizers. Tasks
+   posted from a worker thread end up in that worker's own queue, which it
+   processes newest first to keep the data in cache. Idle workers steal the
+   oldest tasks from the other queues. The pool runs both the per-record
+   processing (serialized per channel through a `Strand`) and data parallel
+   work, e.g. splitting a long Fourier transform into many short ones. */
+class WorkerPool
+{
+public:
+    WorkerPool() = delete;
+    WorkerPool(size_t nof_threads, const std::vector<int> &affinity = {});
+    ~WorkerPool();
+
+    /* Delete copy constructors until we need them. */
+    WorkerPool(const WorkerPool &other) = delete;
+    WorkerPool &operator=(const WorkerPool &other) = delete;
+
+    /* Get the pool shared by the application. By default, the pool is sized to
+       use every core. The number of threads and the cores they're allowed to
+       run on can be set with the environment variables
+       `SIGSCAPE_WORKER_THREADS` and `SIGSCAPE_WORKER_AFFINITY`, the latter
+       being a list of cores, e.g. "2-5,8". */
+    static std::shared_ptr<WorkerPool> Shared();
+
+    /* Parse a list of cores on the form "0,2-4" into its individual entries. */
+    static int ParseCpuList(const std::string &str, std::vector<int> &cpus);
+
+    /* Queue a task to run on the pool. The task runs on the calling thread if
+       the pool doesn't have any threads. */
+    void Post(std::function<void()> task);
+
+    /* Call `function(begin, end)` for consecutive ranges covering [0, count)
+       and return once every range has been processed. The calling thread
+       processes ranges too, so this may be called from within a task running
+       on the pool without risking a deadlock. */
+    void ParallelFor(size_t count, const std::function<void(size_t, size_t)> &function);
+
+    /* The number of threads that may work on a call to `ParallelFor`,
+       including the calling thread. */
+    size_t GetConcurrency() const { return m_threads.size() + 1; }
+
+    /* Tasks posted to a strand run on the pool one at a time, in the order
+       they were posted. Different strands run concurrently. We use one strand
+       per channel, which preserves the order of the records while letting the
+       channels share the pool. A strand with a steady stream of tasks yields
+       its worker between batches, so a busy channel can't starve the others
+       when there are more channels than workers. */
+    class Strand
+    {
+    public:
+        Strand(std::shared_ptr<WorkerPool> pool);
+
+        void Post(std::function<void()> task);
+
+    private:
+        struct State
+        {
+            std::mutex mutex{};
+            std::deque<std::function<void()>> tasks{};
+            bool is_scheduled{false};
+        };
+
+        std::shared_ptr<WorkerPool> m_pool;
+        std::shared_ptr<State> m_state;
+
+        static void Run(WorkerPool *pool, std::shared_ptr<State> state);
+    };
+
+private:
+    struct Queue
+    {
+        std::mutex mutex{};
+        std::deque<std::function<void()>> tasks{};
+    };
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_next_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_signal;
+    size_t m_nof_tasks;
+    bool m_should_stop;
+
+    /* Queue a task behind every task already queued on the calling worker,
+       letting other work run first. This is how a strand yields its worker.
+       Behaves like `Post` if not called from a worker of this pool. */
+    void Defer(std::function<void()> task);
+
+    void MainLoop(size_t index);
+    bool TryPop(size_t index, std::function<void()> &task);
+    static void SetAffinity(std::thread &thread, int cpu);
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "smart_buffer_thread.h"
+#include "spsc_queue.h"
 #include "error.h"
 #include "ADQAPI.h"
 #include "nlohmann/json.hpp"
@@ -11,7 +12,8 @@
    implement the basic properties of a generator. Classes inheriting from this
    one must implement a `Generate` method to create ADQGen4Records that go into
    one or more output channels. This method gets called with a rate specified by
-   the return value of `GetTriggerFrequency`. */
+   the return value of `GetTriggerFrequency`. Each output channel is read by
+   a single thread, so the outbound queues are `SpscQueue`s. */
 
 enum class GeneratorMessageId
 {
@@ -45,7 +47,7 @@ struct GeneratorMessage
 };
 
 class Generator
-    : public SmartBufferThread<ADQGen4Record, GeneratorMessage, true>
+    : public SmartBufferThread<ADQGen4Record, GeneratorMessage, true, SpscQueue>
 {
 public:
     Generator(size_t nof_channels)
@@ -1,24 +1,34 @@
 #include "data_processing.h"
 
-#include "fft.h"
-#include "fft_settings.h"
 #include "log.h"
+#include "worker_pool.h"
 
 #include "ADQAPI.h"
 
 #include <cinttypes>
+#include <cstring>
 #include <set>
 
 DataProcessingParameters::DataProcessingParameters()
     : window_type(WindowType::FLAT_TOP)
     , fft_scaling(FrequencyDomainScaling::AMPLITUDE)
+    , fft_length(TransformLength::TRUNCATE)
+    , fft_parallel_threshold(1 << 20)
+    , waterfall_depth(32)
+    , nof_recycled_records(BufferPool<ProcessedRecord>::DEFAULT_CAPACITY)
+    , welch_segment_length(0)
+    , zoom_center_frequency(0.0)
+    , zoom_span(0.0)
     , nof_skirt_bins(5)
+    , fft_averaging(FrequencyDomainAveraging::MOVING)
     , nof_fft_averages(1)
     , fundamental_frequency(-1.0)
     , convert_horizontal(true)
     , convert_vertical(true)
     , fullscale_enob(true)
     , fft_maximum_hold(false)
+    , tone_tracking(false)
+    , full_rate_metrics(false)
 {}
 
 DataProcessing::Tone::Tone(const FrequencyDomainRecord &record, double f, size_t nof_skirt_bins)
@@ -32,26 +42,20 @@ DataProcessing::Tone::Tone(const FrequencyDomainRecord &record, double f, size_t
     , values{}
 {
     /* We use the same approach as for the tone analysis identifying the
-       fundamental tone (with interpolation). We assume that the processed
-       record's frequency domain contents has values converted to decibels full
-       scale, so we have to reverse that conversion for the surrounding bins.
-       Still, it's more efficient to do it this way than to loop over the entire
-       spectrum again just to convert to decibels. */
+       fundamental tone (with interpolation), reading the bins surrounding the
+       frequency `f` from the record's linear power spectrum. */
 
-    const auto &y = record.y;
     const auto &bin_range = record.step;
-    const auto &scale_factor = record.scale_factor;
-    const auto &energy_factor = record.energy_factor;
-    const int lidx = static_cast<int>(f / bin_range + 0.5); /* FIXME: std::round? */
+    const int lidx = static_cast<int>((f - record.start) / bin_range + 0.5); /* FIXME: std::round? */
 
     idx_low = static_cast<size_t>(std::max(lidx - static_cast<int>(nof_skirt_bins), 0));
-    idx_high = std::min(lidx + nof_skirt_bins, record.x.size() - 1);
+    idx_high = std::min(lidx + nof_skirt_bins, record.power.size() - 1);
 
     double numerator = 0.0;
     double denominator = 0.0;
     for (size_t i = idx_low; i <= idx_high; ++i)
     {
-        const double bin_power = std::pow(10, y[i] / 10) / scale_factor * energy_factor;
+        const double bin_power = record.power[i];
         numerator += static_cast<double>(i - idx_low) * bin_power;
         denominator += bin_power;
         values.push_back(bin_power);
@@ -60,7 +64,7 @@ DataProcessing::Tone::Tone(const FrequencyDomainRecord &record, double f, size_t
     const double center_of_mass = static_cast<double>(idx_low) + (numerator / denominator);
     idx = static_cast<size_t>(center_of_mass + 0.5);
     idx_fraction = center_of_mass - static_cast<double>(idx);
-    frequency = bin_range * center_of_mass;
+    frequency = record.start + bin_range * center_of_mass;
 
     /* This power estimation does not take overlaps into account. This must
        be handled separately. */
@@ -77,7 +81,7 @@ std::string DataProcessing::Tone::Stringify() const
 
 DataProcessing::DataProcessing(void *handle, int index, int channel, const std::string &label,
                                const ADQConstantParameters &constant)
-    : SmartBufferThread<ProcessedRecord, DataProcessingMessage>{1, 100, false}
+    : SmartBufferThread<ProcessedRecord, DataProcessingMessage, false, SpscQueue>{1, 100, false}
     , m_handle{handle}
     , m_index{index}
     , m_channel{channel}
@@ -85,13 +89,41 @@ DataProcessing::DataProcessing(void *handle, int index, int channel, const std::
     , m_afe{1000.0, 0.0}
     , m_constant{constant}
     , m_window_cache()
+    , m_fourier_transform_cache()
+    , m_fft_input{}
+    , m_fft_output{}
+    , m_periodogram{}
     , m_parameters{}
     , m_time_domain_metrics{}
-    , m_waterfall{}
+    , m_waterfall{NULL}
     , m_noise_moving_average{}
     , m_fft_moving_average{}
+    , m_fft_exponential_average{}
     , m_fft_maximum_hold{}
+    , m_processed_record_pool{BufferPool<ProcessedRecord>::DEFAULT_CAPACITY,
+                              [](ProcessedRecord &record) {
+                                  /* Let go of the parts so they can be recycled on their own. */
+                                  record.time_domain.reset();
+                                  record.frequency_domain.reset();
+                                  record.waterfall.reset();
+                              }}
+    , m_time_domain_pool{}
+    , m_frequency_domain_pool{}
+    , m_host_record_pool{}
+    , m_strand{WorkerPool::Shared()}
+    , m_records_mutex{}
+    , m_records_signal{}
+    , m_nof_records_in_flight{0}
+    , m_full_rate_metrics{false}
+    , m_welch_slots{}
+    , m_downconverter{}
+    , m_zoom_baseband{}
+    , m_zoom_transform{}
+    , m_zoom_scratch{}
 {
+    /* Long transforms are distributed over the threads of the shared pool. */
+    m_fourier_transform_cache.SetParallel(WorkerPool::Shared(),
+                                          m_parameters.fft_parallel_threshold);
 }
 
 DataProcessing::~DataProcessing()
@@ -99,6 +131,19 @@ DataProcessing::~DataProcessing()
     Stop();
 }
 
+DataProcessing::HostRecord::HostRecord()
+    : header{}
+    , data{}
+{
+}
+
+void DataProcessing::HostRecord::Assign(const ADQGen4Record *raw, size_t size)
+{
+    header = *raw->header;
+    data.resize(size);
+    std::memcpy(data.data(), raw->data, size);
+}
+
 void DataProcessing::MainLoop()
 {
     m_thread_exit_code = SCAPE_EOK;
@@ -112,24 +157,46 @@ void DataProcessing::MainLoop()
         if (m_should_stop.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
             break;
 
-        /* Process any messages posted to the thread. */
-        ProcessMessages();
+        /* Hold off on getting another record until there's room in the
+           pipeline. Leaving the filled buffers with the digitizer throttles
+           the acquisition, just as if we processed the records right here. */
+        {
+            std::unique_lock lock{m_records_mutex};
+            if (!m_records_signal.wait_for(lock, std::chrono::milliseconds(100), [&] {
+                    return m_nof_records_in_flight < MAX_RECORDS_IN_FLIGHT;
+                }))
+            {
+                continue;
+            }
+        }
 
         ADQGen4Record *time_domain = NULL;
         int channel = m_channel;
         int64_t bytes_received = ADQ_WaitForRecordBuffer(m_handle, m_index, &channel,
                                                          (void **)&time_domain, 100, NULL);
 
+        /* Make sure that any messages posted to the thread are processed even
+           if there are no records to carry them. */
+        const auto PostMessagesOnly = [&]() {
+            std::unique_lock lock{m_records_mutex};
+            if (m_nof_records_in_flight == 0)
+            {
+                lock.unlock();
+                PostRecord(NULL, 0.0, 0.0);
+            }
+        };
+
         /* Continue on timeout. */
         if (bytes_received == ADQ_EAGAIN || bytes_received == ADQ_ENOTREADY || bytes_received == ADQ_EINTERRUPTED)
         {
+            PostMessagesOnly();
             continue;
         }
         else if (bytes_received < 0)
         {
             Log::log->error(FormatLog("Failed to get a time domain buffer {}.", bytes_received));
             m_thread_exit_code = SCAPE_EINTERNAL;
-            return;
+            break;
         }
 
         /* TODO: Low-pass filter these values. Average over the last N record should do. */
@@ -139,45 +206,133 @@ void DataProcessing::MainLoop()
         const double estimated_throughput = bytes_received * estimated_trigger_frequency;
         time_point_last_record = time_point_this_record;
 
-        /* We only allocate memory and process the record if we know that we're
-           going to show it, i.e. if the outbound queue has space available. */
-        if (!IsFull())
+        /* Copy the record into host memory and return the DMA buffer right
+           away. Holding on to it while the record is processed leaves the
+           digitizer with fewer buffers to fill, which eventually overflows its
+           memory at trigger rates we could otherwise sustain. We only allocate
+           memory and copy the record if we know that we're going to show it,
+           i.e. if the outbound queue has space available, or if we're
+           computing the metrics of every record. */
+        std::shared_ptr<HostRecord> host_record = NULL;
+        if (!IsFull() || m_full_rate_metrics)
         {
-            auto processed_record = std::make_shared<ProcessedRecord>(
-                m_label, estimated_trigger_frequency, estimated_throughput);
-
-            if (SCAPE_EOK == ProcessRecord(time_domain, *processed_record))
-                EjectBuffer(processed_record);
+            const size_t size = static_cast<size_t>(bytes_received);
+            if (SCAPE_EOK == m_host_record_pool.Get(host_record, size))
+                host_record->Assign(time_domain, size);
+            else
+                Log::log->error(FormatLog("Failed to allocate memory for a record."));
         }
 
         ADQ_ReturnRecordBuffer(m_handle, m_index, channel, time_domain);
+
+        if (host_record != NULL)
+            PostRecord(std::move(host_record), estimated_trigger_frequency, estimated_throughput);
+        else
+            PostMessagesOnly();
     }
 
+    /* The tasks refer to this object, so they have to finish before we return. */
+    WaitForRecordsInFlight(0);
     Log::log->trace(FormatLog("Stopping data processing."));
 }
 
-template <typename T>
-size_t DataProcessing::NextPowerOfTwo(T i)
+void DataProcessing::PostRecord(std::shared_ptr<HostRecord> time_domain,
+                                double estimated_trigger_frequency, double estimated_throughput)
 {
-    return static_cast<size_t>(std::pow(2, std::ceil(std::log2(i))));
+    {
+        std::unique_lock lock{m_records_mutex};
+        m_nof_records_in_flight++;
+    }
+
+    m_strand.Post([=]() {
+        /* Process any messages posted to the thread. */
+        ProcessMessages();
+
+        if (time_domain != NULL)
+        {
+            /* The outbound queue may have filled up since the record was
+               posted, in which case we skip the processing unless we're
+               computing the metrics of every record. Those records are only
+               analyzed and then returned to the pool. */
+            const bool display = !IsFull();
+            std::shared_ptr<ProcessedRecord> processed_record;
+            if ((display || m_parameters.full_rate_metrics) &&
+                SCAPE_EOK == m_processed_record_pool.Get(
+                                 processed_record, sizeof(ProcessedRecord), m_label,
+                                 estimated_trigger_frequency, estimated_throughput))
+            {
+                processed_record->label = m_label;
+                processed_record->trigger_frequency.value = estimated_trigger_frequency;
+                processed_record->throughput.value = estimated_throughput;
+                processed_record->recycled_records = GetRecycledRecordStatistics();
+
+                if (SCAPE_EOK == ProcessRecord(*time_domain, display, *processed_record) &&
+                    display)
+                {
+                    EjectBuffer(processed_record);
+                }
+            }
+        }
+
+        /* Notify while holding the lock. Once it's released, the main loop may
+           see zero records in flight and destroy this object. */
+        std::unique_lock lock{m_records_mutex};
+        m_nof_records_in_flight--;
+        m_records_signal.notify_all();
+    });
 }
 
-template <typename T>
-size_t DataProcessing::PreviousPowerOfTwo(T i)
+void DataProcessing::SetRecycledRecords(size_t nof_records)
 {
-    return static_cast<size_t>(std::pow(2, std::floor(std::log2(i))));
+    m_processed_record_pool.SetCapacity(nof_records);
+    m_time_domain_pool.SetCapacity(nof_records);
+    m_frequency_domain_pool.SetCapacity(nof_records);
+    m_host_record_pool.SetCapacity(nof_records);
 }
 
-template <typename T>
-void DataProcessing::TransformToUnitRange(const T *data, double code_normalization,
-                                          const Window *window, std::vector<double> &y)
+BufferPoolStatistics DataProcessing::GetRecycledRecordStatistics() const
 {
-    for (size_t i = 0; i < y.size(); ++i)
+    BufferPoolStatistics result{};
+    for (const auto &statistics :
+         {m_processed_record_pool.GetStatistics(), m_time_domain_pool.GetStatistics(),
+          m_frequency_domain_pool.GetStatistics(), m_host_record_pool.GetStatistics()})
     {
-        /* Scale to [-1, 1], which means code_normalization / 2. */
-        y[i] = static_cast<double>(data[i]) / (code_normalization / 2.0);
-        if (window != NULL)
-            y[i] *= window->data[i];
+        result.nof_hits += statistics.nof_hits;
+        result.nof_misses += statistics.nof_misses;
+        result.nof_discarded += statistics.nof_discarded;
+        result.nof_buffers_held += statistics.nof_buffers_held;
+        result.bytes_held += statistics.bytes_held;
+        result.capacity += statistics.capacity;
+    }
+    return result;
+}
+
+void DataProcessing::WaitForRecordsInFlight(size_t limit)
+{
+    std::unique_lock lock{m_records_mutex};
+    m_records_signal.wait(lock, [&] { return m_nof_records_in_flight <= limit; });
+}
+
+void DataProcessing::GetTransformLength(size_t record_length, TransformLength policy,
+                                        size_t &nof_samples, size_t &fft_length)
+{
+    switch (policy)
+    {
+    case TransformLength::TRUNCATE:
+        nof_samples = ComplexFourierTransform::PreviousFastLength(record_length);
+        fft_length = nof_samples;
+        break;
+
+    case TransformLength::ZERO_PAD:
+        nof_samples = record_length;
+        fft_length = ComplexFourierTransform::NextFastLength(record_length);
+        break;
+
+    case TransformLength::EXACT:
+    default:
+        nof_samples = record_length;
+        fft_length = record_length;
+        break;
     }
 }
 
@@ -207,7 +362,7 @@ size_t DataProcessing::FoldIndex(size_t f, size_t fs)
     return result;
 }
 
-int DataProcessing::ProcessRecord(const ADQGen4Record *raw_time_domain,
+int DataProcessing::ProcessRecord(const HostRecord &raw_time_domain, bool display,
                                   ProcessedRecord &processed_record)
 {
     /* TODO: Split this function into time domain/frequency domain? */
@@ -216,14 +371,14 @@ int DataProcessing::ProcessRecord(const ADQGen4Record *raw_time_domain,
        ADC codes to Volts. Multiply by the number of accumulations if we're
        running FWATD (normalizing with a higher value). */
 
-    const auto channel = raw_time_domain->header->channel;
+    const auto channel = raw_time_domain.header.channel;
     auto code_normalization = static_cast<double>(m_constant.channel[channel].code_normalization);
 
     if (m_constant.firmware.type == ADQ_FIRMWARE_TYPE_FWATD)
     {
-        if (raw_time_domain->header->firmware_specific > 0)
+        if (raw_time_domain.header.firmware_specific > 0)
         {
-            code_normalization *= raw_time_domain->header->firmware_specific;
+            code_normalization *= raw_time_domain.header.firmware_specific;
         }
         else
         {
@@ -232,12 +387,74 @@ int DataProcessing::ProcessRecord(const ADQGen4Record *raw_time_domain,
         }
     }
 
+    /* Determine the transform length. The window always spans the samples we
+       transform, excluding any zero padding. With Welch's method, we instead
+       transform segments of the record, each one windowed on its own. The
+       transform length policy doesn't apply to the segments. The length of
+       the zoom transform is only known once we've downconverted the record.
+       When tracking a fixed fundamental tone, the entire record is windowed
+       and the tones are measured without a transform. A fundamental tone
+       beyond the first Nyquist zone can't be tracked, in which case we fall
+       back to the regular transform. */
+    const size_t record_length = raw_time_domain.header.record_length;
+    const bool zoom = m_parameters.zoom_span > 0.0;
+    const bool welch = !zoom && m_parameters.welch_segment_length > 0 &&
+                       m_parameters.welch_segment_length <= record_length;
+    const bool tracking =
+        !zoom && !welch && m_parameters.tone_tracking && m_parameters.fundamental_frequency > 0.0 &&
+        m_parameters.fundamental_frequency <=
+            std::round(1.0 / TimeDomainRecord::GetSamplingPeriod(raw_time_domain.header)) / 2;
+    size_t nof_samples = record_length;
+    size_t FFT_LENGTH = record_length;
+    if (welch)
+    {
+        nof_samples = m_parameters.welch_segment_length;
+        FFT_LENGTH = nof_samples;
+    }
+    else if (!zoom && !tracking)
+    {
+        GetTransformLength(record_length, m_parameters.fft_length, nof_samples, FFT_LENGTH);
+    }
+
+    /* TODO: Make 'no window' into a proper uniform window? */
+    std::shared_ptr<Window> window = NULL;
+    if (!zoom)
+        window = m_window_cache.GetWindow(m_parameters.window_type, nof_samples);
+
+    /* The transform buffers are kept between records and are only reallocated
+       if the length changes. With Welch's method and the zoom transform, the
+       input holds the entire record, scaled but not windowed. */
+    const bool entire_record = welch || zoom;
+    if (entire_record)
+    {
+        m_fft_input.resize(record_length);
+    }
+    else
+    {
+        m_fft_input.resize(FFT_LENGTH);
+        m_fft_output.resize(FFT_LENGTH / 2 + 1);
+    }
+
+    /* Get the time domain record from the pool, reusing the memory of the
+       records we've already processed if possible. */
+    if (SCAPE_EOK != m_time_domain_pool.Get(processed_record.time_domain,
+                                            record_length * sizeof(RecordValue), record_length))
+    {
+        Log::log->error(FormatLog("Failed to allocate memory for a record."));
+        return SCAPE_EINTERNAL;
+    }
+
     try
     {
-        /* Processing the raw time domain data can throw if the data format is unsupported. */
-        processed_record.time_domain = std::make_shared<TimeDomainRecord>(
-            raw_time_domain, m_afe, code_normalization,
-            m_parameters.convert_horizontal, m_parameters.convert_vertical
+        /* Processing the raw time domain data can throw if the data format is
+           unsupported. The conversion also windows the data and scales it to
+           the unit range [-1, 1] for the correct FFT values, writing the result
+           to the transform input in the same pass over the raw data. */
+        processed_record.time_domain->Convert(
+            raw_time_domain.header, raw_time_domain.data.data(), m_afe, code_normalization,
+            m_parameters.convert_horizontal, m_parameters.convert_vertical,
+            m_fft_input.data(), entire_record ? record_length : nof_samples,
+            (window != NULL && !entire_record) ? window->data.data() : NULL, display
         );
     }
     catch (const std::invalid_argument &e)
@@ -246,26 +463,86 @@ int DataProcessing::ProcessRecord(const ADQGen4Record *raw_time_domain,
         return SCAPE_EINTERNAL;
     }
 
-    /* Calculate the FFT and assign parameters we know at this stage. */
-    const size_t FFT_LENGTH = PreviousPowerOfTwo(raw_time_domain->header->record_length);
-    processed_record.frequency_domain =
-        std::make_shared<FrequencyDomainRecord>(FFT_LENGTH / 2 + 1);
+    /* Zero padding, if any. */
+    if (!entire_record)
+        std::fill(m_fft_input.begin() + nof_samples, m_fft_input.end(), 0.0);
+
+    /* Compute the periodogram. The zoom transform works on the downconverted
+       record and only keeps the bins inside the span, the first of which is
+       located at the frequency `start`. */
+    double sampling_frequency = processed_record.time_domain->sampling_frequency.value;
+    double start = 0.0;
+
+    if (tracking)
+    {
+        m_periodogram.clear();
+    }
+    else if (zoom)
+    {
+        if (SCAPE_EOK != Downconvert(m_fft_input.data(), record_length, sampling_frequency,
+                                     nof_samples))
+        {
+            Log::log->error(FormatLog("Failed to downconvert a record of length {}.",
+                                      record_length));
+            return SCAPE_EINTERNAL;
+        }
+
+        FFT_LENGTH = nof_samples;
+        sampling_frequency = m_downconverter.OutputSamplingFrequency();
+        window = m_window_cache.GetWindow(m_parameters.window_type, nof_samples);
 
-    processed_record.frequency_domain->step =
-        processed_record.time_domain->sampling_frequency.value / static_cast<double>(FFT_LENGTH);
+        if (SCAPE_EOK != TransformZoom(FFT_LENGTH, window.get(), start))
+        {
+            Log::log->error(FormatLog("Failed to compute the zoom FFT of length {}.", FFT_LENGTH));
+            return SCAPE_EINTERNAL;
+        }
+    }
+    else if (welch)
+    {
+        if (SCAPE_EOK != EstimateWelch(m_fft_input.data(), record_length, FFT_LENGTH, window.get()))
+        {
+            Log::log->error(FormatLog("Failed to estimate the spectrum from segments of length {}.",
+                                      FFT_LENGTH));
+            return SCAPE_EINTERNAL;
+        }
+    }
+    else
+    {
+        /* Calculate the FFT of the real-valued input using a cached plan. */
+        const auto plan = m_fourier_transform_cache.GetPlan(FFT_LENGTH);
+        if (plan == NULL || SCAPE_EOK != plan->Forward(m_fft_input, m_fft_output))
+        {
+            Log::log->error(FormatLog("Failed to compute FFT of length {}.", FFT_LENGTH));
+            return SCAPE_EINTERNAL;
+        }
+
+        ComputePeriodogram(m_fft_output, nof_samples);
+    }
+
+    const size_t nof_bins = m_periodogram.size();
+    if (SCAPE_EOK != m_frequency_domain_pool.Get(processed_record.frequency_domain,
+                                                 nof_bins * (sizeof(double) + sizeof(RecordValue)),
+                                                 nof_bins))
+    {
+        Log::log->error(FormatLog("Failed to allocate memory for a record."));
+        return SCAPE_EINTERNAL;
+    }
+
+    /* Assign the parameters we know at this stage. */
+    processed_record.frequency_domain->Reset(nof_bins);
+
+    processed_record.frequency_domain->start = start;
+    processed_record.frequency_domain->step = sampling_frequency / static_cast<double>(FFT_LENGTH);
     processed_record.frequency_domain->rbw.value = processed_record.frequency_domain->step;
     processed_record.frequency_domain->size.value = static_cast<double>(FFT_LENGTH);
 
-    /* Window the time domain data and scale it to the unit range [-1, 1] for
-       the correct FFT values. We use the 'raw' data again since the processed
-       time domain record will have been scaled to Volts with the input range
-       and DC offset taken into account. */
-
-    /* TODO: Make 'no window' into a proper uniform window? */
-    const auto window = m_window_cache.GetWindow(m_parameters.window_type, FFT_LENGTH);
     auto &scale_factor = processed_record.frequency_domain->scale_factor;
     auto &energy_factor = processed_record.frequency_domain->energy_factor;
+
+    /* Zero padding interpolates the spectrum, spreading the energy of the
+       samples over more bins. The amplitude is unaffected. */
     energy_factor = (window != NULL) ? window->energy_factor : 1.0;
+    energy_factor *= static_cast<double>(nof_samples) / static_cast<double>(FFT_LENGTH);
     switch (m_parameters.fft_scaling)
     {
     case FrequencyDomainScaling::AMPLITUDE:
@@ -273,79 +550,431 @@ int DataProcessing::ProcessRecord(const ADQGen4Record *raw_time_domain,
         break;
 
     case FrequencyDomainScaling::ENERGY:
-        scale_factor = (window != NULL) ? window->energy_factor : 1.0;
+        scale_factor = energy_factor;
         break;
 
     default:
         break;
     }
 
-    auto y = std::vector<double>(FFT_LENGTH);
-    switch (raw_time_domain->header->data_format)
+    /* Analyze the spectrum, scaling the data and extracting key metrics. */
+    if (tracking)
+        TrackTones(m_fft_input.data(), nof_samples, window.get(), processed_record);
+    else
+        AnalyzeFrequencyDomain(m_periodogram, zoom, processed_record);
+
+    /* Analyze the time domain data. */
+    AnalyzeTimeDomain(*processed_record.time_domain);
+
+    /* Records that aren't shown stop here, unless the maximum hold needs to
+       see their spectrum in decibels. */
+    if (!display)
     {
-    case ADQ_DATA_FORMAT_INT16:
-        TransformToUnitRange(static_cast<const int16_t *>(raw_time_domain->data),
-                             code_normalization, window.get(), y);
-        break;
+        if (m_parameters.fft_maximum_hold)
+            Postprocess(processed_record);
+        return SCAPE_EOK;
+    }
 
-    case ADQ_DATA_FORMAT_INT32:
-        TransformToUnitRange(static_cast<const int32_t *>(raw_time_domain->data),
-                             code_normalization, window.get(), y);
-        break;
+    /* Postprocess the record data, producing the values shown in the plot. */
+    Postprocess(processed_record);
 
-    default:
-        Log::log->error(
-            FormatLog("Unknown data format '{}'.", raw_time_domain->header->data_format));
-        return SCAPE_EINTERNAL;
+    /* The waterfall gets a copy of the postprocessed spectrum, i.e. what's
+       shown in the plot, including any averaging. */
+    return InsertIntoWaterfall(processed_record);
+}
+
+void DataProcessing::ComputePeriodogram(const std::vector<std::complex<double>> &fft,
+                                        size_t nof_samples)
+{
+    /* Equivalent to (2 |X| / N)^2 without the square root. We normalize with
+       the number of samples since any zero padding does not contribute to the
+       amplitude. */
+    const double N = static_cast<double>(nof_samples);
+    const double normalization = 4.0 / (N * N);
+
+    m_periodogram.resize(fft.size());
+    for (size_t i = 0; i < fft.size(); ++i)
+        m_periodogram[i] = normalization * std::norm(fft[i]);
+}
+
+int DataProcessing::EstimateWelch(const double *x, size_t nof_samples, size_t segment_length,
+                                  const Window *window)
+{
+    if (!FourierTransformPlan::IsSupported(segment_length) || segment_length > nof_samples)
+        return SCAPE_EINVAL;
+
+    const size_t hop = segment_length / 2;
+    const size_t nof_segments = (nof_samples - segment_length) / hop + 1;
+    const size_t nof_bins = segment_length / 2 + 1;
+
+    /* We use one slot per thread that can work on the segments. The plans are
+       only recreated if the segment length changes. */
+    const auto pool = WorkerPool::Shared();
+    const size_t nof_slots = std::min(nof_segments, pool->GetConcurrency());
+    if (m_welch_slots.size() < nof_slots)
+        m_welch_slots.resize(nof_slots);
+
+    for (size_t i = 0; i < nof_slots; ++i)
+    {
+        auto &slot = m_welch_slots[i];
+        if (slot.plan == NULL || slot.plan->Length() != segment_length)
+        {
+            slot.plan = std::make_unique<FourierTransformPlan>(segment_length);
+            slot.input.resize(segment_length);
+            slot.output.resize(nof_bins);
+        }
+        slot.power.assign(nof_bins, 0.0);
+    }
+
+    pool->ParallelFor(nof_slots, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            auto &slot = m_welch_slots[i];
+            const size_t first = i * nof_segments / nof_slots;
+            const size_t last = (i + 1) * nof_segments / nof_slots;
+            for (size_t segment = first; segment < last; ++segment)
+            {
+                const double *y = x + segment * hop;
+                if (window != NULL)
+                {
+                    for (size_t j = 0; j < segment_length; ++j)
+                        slot.input[j] = y[j] * window->data[j];
+                }
+                else
+                {
+                    std::copy(y, y + segment_length, slot.input.begin());
+                }
+
+                slot.plan->Forward(slot.input.data(), slot.output.data());
+                for (size_t k = 0; k < nof_bins; ++k)
+                    slot.power[k] += std::norm(slot.output[k]);
+            }
+        }
+    });
+
+    /* Average the periodograms, normalized like `ComputePeriodogram()`. */
+    const double N = static_cast<double>(segment_length);
+    const double normalization = 4.0 / (N * N * static_cast<double>(nof_segments));
+
+    m_periodogram.assign(nof_bins, 0.0);
+    for (size_t i = 0; i < nof_slots; ++i)
+    {
+        for (size_t k = 0; k < nof_bins; ++k)
+            m_periodogram[k] += m_welch_slots[i].power[k];
     }
 
-    /* Calculate the FFT */
-    const char *error = NULL;
-    auto yc = std::vector<std::complex<double>>(FFT_LENGTH);
-    if (!simple_fft::FFT(y, yc, FFT_LENGTH, error))
+    for (auto &value : m_periodogram)
+        value *= normalization;
+
+    return SCAPE_EOK;
+}
+
+int DataProcessing::Downconvert(const double *x, size_t nof_samples, double sampling_frequency,
+                                size_t &nof_baseband_samples)
+{
+    /* Move the band into the first Nyquist zone, shrinking it if needed. */
+    const double nyquist_frequency = sampling_frequency / 2;
+    const double span = std::min(m_parameters.zoom_span, nyquist_frequency);
+    const double center_frequency = std::clamp(m_parameters.zoom_center_frequency, span / 2,
+                                               nyquist_frequency - span / 2);
+
+    /* The filter has to fit within the record. */
+    RETURN_CALL(m_downconverter.Configure(sampling_frequency, center_frequency, span, nof_samples));
+    m_downconverter.Process(x, nof_samples, m_zoom_baseband, WorkerPool::Shared().get());
+    if (m_zoom_baseband.size() < 2)
+        return SCAPE_EINVAL;
+
+    /* We transform the longest prefix of the baseband signal with a fast length. */
+    nof_baseband_samples = ComplexFourierTransform::PreviousFastLength(m_zoom_baseband.size());
+    return SCAPE_EOK;
+}
+
+int DataProcessing::TransformZoom(size_t length, const Window *window, double &start)
+{
+    if (length > m_zoom_baseband.size())
+        return SCAPE_EINVAL;
+
+    if (m_zoom_transform == NULL || m_zoom_transform->Length() != length)
     {
-        Log::log->error(FormatLog("Failed to compute FFT, reason '{}'.", error));
-        return SCAPE_EINTERNAL;
+        m_zoom_transform = std::make_unique<ComplexFourierTransform>(length);
+        m_zoom_scratch.resize(m_zoom_transform->ScratchSize());
     }
 
-    /* Analyze the fourier transform data, scaling the data and extracting key metrics. */
-    AnalyzeFrequencyDomain(yc, processed_record);
+    auto y = m_zoom_baseband.data();
+    if (window != NULL)
+    {
+        for (size_t i = 0; i < length; ++i)
+            y[i] *= window->data[i];
+    }
 
-    /* Analyze the time domain data. */
-    AnalyzeTimeDomain(*processed_record.time_domain);
+    m_zoom_transform->Forward(y, m_zoom_scratch.data());
 
-    /* Postprocess the record data. */
-    /* TODO: This makes it so the waterfall always shows postprocessed data
-             since it keeps a log of `std::shared_ptr<FrequencyDomainRecord>`.
-             The only way around that would be to make a deep copy of the
-             records I think? */
-    Postprocess(processed_record);
+    /* The bins of the complex transform cover the baseband [-fs/2, fs/2), with
+       the negative frequencies in the upper half. The baseband signal has half
+       the amplitude of the input, so the normalization is the same as for the
+       real transform in `ComputePeriodogram()`. */
+    const double step = m_downconverter.OutputSamplingFrequency() / static_cast<double>(length);
+    const size_t nof_side_bins = std::min(
+        static_cast<size_t>(m_downconverter.Span() / 2 / step), (length - 1) / 2);
+    const double N = static_cast<double>(length);
+    const double normalization = 4.0 / (N * N);
 
-    /* Push the new FFT at the top of the waterfall and construct a row-major
-       array for the plotting. We unfortunately cannot do anything about the
-       requirement of this linear layout. */
-    if (m_waterfall.size() >= WATERFALL_SIZE)
-        m_waterfall.pop_back();
-    m_waterfall.emplace_front(processed_record.frequency_domain);
-    processed_record.waterfall = std::make_shared<Waterfall>(m_waterfall);
+    m_periodogram.resize(2 * nof_side_bins + 1);
+    for (size_t i = 0; i < m_periodogram.size(); ++i)
+        m_periodogram[i] = normalization * std::norm(y[(i + length - nof_side_bins) % length]);
 
+    start = m_downconverter.CenterFrequency() - static_cast<double>(nof_side_bins) * step;
     return SCAPE_EOK;
 }
 
-void DataProcessing::AnalyzeFrequencyDomain(const std::vector<std::complex<double>> &fft,
+int DataProcessing::InsertIntoWaterfall(ProcessedRecord &record)
+{
+    const auto &frequency_domain = *record.frequency_domain;
+    const auto &y = frequency_domain.y;
+    const size_t depth = std::max(m_parameters.waterfall_depth, size_t{1});
+
+    /* There's no spectrum to insert when we're tracking tones. */
+    if (y.empty())
+    {
+        record.waterfall = NULL;
+        return SCAPE_EOK;
+    }
+
+    /* The rows have to line up, so a spectrum with other bins than the ones
+       in the waterfall, e.g. after moving the zoom, starts a new one. */
+    if (m_waterfall == NULL || m_waterfall->rows != depth || m_waterfall->size != y.size() ||
+        m_waterfall->start != frequency_domain.start || m_waterfall->step != frequency_domain.step)
+    {
+        /* Long spectra are decimated to keep the waterfall within the memory
+           budget regardless of the depth. */
+        const size_t max_columns = std::max(
+            std::min(WATERFALL_MAX_COLUMNS, WATERFALL_MEMORY_BUDGET / (depth * sizeof(RecordValue))),
+            size_t{1});
+
+        /* Release the current waterfall before allocating its replacement. */
+        m_waterfall.reset();
+        try
+        {
+            m_waterfall = std::make_shared<Waterfall>(depth, y.size(), max_columns,
+                                                      frequency_domain.start,
+                                                      frequency_domain.step);
+        }
+        catch (const std::bad_alloc &)
+        {
+            Log::log->error(FormatLog("Failed to allocate memory for the waterfall."));
+            return SCAPE_EINTERNAL;
+        }
+    }
+
+    record.waterfall = m_waterfall;
+    record.waterfall_sequence = m_waterfall->Insert(y.data(), y.size());
+    return SCAPE_EOK;
+}
+
+void DataProcessing::AnalyzeFrequencyDomain(const std::vector<double> &periodogram, bool zoom,
                                             ProcessedRecord &record)
 {
     Tone fundamental{};
     Tone spur{};
     Tone dc{};
     double total_power = 0.0;
-    ProcessAndIdentify(fft, record, dc, fundamental, spur, total_power);
+    ProcessAndIdentify(periodogram, zoom, record, dc, fundamental, spur, total_power);
+
+    auto &frequency_domain = record.frequency_domain;
+
+    /* TODO: Linear interpolation? */
+    frequency_domain->fundamental = {
+        frequency_domain->ValueX(fundamental.frequency),
+        frequency_domain->ValueY(fundamental.PowerInDecibels(), !fundamental.overlap),
+    };
+
+    frequency_domain->spur = {
+        frequency_domain->ValueX(spur.frequency),
+        frequency_domain->ValueY(spur.PowerInDecibels()),
+    };
+
+    if (zoom)
+    {
+        /* The zoomed spectrum only covers a narrow band, which generally
+           excludes the harmonics and the interleaving spurs. We keep their
+           frequencies for reference but invalidate every metric that relates
+           the fundamental tone to the noise and distortion of the entire
+           Nyquist zone. The noise density and the spurious-free dynamic range
+           are still meaningful within the band. */
+        const double fs = record.time_domain->sampling_frequency.value;
+        for (int hd = 2; hd <= 5; ++hd)
+        {
+            frequency_domain->harmonics.emplace_back(
+                frequency_domain->ValueX(FoldFrequency(fundamental.frequency * hd, fs), false),
+                frequency_domain->ValueY(0.0, false));
+        }
+
+        frequency_domain->gain_phase_spur = {frequency_domain->ValueX(0.0, false),
+                                             frequency_domain->ValueY(0.0, false)};
+        frequency_domain->offset_spur = {frequency_domain->ValueX(0.0, false),
+                                         frequency_domain->ValueY(0.0, false)};
+
+        frequency_domain->InvalidateNoiseMetrics();
+        frequency_domain->sfdr_dbfs.value = -spur.PowerInDecibels();
+        frequency_domain->sfdr_dbfs.valid = true;
+        frequency_domain->sfdr_dbc.value = fundamental.PowerInDecibels() - spur.PowerInDecibels();
+        frequency_domain->sfdr_dbc.valid = true;
+        UpdateNoiseDensity(total_power - fundamental.power - spur.power,
+                           frequency_domain->power.size(), *frequency_domain);
+        return;
+    }
 
     std::vector<Tone> harmonics{};
     PlaceHarmonics(fundamental, record, harmonics);
+    ResolveHarmonicOverlaps(dc, fundamental, harmonics);
+
+    /* TODO: Manual opt-out from interleaving analysis? */
+    Tone gain_phase_spur{};
+    Tone offset_spur{};
+    PlaceInterleavingSpurs(fundamental, record, gain_phase_spur, offset_spur);
+    ResolveInterleavingSpurOverlaps(dc, fundamental, harmonics, gain_phase_spur, offset_spur);
+
+    AnalyzeTones(dc, fundamental, spur, harmonics, gain_phase_spur, offset_spur, total_power,
+                 frequency_domain->power.size(), *frequency_domain);
+}
+
+void DataProcessing::TrackTones(const double *x, size_t nof_samples, const Window *window,
+                                ProcessedRecord &record)
+{
+    /* The Goertzel filter evaluates the DFT at a single frequency, which
+       doesn't have to be an integer multiple of the bin spacing. This lets us
+       measure each tone at its exact frequency in a single pass over the
+       record with one resonator per tone.
+
+       The samples in `x` are already windowed. We weight them by the window a
+       second time, which turns the filter output into the projection of `x`
+       onto the windowed sinusoid at the tone's frequency. The power of the
+       projection is what the tone contributes to the total power of `x`, so
+       subtracting it leaves the noise, just as removing the bins of the tone
+       does for the spectrum. Using the plain filter output instead, i.e. the
+       amplitude, would leave a cross term between the tone and the noise in
+       the difference that's easily larger than the noise itself. The power is
+       expressed in the same units as the spectrum, where a full-scale tone is
+       at 0 dBFS. The total power follows from Parseval's theorem. */
 
     auto &frequency_domain = record.frequency_domain;
+    const double fs = record.time_domain->sampling_frequency.value;
+    const double f0 = m_parameters.fundamental_frequency;
+    const double N = static_cast<double>(nof_samples);
+    const double PI = std::acos(-1.0);
+
+    /* The fundamental, HD2 to HD5 and the interleaving spurs, in that order. */
+    std::vector<double> frequencies{f0};
+    for (int hd = 2; hd <= 5; ++hd)
+        frequencies.push_back(FoldFrequency(f0 * hd, fs));
+    frequencies.push_back(FoldFrequency(f0 + fs / 2, fs));
+    frequencies.push_back(fs / 2);
+
+    struct Resonator
+    {
+        double coefficient;
+        double s1;
+        double s2;
+    };
+
+    std::vector<Resonator> resonators{};
+    for (const auto &f : frequencies)
+        resonators.push_back({2.0 * std::cos(2.0 * PI * f / fs), 0.0, 0.0});
+
+    double sum = 0.0;
+    double sum_of_squares = 0.0;
+    for (size_t n = 0; n < nof_samples; ++n)
+    {
+        const double value = (window != NULL) ? x[n] * window->data[n] : x[n];
+        for (auto &r : resonators)
+        {
+            const double s = value + r.coefficient * r.s1 - r.s2;
+            r.s2 = r.s1;
+            r.s1 = s;
+        }
+
+        sum += value;
+        sum_of_squares += x[n] * x[n];
+    }
+
+    /* With the window's energy factor N / sum(w^2), a tone's power is
+       4 |Y|^2 / sum(w^2)^2 for the filter output Y. The sinusoids at DC and
+       at half the sampling rate are real-valued and only carry half of that. */
+    const double &energy_factor = frequency_domain->energy_factor;
+    const double normalization = 4.0 * energy_factor * energy_factor / (N * N);
+    const auto Power = [&](double frequency, double norm) -> double {
+        const bool real = frequency == 0.0 || frequency == fs / 2;
+        return (real ? 0.5 : 1.0) * normalization * std::max(norm, 0.0);
+    };
+
+    const auto Norm = [](const Resonator &r) -> double {
+        return r.s1 * r.s1 + r.s2 * r.s2 - r.coefficient * r.s1 * r.s2;
+    };
+
+    const size_t nof_bins = nof_samples / 2 + 1;
+    const double total_power = 2.0 * energy_factor * sum_of_squares / N;
+
+    /* Each tone is a single value located at the nearest bin, which is only
+       used to detect overlaps. Tones closer than the skirt are considered to
+       overlap, just as for the transform. */
+    const size_t nof_skirt_bins = static_cast<size_t>(m_parameters.nof_skirt_bins);
+    const auto MakeTone = [&](double frequency, double power) -> Tone {
+        Tone tone{};
+        tone.frequency = frequency;
+        tone.power = power;
+        tone.idx = static_cast<size_t>(std::round(frequency / frequency_domain->step));
+        tone.idx_low = tone.idx < nof_skirt_bins ? 0 : tone.idx - nof_skirt_bins;
+        tone.idx_high = std::min(tone.idx + nof_skirt_bins, nof_bins - 1);
+        tone.overlap = false;
+        tone.values = {power};
+        return tone;
+    };
+
+    Tone dc = MakeTone(0.0, Power(0.0, sum * sum));
+    dc.idx_high = std::min(nof_skirt_bins, nof_bins - 1);
+
+    std::vector<Tone> tones{};
+    for (size_t i = 0; i < resonators.size(); ++i)
+        tones.push_back(MakeTone(frequencies[i], Power(frequencies[i], Norm(resonators[i]))));
+
+    const Tone fundamental = std::move(tones[0]);
+    std::vector<Tone> harmonics(tones.begin() + 1, tones.begin() + 5);
+    Tone gain_phase_spur = std::move(tones[5]);
+    Tone offset_spur = std::move(tones[6]);
+
     ResolveHarmonicOverlaps(dc, fundamental, harmonics);
+    ResolveInterleavingSpurOverlaps(dc, fundamental, harmonics, gain_phase_spur, offset_spur);
+
+    /* Without a spectrum to search, the worst spur is the strongest of the
+       tones we know about. */
+    Tone spur{};
+    for (const auto *tone : {&harmonics[0], &harmonics[1], &harmonics[2], &harmonics[3],
+                             &gain_phase_spur, &offset_spur})
+    {
+        if (tone->values.front() > spur.power)
+            spur = MakeTone(tone->frequency, tone->values.front());
+    }
+
+    frequency_domain->fundamental = {
+        frequency_domain->ValueX(fundamental.frequency),
+        frequency_domain->ValueY(fundamental.PowerInDecibels()),
+    };
+
+    frequency_domain->spur = {
+        frequency_domain->ValueX(spur.frequency),
+        frequency_domain->ValueY(spur.PowerInDecibels(), spur.power > 0.0),
+    };
+
+    AnalyzeTones(dc, fundamental, spur, harmonics, gain_phase_spur, offset_spur, total_power,
+                 nof_bins, *frequency_domain);
+}
+
+void DataProcessing::AnalyzeTones(const Tone &dc, const Tone &fundamental, const Tone &spur,
+                                  std::vector<Tone> &harmonics, Tone &gain_phase_spur,
+                                  Tone &offset_spur, double total_power, size_t nof_bins,
+                                  FrequencyDomainRecord &record)
+{
+    auto *frequency_domain = &record;
 
     /* Reevaluate the power now that overlaps have been resolved. */
     double harmonic_distortion_power = 0.0;
@@ -360,12 +989,6 @@ void DataProcessing::AnalyzeFrequencyDomain(const std::vector<std::complex<doubl
         );
     }
 
-    /* TODO: Manual opt-out from interleaving analysis? */
-    Tone gain_phase_spur{};
-    Tone offset_spur{};
-    PlaceInterleavingSpurs(fundamental, record, gain_phase_spur, offset_spur);
-    ResolveInterleavingSpurOverlaps(dc, fundamental, harmonics, gain_phase_spur, offset_spur);
-
     const double interleaving_spur_power = gain_phase_spur.UpdatePower() +
                                            offset_spur.UpdatePower();
     const size_t interleaving_spur_bins = gain_phase_spur.Bins() + offset_spur.Bins();
@@ -380,17 +1003,6 @@ void DataProcessing::AnalyzeFrequencyDomain(const std::vector<std::complex<doubl
         frequency_domain->ValueY(offset_spur.PowerInDecibels(), !offset_spur.overlap),
     };
 
-    /* TODO: Linear interpolation? */
-    frequency_domain->fundamental = {
-        frequency_domain->ValueX(fundamental.frequency),
-        frequency_domain->ValueY(fundamental.PowerInDecibels(), !fundamental.overlap),
-    };
-
-    frequency_domain->spur = {
-        frequency_domain->ValueX(spur.frequency),
-        frequency_domain->ValueY(spur.PowerInDecibels()),
-    };
-
     /* We calculate the noise power by removing the power of the fundamental
        tone and other spectral components from the total power.
 
@@ -403,7 +1015,7 @@ void DataProcessing::AnalyzeFrequencyDomain(const std::vector<std::complex<doubl
                                  interleaving_spur_bins;
 
     const bool noise_valid = frequency_domain->AreAllMetricsValid() &&
-                             nof_spur_bins < frequency_domain->x.size() / 2;
+                             nof_spur_bins < nof_bins / 2;
 
     if (!noise_valid)
     {
@@ -430,23 +1042,7 @@ void DataProcessing::AnalyzeFrequencyDomain(const std::vector<std::complex<doubl
     frequency_domain->sfdr_dbfs.value = -spur.PowerInDecibels();
     frequency_domain->sfdr_dbc.value = fundamental.PowerInDecibels() - spur.PowerInDecibels();
 
-    const double noise_average = 10.0 * std::log10(noise_power / static_cast<double>(frequency_domain->x.size()));
-    frequency_domain->npsd.value = noise_average - 10.0 * std::log10(frequency_domain->step);
-
-    /* To compute the moving average, we want to use a value scaled as the plot
-       will be presented. This will be used as a lower bound when plotting. */
-    const double noise_average_scaled = noise_average +
-                                        10.0 * std::log10(frequency_domain->scale_factor /
-                                                          frequency_domain->energy_factor);
-
-    frequency_domain->noise_moving_average.value = 0;
-    if (m_noise_moving_average.size() >= NOISE_MOVING_AVERAGE_SIZE)
-        m_noise_moving_average.pop_back();
-    m_noise_moving_average.push_front(noise_average_scaled);
-
-    const double normalization = static_cast<double>(m_noise_moving_average.size());
-    for (const auto &noise : m_noise_moving_average)
-        frequency_domain->noise_moving_average.value += noise / normalization;
+    UpdateNoiseDensity(noise_power, nof_bins, *frequency_domain);
 
     /* Calculate the relative power of the spectral components contributing to
        the noise and distortion (not relative to the total power). */
@@ -461,69 +1057,124 @@ void DataProcessing::AnalyzeFrequencyDomain(const std::vector<std::complex<doubl
              that ended up within the blind spot? */
 }
 
-void DataProcessing::ProcessAndIdentify(const std::vector<std::complex<double>> &fft,
+void DataProcessing::UpdateNoiseDensity(double noise_power, size_t nof_bins,
+                                        FrequencyDomainRecord &record)
+{
+    const double noise_average = 10.0 * std::log10(noise_power / static_cast<double>(nof_bins));
+    record.npsd.value = noise_average - 10.0 * std::log10(record.step);
+    record.npsd.valid = true;
+
+    /* To compute the moving average, we want to use a value scaled as the plot
+       will be presented. This will be used as a lower bound when plotting. */
+    const double noise_average_scaled = noise_average +
+                                        10.0 * std::log10(record.scale_factor /
+                                                          record.energy_factor);
+
+    record.noise_moving_average.value = 0;
+    record.noise_moving_average.valid = true;
+    if (m_noise_moving_average.size() >= NOISE_MOVING_AVERAGE_SIZE)
+        m_noise_moving_average.pop_back();
+    m_noise_moving_average.push_front(noise_average_scaled);
+
+    const double normalization = static_cast<double>(m_noise_moving_average.size());
+    for (const auto &noise : m_noise_moving_average)
+        record.noise_moving_average.value += noise / normalization;
+}
+
+void DataProcessing::ProcessAndIdentify(const std::vector<double> &periodogram, bool zoom,
                                         ProcessedRecord &record, Tone &dc, Tone &fundamental,
                                         Tone &spur, double &power)
 {
     /* The loop upper bound is expected to be N/2 + 1 where N is the length of
-       the transform, i.e. fft.size(). During our pass through the spectrum, our
+       the transform, i.e. `length`. During our pass through the spectrum, our
        goal is to identify the fundamental, the worst spur and also to
        accumulate the total power since we're already traversing all the data
        points.
 
-       We'll use a shift register to implement a cursor that we drag across the
-       spectrum. If the total power contained in the window is a new maximum, we
-       note the new location and mark the old location as the worst spur unless
-       there's an overlap.
+       We drag a window of `2 * nof_skirt_bins + 1` bins across the spectrum.
+       If the total power contained in the window is a new maximum, we note the
+       new location and mark the old location as the worst spur unless there's
+       an overlap. The window sums (weighted and unweighted) are updated
+       incrementally as bins enter and leave the window, so the search is
+       linear in the number of bins regardless of the skirt width.
 
-       The goal is to only loop over the spectrum once and to not allocate
-       additional memory. We avoid making a copy of the spectrum just for the
-       analysis process. We do this to manage the complexity to stay performant
-       for long FFTs. */
+       The goal is to only loop over the spectrum once. We write the linear bin
+       power to the record's power spectrum, which is also the memory backing
+       the window. The values of the identified tones are copied from there
+       once the search is complete. The conversion to decibels for the plot is
+       left to a separate stage.
 
-    auto &x = record.frequency_domain->x;
-    auto &y = record.frequency_domain->y;
+       A zoomed spectrum starts at the frequency `start` and doesn't contain
+       DC, so every bin is up for grabs. */
+
+    auto &spectrum = record.frequency_domain->power;
+    const auto &start = record.frequency_domain->start;
     const auto &bin_range = record.frequency_domain->step;
-    const auto &scale_factor = record.frequency_domain->scale_factor;
     const auto &energy_factor = record.frequency_domain->energy_factor;
     const size_t nof_skirt_bins = static_cast<size_t>(m_parameters.nof_skirt_bins);
-    const double nyquist_frequency = static_cast<double>(x.size() - 1) * bin_range;
+    const size_t nof_window_bins = 2 * nof_skirt_bins + 1;
+    const size_t first_bin = zoom ? 0 : nof_skirt_bins + 1;
+    const double last_frequency = start + static_cast<double>(spectrum.size() - 1) * bin_range;
     const bool fixed_fundamental = m_parameters.fundamental_frequency > 0 &&
-                                   m_parameters.fundamental_frequency <= nyquist_frequency;
-    std::deque<double> cursor;
+                                   m_parameters.fundamental_frequency >= start &&
+                                   m_parameters.fundamental_frequency <= last_frequency;
 
     dc = {};
     fundamental = {};
     spur = {};
     power = 0.0;
 
-    auto FromComplex = [&](std::complex<double> value) -> double {
-        return std::pow(2.0 * std::abs(value) / static_cast<double>(fft.size()), 2.0);
+    /* The window sums are running sums where the values leaving the window are
+       subtracted. The spectrum easily spans 15 orders of magnitude, so we use
+       compensated summation to avoid leaving a residue from a strong tone in
+       the sums when the window has moved on into the noise floor. */
+    struct WindowSum
+    {
+        double sum;
+        double compensation;
+
+        void Add(double value)
+        {
+            /* Neumaier's variant of Kahan summation. */
+            const double t = sum + value;
+            if (std::abs(sum) >= std::abs(value))
+                compensation += (sum - t) + value;
+            else
+                compensation += (value - t) + sum;
+            sum = t;
+        }
+
+        double Get() const { return sum + compensation; }
     };
 
-    /* Prepare the FFT moving average memory to receive a new entry. */
-    m_fft_moving_average.PrepareNewEntry(fft.size());
+    /* The weighted sum uses the absolute bin index as the weight. */
+    WindowSum numerator{};
+    WindowSum denominator{};
+
+    /* Prepare the FFT averaging memory to receive a new entry. */
+    const bool moving_average = m_parameters.fft_averaging == FrequencyDomainAveraging::MOVING;
+    if (moving_average)
+        m_fft_moving_average.PrepareNewEntry(periodogram.size());
+    else
+        m_fft_exponential_average.PrepareNewEntry(periodogram.size());
+
+    const auto Average = [&](size_t i, double value) -> double {
+        if (moving_average)
+            return m_fft_moving_average.InsertAndAverage(i, value);
+        else
+            return m_fft_exponential_average.InsertAndAverage(i, value);
+    };
 
     /* If we're performing the analysis with a fixed fundamental frequency, we
-       start off by constructing that `Tone` object. */
+       start off by placing that `Tone` object. Its values are collected from
+       the (potentially averaged) spectrum once we've traversed it. */
     if (fixed_fundamental)
     {
-        const double idx = m_parameters.fundamental_frequency / bin_range;
-        const size_t idx_center = static_cast<size_t>(m_parameters.fundamental_frequency / bin_range + 0.5);
+        const double idx = (m_parameters.fundamental_frequency - start) / bin_range;
+        const size_t idx_center = static_cast<size_t>(idx + 0.5);
         const size_t idx_low = idx_center < nof_skirt_bins ? 0 : idx_center - nof_skirt_bins;
-        const size_t idx_high = std::min(idx_center + nof_skirt_bins, x.size() - 1);
+        const size_t idx_high = std::min(idx_center + nof_skirt_bins, spectrum.size() - 1);
 
-        for (size_t i = idx_low; i <= idx_high; ++i)
-        {
-            /* We need to base this analysis on potentially averaged data. We'll
-               revisit these bins in the loop below and thus recalculate these
-               values. This obviously slightly suboptimal, but I think the code
-               is clearer and the drawbacks are not that significant. */
-            const double value = m_fft_moving_average.InsertAndAverage(i, FromComplex(fft[i]));
-            fundamental.values.push_back(value * energy_factor);
-        }
-
-        fundamental.UpdatePower();
         fundamental.frequency = m_parameters.fundamental_frequency;
         fundamental.idx = idx_center;
         fundamental.idx_fraction = idx - static_cast<double>(idx_center);
@@ -531,80 +1182,91 @@ void DataProcessing::ProcessAndIdentify(const std::vector<std::complex<double>>
         fundamental.idx_high = idx_high;
     }
 
-    for (size_t i = 0; i < x.size(); ++i)
+    for (size_t i = 0; i < spectrum.size(); ++i)
     {
-        x[i] = static_cast<double>(i) * bin_range;
-
         /* Calculate the unscaled value. */
-        y[i] = m_fft_moving_average.InsertAndAverage(i, FromComplex(fft[i]));
+        const double value = Average(i, periodogram[i]);
 
         /* We will always need the energy-accurate bin value for the calculations below. */
-        const double y_power = y[i] * energy_factor;
-
-        /* Scale the value stored for plotting with the `scale_factor`, which
-           can result in either an amplitude-accurate spectrum or an
-           energy-accurate spectrum. Convert to decibels. */
-        y[i] = 10.0 * std::log10(y[i] * scale_factor);
+        const double y_power = value * energy_factor;
+        spectrum[i] = y_power;
 
         /* Add the bin's contribution to the total power. */
         power += y_power;
 
         /* DC tone analysis. */
-        if (i <= nof_skirt_bins)
+        if (!zoom && i <= nof_skirt_bins)
         {
             dc.power += y_power;
             dc.idx_high = i;
-            dc.values.push_back(y_power);
             continue;
         }
 
-        if (cursor.size() >= (2 * nof_skirt_bins + 1))
-            cursor.pop_front();
-        cursor.push_back(y_power);
-
-        double numerator = 0.0;
-        double denominator = 0.0;
-        for (size_t j = 0; j < cursor.size(); ++j)
+        /* Slide the window, which starts out empty just above the DC bins. */
+        const size_t idx_low = std::max(first_bin, i + 1 > nof_window_bins ? i + 1 - nof_window_bins : 0);
+        if (idx_low > first_bin)
         {
-            numerator += static_cast<double>(j) * cursor[j];
-            denominator += cursor[j];
+            const size_t idx_out = idx_low - 1;
+            numerator.Add(-static_cast<double>(idx_out) * spectrum[idx_out]);
+            denominator.Add(-spectrum[idx_out]);
         }
 
-        const size_t idx_low = i - cursor.size() + 1;
-        const double center_of_mass = static_cast<double>(idx_low) + (numerator / denominator);
+        numerator.Add(static_cast<double>(i) * y_power);
+        denominator.Add(y_power);
+
+        /* Guard against a slightly negative sum from the remaining rounding errors. */
+        const double window_power = std::max(denominator.Get(), 0.0);
+        const double center_of_mass = window_power > 0.0 ? numerator.Get() / window_power
+                                                         : static_cast<double>(idx_low);
         const size_t center_idx = static_cast<size_t>(center_of_mass + 0.5);
         const double center_fraction = center_of_mass - static_cast<double>(center_idx);
-        const double center_frequency = bin_range * center_of_mass;
+        const double center_frequency = start + bin_range * center_of_mass;
 
-        if (!fixed_fundamental && denominator > fundamental.power)
+        if (!fixed_fundamental && window_power > fundamental.power)
         {
             if ((center_idx - fundamental.idx) > (2 * nof_skirt_bins))
                 spur = fundamental;
 
-            fundamental.power = denominator;
+            fundamental.power = window_power;
             fundamental.frequency = center_frequency;
             fundamental.idx = center_idx;
             fundamental.idx_fraction = center_fraction;
             fundamental.idx_low = idx_low;
             fundamental.idx_high = i;
-            fundamental.values.clear();
-            for (const auto &c : cursor)
-                fundamental.values.push_back(c);
         }
 
-        if (denominator > spur.power && (center_idx - fundamental.idx) > (2 * nof_skirt_bins))
+        if (window_power > spur.power && (center_idx - fundamental.idx) > (2 * nof_skirt_bins))
         {
-            spur.power = denominator;
+            spur.power = window_power;
             spur.frequency = center_frequency;
             spur.idx = center_idx;
             spur.idx_fraction = center_fraction;
             spur.idx_low = idx_low;
             spur.idx_high = i;
-            spur.values.clear();
-            for (const auto &c : cursor)
-                spur.values.push_back(c);
         }
     }
+
+    /* Collect the values of the identified tones. A tone that was never
+       placed is left without any values. */
+    const auto CopyValues = [&](Tone &tone) {
+        tone.values.assign(spectrum.begin() + tone.idx_low, spectrum.begin() + tone.idx_high + 1);
+    };
+
+    if (!zoom)
+        CopyValues(dc);
+
+    if (fixed_fundamental)
+    {
+        CopyValues(fundamental);
+        fundamental.UpdatePower();
+    }
+    else if (fundamental.power > 0.0)
+    {
+        CopyValues(fundamental);
+    }
+
+    if (spur.power > 0.0)
+        CopyValues(spur);
 }
 
 void DataProcessing::PlaceHarmonics(const Tone &fundamental, const ProcessedRecord &record,
@@ -702,41 +1364,18 @@ void DataProcessing::ResolveOverlap(Tone &tone, const Tone &other)
 
 void DataProcessing::AnalyzeTimeDomain(TimeDomainRecord &record)
 {
-    double max = std::numeric_limits<double>::lowest();
-    double min = std::numeric_limits<double>::max();
-    double mean = 0;
-
-    for (const auto &y : record.y)
-    {
-        if (y > max)
-            max = y;
-
-        if (y < min)
-            min = y;
-
-        mean += y;
-    }
-
-    mean /= static_cast<double>(record.y.size());
-
-    double sdev = 0;
-    for (const auto &y : record.y)
-    {
-        const double diff = y - mean;
-        sdev += diff * diff;
-    }
-
-    sdev /= static_cast<double>(record.y.size());
-    sdev = std::sqrt(sdev);
+    /* The statistics of the record were gathered while converting the raw
+       data, so there's no need for another pass over the trace. */
+    const auto &statistics = record.statistics;
 
     /* Push the metrics (assign as current) from this record into the persistent
        object we keep to calculate statistics, then copy the state of that
        object into the record. We have to copy the properties of the (empty)
        metrics object from the record since that contains the correct units etc. */
-    m_time_domain_metrics.max = max;
-    m_time_domain_metrics.min = min;
-    m_time_domain_metrics.mean = mean;
-    m_time_domain_metrics.sdev = sdev;
+    m_time_domain_metrics.max = statistics.max;
+    m_time_domain_metrics.min = statistics.min;
+    m_time_domain_metrics.mean = statistics.mean;
+    m_time_domain_metrics.sdev = statistics.sdev;
     m_time_domain_metrics.CopyProperties(record.metrics);
 
     record.metrics = m_time_domain_metrics;
@@ -744,12 +1383,16 @@ void DataProcessing::AnalyzeTimeDomain(TimeDomainRecord &record)
 
 void DataProcessing::Postprocess(ProcessedRecord &record)
 {
-    /* This step runs after the analysis has completed and affects the data
-       shown in the plot. Right now, this step only consists of the FFT maximum
-       hold mechanism. */
+    /* This step runs after the analysis has completed and produces the data
+       shown in the plot. The power spectrum is scaled with the `scale_factor`,
+       which can result in either an amplitude-accurate spectrum or an
+       energy-accurate spectrum, and converted to decibels. Lastly, we apply the
+       FFT maximum hold mechanism. */
+    record.frequency_domain->ConvertToDecibels();
+
     auto &y = record.frequency_domain->y;
     for (size_t i = 0; i < y.size(); ++i)
-        y[i] = m_fft_maximum_hold.Compare(i, y[i]);
+        y[i] = static_cast<RecordValue>(m_fft_maximum_hold.Compare(i, y[i]));
 }
 
 void DataProcessing::ProcessMessages()
@@ -771,17 +1414,40 @@ void DataProcessing::ProcessMessages()
                 m_time_domain_metrics.Clear();
             }
 
+            /* The averages have to start over if the bins move around, even if
+               their number stays the same. */
+            if (m_parameters.fft_averaging != message.processing.fft_averaging
+                || m_parameters.welch_segment_length != message.processing.welch_segment_length
+                || m_parameters.zoom_center_frequency != message.processing.zoom_center_frequency
+                || m_parameters.zoom_span != message.processing.zoom_span
+                || m_parameters.tone_tracking != message.processing.tone_tracking)
+            {
+                m_fft_moving_average.Clear();
+                m_fft_exponential_average.Clear();
+            }
+
+            m_fourier_transform_cache.SetParallel(WorkerPool::Shared(),
+                                                  message.processing.fft_parallel_threshold);
+            SetRecycledRecords(message.processing.nof_recycled_records);
             m_fft_moving_average.SetNumberOfAverages(message.processing.nof_fft_averages);
+            if (message.processing.fft_averaging != FrequencyDomainAveraging::MOVING)
+                m_fft_moving_average.Release();
+            m_fft_exponential_average.SetNumberOfAverages(
+                message.processing.fft_averaging == FrequencyDomainAveraging::CUMULATIVE
+                    ? 0
+                    : message.processing.nof_fft_averages);
             m_fft_maximum_hold.Enable(message.processing.fft_maximum_hold);
             m_noise_moving_average.clear();
             m_parameters = std::move(message.processing);
+            m_full_rate_metrics = m_parameters.full_rate_metrics;
             break;
 
         case DataProcessingMessageId::CLEAR_PROCESSING_MEMORY:
             m_fft_maximum_hold.Clear();
             m_fft_moving_average.Clear();
+            m_fft_exponential_average.Clear();
             m_noise_moving_average.clear();
-            m_waterfall.clear();
+            m_waterfall.reset();
             m_time_domain_metrics.Clear();
             break;
 
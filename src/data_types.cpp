@@ -1,5 +1,9 @@
 #include "data_types.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 std::string Value::Format(bool show_sign) const
 {
     return Format(value, show_sign);
@@ -7,7 +11,7 @@ std::string Value::Format(bool show_sign) const
 
 std::string Value::FormatCsv() const
 {
-    return fmt::format("{:g},{}", value, properties.unit);
+    return fmt::format("{:g},{}", value, properties->unit);
 }
 
 std::string Value::Format(const char *precision, bool show_sign) const
@@ -22,95 +26,461 @@ std::string Value::Format(const std::string &precision, bool show_sign) const
 
 std::string Value::Format(double other, bool show_sign) const
 {
-    return Format(other, properties.precision, show_sign);
+    return Format(other, properties->precision, show_sign);
 }
 
 std::string Value::FormatDelta(double other, bool show_sign) const
 {
-    return FormatDelta(other, properties.precision, show_sign);
+    return FormatDelta(other, properties->precision, show_sign);
 }
 
 std::string Value::FormatInverseDelta(double other, bool show_sign) const
 {
-    return FormatInverseDelta(other, properties.precision, show_sign);
+    return FormatInverseDelta(other, properties->precision, show_sign);
 }
 
 std::string Value::Format(double other, const std::string &precision, bool show_sign) const
 {
     if (!valid)
-        return Format::Invalid(precision, properties.unit);
+        return Format::Invalid(precision, properties->unit);
 
-    return Format::Metric(other, Format::String(precision, properties.unit, show_sign),
-                          properties.highest_prefix, properties.lowest_prefix);
+    return Format::Metric(other, Format::String(precision, properties->unit, show_sign),
+                          properties->highest_prefix, properties->lowest_prefix);
 }
 
 std::string Value::FormatDelta(double other, const std::string &precision, bool show_sign) const
 {
     if (!valid)
-        return Format::Invalid(precision, properties.delta_unit);
+        return Format::Invalid(precision, properties->delta_unit);
 
-    return Format::Metric(other, Format::String(precision, properties.delta_unit, show_sign),
-                          properties.highest_prefix, properties.lowest_prefix);
+    return Format::Metric(other, Format::String(precision, properties->delta_unit, show_sign),
+                          properties->highest_prefix, properties->lowest_prefix);
 }
 
 std::string Value::FormatInverseDelta(double other, const std::string &precision, bool show_sign) const
 {
     if (!valid)
-        return Format::Invalid(precision, properties.inverse_delta_unit);
+        return Format::Invalid(precision, properties->inverse_delta_unit);
 
-    return Format::Metric(other, Format::String(precision, properties.inverse_delta_unit, show_sign),
-                          1.0 / properties.lowest_prefix, 1.0 / properties.highest_prefix);
+    return Format::Metric(other, Format::String(precision, properties->inverse_delta_unit, show_sign),
+                          1.0 / properties->lowest_prefix, 1.0 / properties->highest_prefix);
 }
 
 BaseRecord::~BaseRecord()
 {}
 
+bool BaseRecord::ClosestIndex(double point_x, double point_y, double x_min, double x_max,
+                              double y_min, double y_max, size_t &index) const
+{
+    if (y.empty())
+        return false;
+
+    /* Find the closest sample to the point (x,y) by minimizing the Euclidian
+       distance. We have to normalize the data for this method to give
+       the desired results---namely, we have to normalize using the _plot_
+       limits since that is the perceived reference frame of the user. */
+
+    const double kx = (x_max - x_min) / 2;
+    const double mx = -(x_min + kx);
+    const double ky = (y_max - y_min) / 2;
+    const double my = -(y_min + ky);
+
+    const double x_normalized = (point_x + mx) / kx;
+    const double x_step_normalized = step / kx;
+    const double y_normalized = (point_y + my) / ky;
+
+    const double x0_normalized = (start + mx) / kx;
+    const double center = std::round((x_normalized - x0_normalized) / x_step_normalized);
+
+    /* Create a symmetric span around the rounded x-coordinate and then clip the
+       limits to the range where there's data. */
+    const double span = 16.0;
+    const double low_limit = 0.0;
+    const double high_limit = static_cast<double>(y.size() - 1);
+    double span_low = center - span;
+    double span_high = center + span;
+
+    if (span_low < low_limit)
+        span_low = low_limit;
+    else if (span_low > (high_limit - span))
+        span_low = std::max(high_limit - span, low_limit);
+
+    if (span_high < (low_limit + span))
+        span_high = std::min(low_limit + span, high_limit);
+    else if (span_high > high_limit)
+        span_high = high_limit;
+
+    const size_t low = static_cast<size_t>(span_low);
+    const size_t high = static_cast<size_t>(span_high);
+    double distance_min = std::numeric_limits<double>::max();
+    index = low;
+
+    for (size_t i = low; i <= high; ++i)
+    {
+        const double xi = (X(i) + mx) / kx;
+        const double yi = (y[i] + my) / ky;
+
+        const double x2 = std::pow(x_normalized - xi, 2);
+        const double y2 = std::pow(y_normalized - yi, 2);
+        const double distance = x2 + y2;
+
+        if (distance < distance_min)
+        {
+            index = i;
+            distance_min = distance;
+        }
+    }
+
+    return true;
+}
+
+void TimeDomainRecord::Convert(const ADQGen4Record *raw,
+                               const ADQAnalogFrontendParametersChannel &afe,
+                               double code_normalization, bool convert_horizontal,
+                               bool convert_vertical, double *fft, size_t nof_fft_samples,
+                               const double *window)
+{
+    Convert(*raw->header, raw->data, afe, code_normalization, convert_horizontal,
+            convert_vertical, fft, nof_fft_samples, window);
+}
+
+/* The time unit is specified in picoseconds at most. Given that we're using a
+   32-bit float, we truncate any information beyond that point. */
+static double GetTimeUnit(const ADQGen4RecordHeader &header)
+{
+    const int time_unit_ps = static_cast<int>(header.time_unit * 1e12);
+    return static_cast<double>(time_unit_ps) * 1e-12;
+}
+
+double TimeDomainRecord::GetSamplingPeriod(const ADQGen4RecordHeader &header)
+{
+    return static_cast<double>(header.sampling_period) * GetTimeUnit(header);
+}
+
+void TimeDomainRecord::Convert(const ADQGen4RecordHeader &raw_header, const void *raw_data,
+                               const ADQAnalogFrontendParametersChannel &afe,
+                               double code_normalization, bool convert_horizontal,
+                               bool convert_vertical, double *fft, size_t nof_fft_samples,
+                               const double *window, bool trace)
+{
+    header = raw_header;
+    y.resize(trace ? header.record_length : 0);
+    x_properties = convert_horizontal ? X_PROPERTIES : X_PROPERTIES_UNCONVERTED;
+    y_properties = convert_vertical ? Y_PROPERTIES : Y_PROPERTIES_UNCONVERTED;
+    metrics = TimeDomainMetrics(y_properties);
+
+    const double time_unit = GetTimeUnit(header);
+    sampling_period.value = GetSamplingPeriod(header);
+    sampling_frequency.value = std::round(1.0 / sampling_period.value);
+
+    if (convert_horizontal)
+    {
+        step = sampling_period.value;
+        start = static_cast<double>(header.record_start) * time_unit;
+    }
+    else
+    {
+        /* We intentionally always start with the first sample at zero to
+           keep the horizontal grid in sync w/ the sampling grid. */
+        /* TODO: At some point we could add visualization of the trigger point. */
+        step = 1.0;
+        start = 0.0; /* T: Always start at 0? */
+    }
+
+    if (convert_vertical)
+    {
+        range_max = ValueY((afe.input_range / 2 - afe.dc_offset) / 1e3);
+        range_min = ValueY((-afe.input_range / 2 - afe.dc_offset) / 1e3);
+        range_mid = ValueY((range_max.value + range_min.value) / 2);
+    }
+    else
+    {
+        range_max = ValueY(code_normalization / 2 - 1);
+        range_min = ValueY(-(code_normalization / 2));
+        range_mid = ValueY(0.0);
+    }
+
+    const SampleConversion conversion(code_normalization, afe.input_range, afe.dc_offset,
+                                      convert_vertical);
+
+    SampleStatistics codes{};
+    switch (header.data_format)
+    {
+    case ADQ_DATA_FORMAT_INT16:
+        conversion.Convert(static_cast<const int16_t *>(raw_data), header.record_length,
+                           trace ? y.data() : NULL, fft, nof_fft_samples, window, &codes);
+        break;
+
+    case ADQ_DATA_FORMAT_INT32:
+        conversion.Convert(static_cast<const int32_t *>(raw_data), header.record_length,
+                           trace ? y.data() : NULL, fft, nof_fft_samples, window, &codes);
+        break;
+
+    default:
+        throw std::invalid_argument(
+            fmt::format("Unknown data format '{}' when transforming time domain record.",
+                        header.data_format));
+    }
+
+    /* The trace is an affine transformation of the codes with a positive
+       scale, so the statistics carry over exactly. */
+    const double scale = conversion.TraceScale();
+    const double offset = conversion.TraceOffset();
+    statistics.max = codes.max * scale + offset;
+    statistics.min = codes.min * scale + offset;
+    statistics.mean = codes.Mean() * scale + offset;
+    statistics.sdev = std::sqrt(codes.Variance()) * scale;
+    statistics.nof_clipped_low = codes.nof_clipped_low;
+    statistics.nof_clipped_high = codes.nof_clipped_high;
+}
+
+void FrequencyDomainRecord::Reset(size_t count)
+{
+    y.clear();
+    start = 0.0;
+    step = 0.0;
+    fundamental = {};
+    spur = {};
+    harmonics.clear();
+    gain_phase_spur = {};
+    offset_spur = {};
+
+    for (auto *value : {&snr, &sinad, &enob, &sfdr_dbc, &sfdr_dbfs, &thd, &npsd,
+                        &noise_moving_average, &size, &rbw})
+    {
+        value->value = 0.0;
+        value->valid = true;
+    }
+
+    scale_factor = 1.0;
+    energy_factor = 1.0;
+    relative_power.noise = 0.0;
+    relative_power.gain_phase_spur = 0.0;
+    relative_power.offset_spur = 0.0;
+    relative_power.harmonics.clear();
+    power.resize(count);
+}
+
+void FrequencyDomainRecord::ConvertToDecibels()
+{
+    /* 10 * log10(power * scale_factor / energy_factor) */
+    y.resize(power.size());
+    SampleConversion::Decibels(power.data(), power.size(),
+                               10.0 * std::log10(scale_factor / energy_factor), y.data());
+}
+
+Waterfall::Waterfall(size_t rows, size_t size, size_t max_columns, double start, double step)
+    : rows(std::max(rows, size_t{1}))
+    , size(size)
+    , decimation(std::max((size + max_columns - 1) / std::max(max_columns, size_t{1}), size_t{1}))
+    , columns((size + decimation - 1) / decimation)
+    , start(start)
+    , step(step)
+    , x_min(start - step / 2)
+    , x_max(x_min + static_cast<double>(columns * decimation) * step)
+    , m_data(this->rows * columns)
+    , m_head(0)
+    , m_nof_inserted(0)
+    , m_mutex{}
+{
+}
+
+uint64_t Waterfall::Insert(const RecordValue *y, size_t size)
+{
+    std::unique_lock lock{m_mutex};
+
+    /* The rows are written backwards through the memory, which keeps them in
+       order from newest to oldest when read forwards from the head. */
+    m_head = (m_head == 0) ? rows - 1 : m_head - 1;
+    auto row = m_data.data() + m_head * columns;
+
+    if (decimation == 1)
+    {
+        std::copy(y, y + std::min(size, columns), row);
+    }
+    else
+    {
+        for (size_t c = 0; c < columns; ++c)
+        {
+            const size_t begin = c * decimation;
+            const size_t end = std::min(begin + decimation, size);
+            row[c] = begin < end ? *std::max_element(y + begin, y + end) : RecordValue{};
+        }
+    }
+
+    return ++m_nof_inserted;
+}
+
+size_t Waterfall::GetSpans(uint64_t sequence, Span &first, Span &second) const
+{
+    first = {NULL, 0};
+    second = {NULL, 0};
+    if (sequence == 0 || sequence > m_nof_inserted)
+        return 0;
+
+    /* The rows up to `nof_overwritten` have been replaced by newer ones. */
+    const uint64_t nof_overwritten = m_nof_inserted > rows ? m_nof_inserted - rows : 0;
+    if (sequence <= nof_overwritten)
+        return 0;
+
+    const uint64_t nof_newer = m_nof_inserted - sequence;
+    const size_t nof_rows = static_cast<size_t>(sequence - nof_overwritten);
+    const size_t start = static_cast<size_t>((m_head + nof_newer) % rows);
+
+    first.data = m_data.data() + start * columns;
+    first.rows = std::min(nof_rows, rows - start);
+    if (first.rows < nof_rows)
+    {
+        second.data = m_data.data();
+        second.rows = nof_rows - first.rows;
+    }
+
+    return nof_rows;
+}
+
+size_t Waterfall::Copy(uint64_t sequence, std::vector<RecordValue> &data) const
+{
+    std::unique_lock lock{m_mutex};
+    Span first;
+    Span second;
+    const size_t nof_rows = GetSpans(sequence, first, second);
+
+    /* The spans are contiguous in the copy, newest first. */
+    data.resize(nof_rows * columns);
+    std::copy(first.data, first.data + first.rows * columns, data.data());
+    std::copy(second.data, second.data + second.rows * columns, data.data() + first.rows * columns);
+    return nof_rows;
+}
+
 MovingAverage::MovingAverage()
     : m_log{}
+    , m_head(0)
+    , m_nof_entries(0)
+    , m_size(0)
+    , m_sum{}
+    , m_compensation{}
     , m_nof_averages(1)
 {}
 
 void MovingAverage::SetNumberOfAverages(size_t nof_averages)
 {
-    if (nof_averages < m_log.size())
-        m_log.resize(nof_averages);
+    nof_averages = std::max(nof_averages, static_cast<size_t>(1));
+    if (nof_averages != m_nof_averages)
+        Release();
     m_nof_averages = nof_averages;
 }
 
 void MovingAverage::PrepareNewEntry(size_t size)
 {
-    if (m_log.size() >= m_nof_averages)
-        m_log.pop_back();
-    m_log.emplace_front(size);
+    if (size != m_size)
+    {
+        Clear();
+        m_size = size;
+        m_sum.assign(size, 0.0);
+        m_compensation.assign(size, 0.0);
+    }
+
+    if (m_nof_entries == 0)
+        m_head = 0;
+    else
+        m_head = (m_head + 1) % m_nof_averages;
+
+    if (m_nof_entries < m_nof_averages)
+    {
+        /* The log is growing. Reuse the memory of an entry if we have it. */
+        if (m_head >= m_log.size())
+            m_log.emplace_back(size, 0.0);
+        else
+            m_log[m_head].assign(size, 0.0);
+        ++m_nof_entries;
+    }
 }
 
 double MovingAverage::InsertAndAverage(size_t i, double y)
 {
-    /* Assign y[i] to the foremost log entry. */
-    m_log.at(0).at(i) = y;
-
-    /* Calculate the average at position i over all the entries in the log. We
-       let the first entry define the expected size and as soon as we see an
-       entry with a different size, we stop. We need this cutoff because the log
-       can consist of entries with varying sizes if the user has changed the
-       record length in the middle of an ongoing acquisition. */
-    double result = y;
-    size_t j = 1;
-    size_t size = m_log.at(0).size();
-    for (; j < m_log.size(); ++j)
-    {
-        if (m_log[j].size() != size)
-            break;
-        result += m_log.at(j).at(i);
-    }
-    result /= static_cast<double>(j);
+    /* Replace the oldest value (or zero if the log is growing). */
+    auto &entry = m_log[m_head];
+    Accumulate(i, y);
+    Accumulate(i, -entry[i]);
+    entry[i] = y;
 
-    return result;
+    /* Guard against a slightly negative result from the remaining rounding
+       errors. */
+    const double sum = m_sum[i] + m_compensation[i];
+    return std::max(sum, 0.0) / static_cast<double>(m_nof_entries);
+}
+
+void MovingAverage::Accumulate(size_t i, double value)
+{
+    /* Neumaier's variant of Kahan summation. */
+    double &sum = m_sum[i];
+    const double t = sum + value;
+    if (std::abs(sum) >= std::abs(value))
+        m_compensation[i] += (sum - t) + value;
+    else
+        m_compensation[i] += (value - t) + sum;
+    sum = t;
 }
 
 void MovingAverage::Clear()
 {
+    m_head = 0;
+    m_nof_entries = 0;
+    m_size = 0;
+    m_sum.clear();
+    m_compensation.clear();
+}
+
+void MovingAverage::Release()
+{
+    Clear();
     m_log.clear();
+    m_log.shrink_to_fit();
+    m_sum.shrink_to_fit();
+    m_compensation.shrink_to_fit();
+}
+
+ExponentialAverage::ExponentialAverage()
+    : m_average{}
+    , m_nof_entries(0)
+    , m_nof_averages(1)
+    , m_weight(1.0)
+{}
+
+void ExponentialAverage::SetNumberOfAverages(size_t nof_averages)
+{
+    if (nof_averages != m_nof_averages)
+        Clear();
+    m_nof_averages = nof_averages;
+}
+
+void ExponentialAverage::PrepareNewEntry(size_t size)
+{
+    if (size != m_average.size())
+    {
+        Clear();
+        m_average.assign(size, 0.0);
+    }
+
+    ++m_nof_entries;
+    if (m_nof_averages > 0 && m_nof_entries > m_nof_averages)
+        m_weight = 1.0 / static_cast<double>(m_nof_averages);
+    else
+        m_weight = 1.0 / static_cast<double>(m_nof_entries);
+}
+
+double ExponentialAverage::InsertAndAverage(size_t i, double y)
+{
+    auto &average = m_average[i];
+    average += m_weight * (y - average);
+    return average;
+}
+
+void ExponentialAverage::Clear()
+{
+    m_nof_entries = 0;
+    m_weight = 1.0;
+    m_average.clear();
 }
 
 MaximumHold::MaximumHold()
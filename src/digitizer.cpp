@@ -42,12 +42,15 @@ Digitizer::Digitizer(void *handle, int init_index, int index,
     , m_processing_threads{}
     , m_no_activity_threshold_ms(DEFAULT_ACTIVITY_THRESHOLD_MS)
     , m_notified_no_activity(false)
+    , m_next_activity_check_ms(-1)
+    , m_wakeup(std::make_shared<Event>())
     , m_sensor_records{}
     , m_sensor_record_queue()
     , m_sensor_last_record_timestamp(std::chrono::high_resolution_clock::now())
     , m_last_status_timestamp(std::chrono::high_resolution_clock::now())
 {
     m_sensor_record_queue.Start();
+    _SetMessageEvent(m_wakeup);
 }
 
 Digitizer::~Digitizer()
@@ -88,7 +91,6 @@ void Digitizer::MainLoop()
     {
         try
         {
-            /* Can't go faster than 10 Hz unless we change the wait but that should suffice. */
             ProcessMessages();
             ProcessWatcherMessages();
             UpdateSystemManagerObjects();
@@ -100,10 +102,12 @@ void Digitizer::MainLoop()
             SignalError(e.what());
         }
 
-        /* We implement the sleep using the stop event to be able to immediately
-           react to the event being set. */
+        /* Sleep until there's a message from the outside world or from one of
+           the file watchers, or until the next periodic task is due. Stopping
+           the thread stops the message channels, which sets the event. */
         if (m_should_stop.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
             break;
+        m_wakeup->WaitUntil(NextDeadline());
     }
 
     StopDataAcquisition();
@@ -168,7 +172,7 @@ void Digitizer::SignalError(const std::string &message)
 void Digitizer::ProcessMessages()
 {
     DigitizerMessage message;
-    while (SCAPE_EOK == _WaitForMessage(message, 100))
+    while (SCAPE_EOK == _WaitForMessage(message, 0))
         HandleMessageInState(message);
 }
 
@@ -372,13 +376,14 @@ void Digitizer::UpdateSystemManagerObjects()
             if (sensor.y.size() > 60 * 60 * 10)
             {
                 sensor.y.erase(sensor.y.begin());
-                sensor.x.erase(sensor.x.begin());
+                sensor.start += sensor.step;
             }
 
+            /* The first sample is placed one step after the current time. */
+            if (sensor.y.empty())
+                sensor.start = static_cast<double>(std::time(NULL)) + sensor.step;
+
             sensor.y.emplace_back(value);
-            double last = (sensor.x.size() > 0) ? sensor.x.back()
-                                                : static_cast<double>(std::time(NULL));
-            sensor.x.emplace_back(last + sensor.step);
         }
 
         /* Make a copy of the current sensor records and push a shared pointer
@@ -414,6 +419,17 @@ void Digitizer::CheckActivity()
         _EmplaceMessage(DigitizerMessageId::EVENT_CLEAR);
         m_notified_no_activity = false;
     }
+
+    /* Schedule the next check. Without any activity, the threshold is crossed
+       at a predictable time. Once we've notified, we have to poll to find out
+       when the data comes back. */
+    if (milliseconds_max < 0)
+        m_next_activity_check_ms = -1;
+    else if (m_notified_no_activity)
+        m_next_activity_check_ms = ACTIVITY_POLL_PERIOD_MS;
+    else
+        m_next_activity_check_ms =
+            std::max(m_no_activity_threshold_ms + ACTIVITY_HYSTERESIS_MS - milliseconds_max + 1, 1);
 }
 
 void Digitizer::CheckStatus()
@@ -454,6 +470,24 @@ void Digitizer::CheckStatus()
     }
 }
 
+std::chrono::high_resolution_clock::time_point Digitizer::NextDeadline() const
+{
+    using Duration = std::chrono::high_resolution_clock::duration;
+    const auto Milliseconds = [](double ms) {
+        return std::chrono::duration_cast<Duration>(std::chrono::duration<double, std::milli>(ms));
+    };
+
+    auto deadline = m_sensor_last_record_timestamp + Milliseconds(SENSOR_SAMPLING_PERIOD_MS);
+    if (m_state == DigitizerState::ACQUISITION)
+        deadline = std::min(deadline, m_last_status_timestamp + Milliseconds(STATUS_SAMPLING_PERIOD_MS));
+    if (m_next_activity_check_ms >= 0)
+    {
+        deadline = std::min(deadline, std::chrono::high_resolution_clock::now() +
+                                          Milliseconds(m_next_activity_check_ms));
+    }
+    return deadline;
+}
+
 void Digitizer::StartDataAcquisition()
 {
     try
@@ -1055,6 +1089,8 @@ void Digitizer::InitializeFileWatchers()
     m_parameters.top = std::make_shared<std::string>("");
     m_parameters.clock_system = std::make_shared<std::string>("");
 
+    m_watchers.top->SetMessageEvent(m_wakeup);
+    m_watchers.clock_system->SetMessageEvent(m_wakeup);
     m_watchers.top->Start();
     m_watchers.clock_system->Start();
 }
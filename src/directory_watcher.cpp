@@ -5,7 +5,10 @@ DirectoryWatcher::DirectoryWatcher(const std::filesystem::path &path, const std:
     : m_path{path}
     , m_extension_filter{extension_filter}
     , m_files{}
-{}
+    , m_is_running{false}
+    , m_notifier{}
+{
+}
 
 DirectoryWatcher::~DirectoryWatcher()
 {
@@ -17,87 +20,101 @@ const std::filesystem::path &DirectoryWatcher::GetPath()
     return m_path;
 }
 
-void DirectoryWatcher::MainLoop()
+int DirectoryWatcher::Start()
 {
+    if (m_is_running)
+        return SCAPE_ENOTREADY;
+
     /* Avoid watching an empty path. */
     if (m_path.empty())
     {
         Log::log->error("The directory watcher cannot watch an empty path.");
-        m_thread_exit_code = SCAPE_EINTERNAL;
-        return;
+        return SCAPE_EINTERNAL;
     }
 
     Log::log->trace("Starting directory watcher for '{}'.", m_path.string());
-    m_thread_exit_code = SCAPE_EOK;
 
-    for (;;)
+    /* The directory may not exist yet, or may be removed later on, in which
+       case the notifier polls until it can set up the watch again. */
+    RETURN_CALL(m_notifier.Start(m_path, POLL_PERIOD_MS,
+                                 [this](const auto &names) { CheckDirectory(names); }));
+    m_is_running = true;
+    return SCAPE_EOK;
+}
+
+int DirectoryWatcher::Stop()
+{
+    if (!m_is_running)
+        return SCAPE_ENOTREADY;
+
+    m_notifier.Stop();
+    m_is_running = false;
+
+    Log::log->trace("Stopping directory watcher for '{}'.", m_path.string());
+    return SCAPE_EOK;
+}
+
+void DirectoryWatcher::CheckDirectory(const std::set<std::string> &modified)
+{
+    if (std::filesystem::exists(m_path))
     {
-        if (std::filesystem::exists(m_path))
+        if (std::filesystem::is_directory(m_path))
         {
-            if (std::filesystem::is_directory(m_path))
+            /* Assume every tracked file should be erased and disprove this
+               by traversing the directory. */
+            for (auto &[path, state] : m_files)
+                state.should_remove = true;
+
+            for (auto const &entry : std::filesystem::directory_iterator{m_path})
             {
-                /* Assume every tracked file should be erased and disprove this
-                   by traversing the directory. */
-                for (auto &[path, state] : m_files)
-                    state.should_remove = true;
+                if (!entry.is_regular_file())
+                    continue;
+                if (!m_extension_filter.empty() && entry.path().extension() != m_extension_filter)
+                    continue;
+
+                auto timestamp = std::filesystem::last_write_time(entry.path());
+                auto match = m_files.find(entry.path());
 
-                for (auto const &entry : std::filesystem::directory_iterator{m_path})
+                if (match == m_files.end())
                 {
-                    if (!entry.is_regular_file())
-                        continue;
-                    if (!m_extension_filter.empty() && entry.path().extension() != m_extension_filter)
-                        continue;
-
-                    auto timestamp = std::filesystem::last_write_time(entry.path());
-                    auto match = m_files.find(entry.path());
-
-                    if (match == m_files.end())
-                    {
-                        /* This is a new file. */
-                        m_files.emplace(entry.path(), FileState{false, entry.path(), timestamp});
-                        _EmplaceMessage(DirectoryWatcherMessageId::FILE_CREATED, entry.path());
-                    }
-                    else if (timestamp != match->second.timestamp)
-                    {
-                        /* The file has been updated. */
-                        match->second.timestamp = timestamp;
-                        match->second.should_remove = false;
-                        _EmplaceMessage(DirectoryWatcherMessageId::FILE_UPDATED, entry.path());
-                    }
-                    else
-                    {
-                        match->second.should_remove = false;
-                    }
+                    /* This is a new file. */
+                    m_files.emplace(entry.path(), FileState{false, entry.path(), timestamp});
+                    _EmplaceMessage(DirectoryWatcherMessageId::FILE_CREATED, entry.path());
                 }
-
-                for (auto it = m_files.begin(); it != m_files.end(); )
+                else if (timestamp != match->second.timestamp ||
+                         modified.count(entry.path().filename().string()) > 0)
                 {
-                    if (it->second.should_remove)
-                    {
-                        _EmplaceMessage(DirectoryWatcherMessageId::FILE_DELETED, it->second.path);
-                        it = m_files.erase(it);
-                    }
-                    else
-                    {
-                        ++it;
-                    }
+                    /* The file has been updated. */
+                    match->second.timestamp = timestamp;
+                    match->second.should_remove = false;
+                    _EmplaceMessage(DirectoryWatcherMessageId::FILE_UPDATED, entry.path());
+                }
+                else
+                {
+                    match->second.should_remove = false;
                 }
             }
-        }
-        else
-        {
-            /* Directory doesn't exists. If we were tracking files, it was just erased. */
-            for (const auto &[path, state] : m_files)
-                _EmplaceMessage(DirectoryWatcherMessageId::FILE_DELETED, path);
 
-            m_files.clear();
+            for (auto it = m_files.begin(); it != m_files.end(); )
+            {
+                if (it->second.should_remove)
+                {
+                    _EmplaceMessage(DirectoryWatcherMessageId::FILE_DELETED, it->second.path);
+                    it = m_files.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
         }
-
-        /* We implement the sleep using the stop event to be able to immediately
-           react to the event being set. */
-        if (m_should_stop.wait_for(std::chrono::milliseconds(1000)) == std::future_status::ready)
-            break;
     }
+    else
+    {
+        /* Directory doesn't exists. If we were tracking files, it was just erased. */
+        for (const auto &[path, state] : m_files)
+            _EmplaceMessage(DirectoryWatcherMessageId::FILE_DELETED, path);
 
-    Log::log->trace("Stopping directory watcher for '{}'.", m_path.string());
+        m_files.clear();
+    }
 }
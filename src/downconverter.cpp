@@ -0,0 +1,375 @@
+#include "downconverter.h"
+#include "error.h"
+
+#include <algorithm>
+#include <cmath>
+#include <new>
+
+Downconverter::Downconverter()
+    : m_sampling_frequency(0.0)
+    , m_center_frequency(0.0)
+    , m_span(0.0)
+    , m_decimation(1)
+    , m_length(0)
+    , m_stages{}
+    , m_mixer_taps{}
+{
+}
+
+int Downconverter::Configure(double sampling_frequency, double center_frequency, double span,
+                             size_t max_length)
+{
+    if (!(sampling_frequency > 0.0) || !(span > 0.0) || center_frequency - span / 2 < 0.0 ||
+        center_frequency + span / 2 > sampling_frequency / 2)
+    {
+        return SCAPE_EINVAL;
+    }
+
+    if (sampling_frequency == m_sampling_frequency && center_frequency == m_center_frequency &&
+        span == m_span && !m_stages.empty() && m_length <= max_length)
+    {
+        return SCAPE_EOK;
+    }
+
+    m_stages.clear();
+    m_mixer_taps.clear();
+    m_length = 0;
+
+    /* Every output depends on at least D input samples, so there's no point in
+       going any further with an absurd decimation factor. */
+    const double limit = static_cast<double>(std::min(max_length, MAX_LENGTH));
+    const double decimation = std::floor(sampling_frequency / (OVERSAMPLING * span));
+    if (!(decimation < limit))
+        return SCAPE_EINVAL;
+
+    /* Write the decimation factor as 2^S R, rounding it down to fit. */
+    size_t R = static_cast<size_t>(std::max(decimation, 1.0));
+    size_t nof_halfbands = 0;
+    while (R >= 2 * MIN_FINAL_DECIMATION)
+    {
+        R /= 2;
+        nof_halfbands++;
+    }
+
+    const size_t D = (size_t{1} << nof_halfbands) * R;
+    const double output_sampling_frequency = sampling_frequency / D;
+
+    std::vector<Stage> stages;
+    try
+    {
+        /* Each halfband filter has to pass the band and stop its images, which
+           end up on top of it once the rate has been halved. */
+        double stage_sampling_frequency = sampling_frequency;
+        for (size_t i = 0; i < nof_halfbands; ++i)
+        {
+            Stage stage{};
+            stage.decimation = 2;
+            const auto h = Halfband(span / 2 / stage_sampling_frequency);
+            stage.length = h.size();
+            for (size_t k = 0; k < h.size(); ++k)
+            {
+                if (h[k] != 0.0)
+                {
+                    stage.offsets.push_back(k);
+                    stage.taps.push_back(h[k]);
+                }
+            }
+
+            stages.push_back(std::move(stage));
+            stage_sampling_frequency /= 2;
+        }
+
+        /* The band of the last stage is free of aliases as long as the
+           stopband starts at the output sampling rate minus half the span. The
+           transition band of the Blackman window is roughly 5.5 / N
+           (normalized) for N taps. */
+        const double transition =
+            (output_sampling_frequency - span) / stage_sampling_frequency;
+        size_t nof_taps = static_cast<size_t>(std::ceil(5.5 / transition));
+        nof_taps += (nof_taps % 2 == 0) ? 1 : 0;
+
+        Stage stage{};
+        stage.decimation = R;
+        stage.length = nof_taps;
+        const auto h = LowPass(nof_taps, R);
+        for (size_t k = 0; k < h.size(); ++k)
+        {
+            if (h[k] != 0.0)
+            {
+                stage.offsets.push_back(k);
+                stage.taps.push_back(h[k]);
+            }
+        }
+        stages.push_back(std::move(stage));
+    }
+    catch (const std::bad_alloc &)
+    {
+        return SCAPE_EINVAL;
+    }
+
+    /* Work out how many outputs of each stage go into one output of the
+       downconverter, starting from the last stage. We check the length of the
+       impulse response in floating point since it grows with D. */
+    double support = 1.0;
+    size_t stride = 1;
+    for (auto it = stages.rbegin(); it != stages.rend(); ++it)
+    {
+        if (!(support < limit))
+            return SCAPE_EINVAL;
+
+        it->support = static_cast<size_t>(support);
+        it->stride = stride;
+        support = (support - 1.0) * static_cast<double>(it->decimation) +
+                  static_cast<double>(it->length);
+        stride *= it->decimation;
+    }
+
+    if (!(support <= limit))
+        return SCAPE_EINVAL;
+
+    /* Fold the NCO into the taps of the first stage. */
+    const double PI = std::acos(-1.0);
+    const double omega = 2 * PI * center_frequency / sampling_frequency;
+    const auto &first = stages.front();
+    try
+    {
+        m_mixer_taps.resize(first.taps.size());
+    }
+    catch (const std::bad_alloc &)
+    {
+        return SCAPE_EINVAL;
+    }
+
+    for (size_t i = 0; i < first.taps.size(); ++i)
+        m_mixer_taps[i] = std::polar(first.taps[i], -omega * static_cast<double>(first.offsets[i]));
+
+    m_stages = std::move(stages);
+    m_length = static_cast<size_t>(support);
+    m_decimation = D;
+    m_sampling_frequency = sampling_frequency;
+    m_center_frequency = center_frequency;
+    m_span = span;
+    return SCAPE_EOK;
+}
+
+std::vector<double> Downconverter::LowPass(size_t nof_taps, size_t decimation)
+{
+    /* A windowed sinc with its cutoff at 1 / (2 R). The window doesn't reach
+       zero at the ends, so every tap counts. The taps at the multiples of R
+       from the center are zero in the ideal filter and we keep them that way.
+       The center tap is 1 / R and the others are scaled to sum to 1 - 1 / R,
+       giving unity gain at DC. For R = 2, this is a halfband filter whose
+       response is antisymmetric around a quarter of the sampling rate. */
+    const double PI = std::acos(-1.0);
+    const double R = static_cast<double>(decimation);
+    const double center = static_cast<double>(nof_taps - 1) / 2;
+    std::vector<double> h(nof_taps);
+
+    double sum = 0.0;
+    for (size_t k = 0; k < nof_taps; ++k)
+    {
+        const double t = static_cast<double>(k) - center;
+        if (t == 0.0 || std::fmod(std::abs(t), R) == 0.0)
+            continue;
+
+        const double phase = 2 * PI * static_cast<double>(k + 1) / static_cast<double>(nof_taps + 1);
+        const double blackman = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2 * phase);
+        h[k] = std::sin(PI * t / R) / (PI * t) * blackman;
+        sum += h[k];
+    }
+
+    const double scale = sum != 0.0 ? (1.0 - 1.0 / R) / sum : 0.0;
+    for (auto &value : h)
+        value *= scale;
+    h[static_cast<size_t>(center)] = 1.0 / R;
+    return h;
+}
+
+std::vector<double> Downconverter::Halfband(double edge)
+{
+    /* The response is antisymmetric around a quarter of the sampling rate, so
+       the error in the passband mirrors the leakage in the stopband. We look
+       for the shortest filter whose leakage is within the tolerance. The
+       length is on the form 4K + 3 for the taps at the ends to be nonzero. */
+    const double PI = std::acos(-1.0);
+    static constexpr size_t NOF_POINTS = 32;
+    static constexpr size_t MAX_TAPS = 1023;
+
+    for (size_t nof_taps = 3;; nof_taps += 4)
+    {
+        const auto h = LowPass(nof_taps, 2);
+        if (nof_taps >= MAX_TAPS)
+            return h;
+
+        const double center = static_cast<double>(nof_taps - 1) / 2;
+        double leakage = 0.0;
+        for (size_t i = 0; i <= NOF_POINTS; ++i)
+        {
+            const double f = 0.5 - edge * static_cast<double>(i) / NOF_POINTS;
+            double response = 0.0;
+            for (size_t k = 0; k < nof_taps; ++k)
+                response += h[k] * std::cos(2 * PI * f * (static_cast<double>(k) - center));
+            leakage = std::max(leakage, std::abs(response));
+        }
+
+        if (leakage <= HALFBAND_TOLERANCE)
+            return h;
+    }
+}
+
+size_t Downconverter::Taps() const
+{
+    size_t result = 0;
+    for (const auto &stage : m_stages)
+        result += stage.taps.size();
+    return result;
+}
+
+double Downconverter::MultiplyAddsPerSample() const
+{
+    /* The first stage takes real input with complex taps and rotates each
+       output by the NCO phase, which takes four multiplications to apply and
+       another four to advance. The other stages take complex input with real
+       taps. */
+    double result = 0.0;
+    double rate = 1.0;
+    for (size_t i = 0; i < m_stages.size(); ++i)
+    {
+        rate /= static_cast<double>(m_stages[i].decimation);
+        const double nof_taps = static_cast<double>(m_stages[i].taps.size());
+        result += rate * (i == 0 ? 2 * nof_taps + 8 : 2 * nof_taps);
+    }
+    return result;
+}
+
+size_t Downconverter::OutputLength(size_t nof_samples) const
+{
+    if (m_stages.empty() || nof_samples < m_length)
+        return 0;
+    return (nof_samples - m_length) / m_decimation + 1;
+}
+
+void Downconverter::Process(const double *x, size_t nof_samples,
+                            std::vector<std::complex<double>> &y, WorkerPool *pool) const
+{
+    y.resize(OutputLength(nof_samples));
+    if (y.empty())
+        return;
+
+    /* Each range of outputs has to run the filters over the samples leading
+       up to it, i.e. the length of the impulse response. We keep the ranges
+       long enough for that to be a small fraction of the work. */
+    size_t nof_ranges = 1;
+    if (pool != NULL)
+    {
+        nof_ranges = std::min({y.size(), 4 * pool->GetConcurrency(),
+                               std::max(nof_samples / (8 * m_length), size_t{1})});
+    }
+
+    if (nof_ranges > 1)
+    {
+        pool->ParallelFor(nof_ranges, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                Run(x, i * y.size() / nof_ranges, (i + 1) * y.size() / nof_ranges, y.data());
+            }
+        });
+    }
+    else
+    {
+        Run(x, 0, y.size(), y.data());
+    }
+}
+
+void Downconverter::Run(const double *x, size_t begin, size_t end, std::complex<double> *y) const
+{
+    if (begin >= end)
+        return;
+
+    const Stage &first = m_stages.front();
+    const size_t last = m_stages.size() - 1;
+
+    /* The outputs of the first stage that go into the outputs [begin, end). */
+    const size_t first_begin = begin * first.stride;
+    const size_t first_end = (end - 1) * first.stride + first.support;
+
+    /* The output m of the first stage is exp(-i w m d) sum_k g[k] x[m d + k]
+       where g[k] are the taps with the NCO folded in. The phase is computed
+       from scratch at fixed points and advanced in between, which keeps the
+       result independent of how the outputs are split into ranges. We keep
+       track of the phase in cycles to keep the argument small. */
+    const double PI = std::acos(-1.0);
+    const double cycles_per_output = std::fmod(
+        m_center_frequency / m_sampling_frequency * static_cast<double>(first.decimation), 1.0);
+    const auto rotation = std::polar(1.0, -2 * PI * cycles_per_output);
+    std::complex<double> phasor{1.0, 0.0};
+
+    /* The inputs of the other stages and the index of their next output. */
+    std::vector<std::vector<std::complex<double>>> inputs(m_stages.size());
+    std::vector<size_t> next(m_stages.size());
+    for (size_t i = 1; i < m_stages.size(); ++i)
+    {
+        inputs[i].reserve(BLOCK + m_stages[i].length);
+        next[i] = begin * m_stages[i].stride;
+    }
+
+    for (size_t block = first_begin; block < first_end; block += BLOCK)
+    {
+        const size_t block_end = std::min(block + BLOCK, first_end);
+        for (size_t m = block; m < block_end; ++m)
+        {
+            if (m == first_begin || m % NCO_BLOCK == 0)
+            {
+                const size_t anchor = m - m % NCO_BLOCK;
+                const double cycles =
+                    std::fmod(cycles_per_output * static_cast<double>(anchor), 1.0);
+                phasor = std::polar(1.0, -2 * PI * cycles);
+                for (size_t i = anchor; i < m; ++i)
+                    phasor *= rotation;
+            }
+
+            const double *input = x + m * first.decimation;
+            double re = 0.0;
+            double im = 0.0;
+            for (size_t k = 0; k < m_mixer_taps.size(); ++k)
+            {
+                const double value = input[first.offsets[k]];
+                re += m_mixer_taps[k].real() * value;
+                im += m_mixer_taps[k].imag() * value;
+            }
+
+            const auto value = std::complex<double>(re, im) * phasor;
+            phasor *= rotation;
+
+            if (last == 0)
+                y[m] = value;
+            else
+                inputs[1].push_back(value);
+        }
+
+        /* Pass the block on through the other stages. */
+        for (size_t i = 1; i <= last; ++i)
+        {
+            const Stage &stage = m_stages[i];
+            auto &input = inputs[i];
+            size_t nof_outputs = 0;
+            while (nof_outputs * stage.decimation + stage.length <= input.size())
+            {
+                const auto *window = input.data() + nof_outputs * stage.decimation;
+                std::complex<double> value{};
+                for (size_t k = 0; k < stage.taps.size(); ++k)
+                    value += stage.taps[k] * window[stage.offsets[k]];
+
+                if (i == last)
+                    y[next[i]] = value;
+                else
+                    inputs[i + 1].push_back(value);
+
+                next[i]++;
+                nof_outputs++;
+            }
+
+            input.erase(input.begin(), input.begin() + nof_outputs * stage.decimation);
+        }
+    }
+}
@@ -0,0 +1,372 @@
+#include "event_loop.h"
+#include "error.h"
+#include "log.h"
+
+#include <algorithm>
+#include <exception>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+EventLoop::EventLoop()
+    : m_mutex()
+    , m_wakeup()
+    , m_idle()
+    , m_sources()
+    , m_ready()
+    , m_next_id(1)
+    , m_running_id(0)
+    , m_is_woken(false)
+    , m_should_stop(false)
+    , m_epoll(-1)
+    , m_eventfd(-1)
+    , m_thread()
+{
+#ifdef __linux__
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = 0;
+    if (m_epoll < 0 || m_eventfd < 0 || epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_eventfd, &event) < 0)
+    {
+        Log::log->warn("Failed to initialize epoll, the event loop only supports timers and signals.");
+        if (m_epoll >= 0)
+            close(m_epoll);
+        if (m_eventfd >= 0)
+            close(m_eventfd);
+        m_epoll = -1;
+        m_eventfd = -1;
+    }
+#endif
+
+    m_thread = std::thread([this] { MainLoop(); });
+}
+
+EventLoop::~EventLoop()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_should_stop = true;
+    }
+    Wake();
+    m_thread.join();
+
+#ifdef __linux__
+    if (m_epoll >= 0)
+        close(m_epoll);
+    if (m_eventfd >= 0)
+        close(m_eventfd);
+#endif
+}
+
+EventLoop &EventLoop::Shared()
+{
+    static EventLoop loop;
+    return loop;
+}
+
+int EventLoop::Add(Source &&source, uint64_t &id)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    id = m_next_id++;
+    m_sources.emplace(id, std::move(source));
+    return SCAPE_EOK;
+}
+
+int EventLoop::AddDescriptor(int fd, Handler handler, uint64_t &id)
+{
+#ifdef __linux__
+    if (m_epoll < 0)
+        return SCAPE_EUNSUPPORTED;
+    if (fd < 0)
+        return SCAPE_EINVAL;
+
+    /* The id is reserved under the lock together with the source so that an
+       event can't show up for a source that doesn't exist yet. */
+    std::unique_lock<std::mutex> lock(m_mutex);
+    id = m_next_id++;
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = id;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        Log::log->error("Failed to add file descriptor {} to the event loop, errno {}.", fd, errno);
+        id = 0;
+        return SCAPE_EEXTERNAL;
+    }
+
+    m_sources.emplace(id, Source{SourceType::DESCRIPTOR, std::make_shared<Handler>(std::move(handler)),
+                                 fd, false, false, {}, {}});
+    return SCAPE_EOK;
+#else
+    (void)fd;
+    (void)handler;
+    id = 0;
+    return SCAPE_EUNSUPPORTED;
+#endif
+}
+
+int EventLoop::AddTimer(Handler handler, uint64_t &id)
+{
+    return Add(Source{SourceType::TIMER, std::make_shared<Handler>(std::move(handler)), -1, false,
+                      false, {}, {}},
+               id);
+}
+
+int EventLoop::SetTimer(uint64_t id, int delay_ms, int period_ms)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto source = m_sources.find(id);
+        if (source == m_sources.end() || source->second.type != SourceType::TIMER)
+            return SCAPE_EINVAL;
+
+        source->second.is_armed = delay_ms >= 0;
+        source->second.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms);
+        source->second.period = std::chrono::milliseconds(period_ms > 0 ? period_ms : 0);
+    }
+
+    /* The loop thread picks up the new deadline before it goes back to sleep. */
+    if (!IsLoopThread())
+        Wake();
+    return SCAPE_EOK;
+}
+
+int EventLoop::AddSignal(Handler handler, uint64_t &id)
+{
+    return Add(Source{SourceType::SIGNAL, std::make_shared<Handler>(std::move(handler)), -1, false,
+                      false, {}, {}},
+               id);
+}
+
+int EventLoop::Signal(uint64_t id)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto source = m_sources.find(id);
+        if (source == m_sources.end() || source->second.type != SourceType::SIGNAL)
+            return SCAPE_EINVAL;
+        if (source->second.is_ready)
+            return SCAPE_EOK;
+        source->second.is_ready = true;
+    }
+
+    if (!IsLoopThread())
+        Wake();
+    return SCAPE_EOK;
+}
+
+int EventLoop::Remove(uint64_t id)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto source = m_sources.find(id);
+    if (source == m_sources.end())
+        return SCAPE_EINVAL;
+
+#ifdef __linux__
+    if (source->second.type == SourceType::DESCRIPTOR)
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, source->second.fd, NULL);
+#endif
+    m_sources.erase(source);
+    m_ready.erase(id);
+
+    if (!IsLoopThread())
+        m_idle.wait(lock, [&]() { return m_running_id != id; });
+    return SCAPE_EOK;
+}
+
+bool EventLoop::IsLoopThread() const
+{
+    return std::this_thread::get_id() == m_thread.get_id();
+}
+
+void EventLoop::Wake()
+{
+#ifdef __linux__
+    if (m_eventfd >= 0)
+    {
+        const uint64_t one = 1;
+        [[maybe_unused]] const auto result = write(m_eventfd, &one, sizeof(one));
+        return;
+    }
+#endif
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_is_woken = true;
+    }
+    m_wakeup.notify_all();
+}
+
+void EventLoop::WaitForSources(std::unique_lock<std::mutex> &lock,
+                               std::chrono::steady_clock::time_point deadline, bool has_deadline)
+{
+#ifdef __linux__
+    if (m_epoll >= 0)
+    {
+        int timeout = -1;
+        if (has_deadline)
+        {
+            /* Round up so that we don't wake up just before the deadline. */
+            const auto remaining = deadline - std::chrono::steady_clock::now();
+            const auto ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+            timeout = static_cast<int>(std::max<decltype(ms)>(ms, 0));
+        }
+
+        static constexpr int MAX_EVENTS = 16;
+        struct epoll_event events[MAX_EVENTS];
+        lock.unlock();
+        const int nof_events = epoll_wait(m_epoll, events, MAX_EVENTS, timeout);
+        lock.lock();
+
+        for (int i = 0; i < nof_events; ++i)
+        {
+            if (events[i].data.u64 == 0)
+            {
+                uint64_t count;
+                [[maybe_unused]] const auto length = read(m_eventfd, &count, sizeof(count));
+            }
+            else if (m_sources.count(events[i].data.u64) > 0)
+            {
+                /* The source may have been removed while we were waiting. */
+                m_ready.insert(events[i].data.u64);
+            }
+        }
+        return;
+    }
+#endif
+
+    const auto IsWoken = [&]() { return m_is_woken; };
+    if (has_deadline)
+        m_wakeup.wait_until(lock, deadline, IsWoken);
+    else
+        m_wakeup.wait(lock, IsWoken);
+    m_is_woken = false;
+}
+
+void EventLoop::MainLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_should_stop)
+    {
+        /* Collect the signals and the expired timers, and find the nearest
+           deadline among the remaining timers. */
+        const auto now = std::chrono::steady_clock::now();
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        bool has_deadline = false;
+
+        for (auto &[id, source] : m_sources)
+        {
+            if (source.type == SourceType::SIGNAL && source.is_ready)
+            {
+                source.is_ready = false;
+                m_ready.insert(id);
+            }
+            else if (source.type == SourceType::TIMER && source.is_armed)
+            {
+                if (source.deadline <= now)
+                {
+                    m_ready.insert(id);
+                    if (source.period.count() > 0)
+                    {
+                        /* Skip the periods we've missed instead of catching up. */
+                        source.deadline += source.period;
+                        if (source.deadline <= now)
+                            source.deadline = now + source.period;
+                    }
+                    else
+                    {
+                        source.is_armed = false;
+                    }
+                }
+
+                if (source.is_armed && source.deadline < deadline)
+                {
+                    deadline = source.deadline;
+                    has_deadline = true;
+                }
+            }
+        }
+
+        if (m_ready.empty())
+        {
+            WaitForSources(lock, deadline, has_deadline);
+            continue;
+        }
+
+        /* Run the handlers one at a time. A handler may remove any source,
+           including one that's next in line, so we look each one up again. */
+        while (!m_ready.empty() && !m_should_stop)
+        {
+            const uint64_t id = *m_ready.begin();
+            m_ready.erase(m_ready.begin());
+
+            auto source = m_sources.find(id);
+            if (source == m_sources.end())
+                continue;
+
+            const auto handler = source->second.handler;
+            m_running_id = id;
+            lock.unlock();
+
+            try
+            {
+                (*handler)();
+            }
+            catch (const std::exception &e)
+            {
+                Log::log->error("Unhandled exception in an event loop handler: {}", e.what());
+            }
+
+            lock.lock();
+            m_running_id = 0;
+            m_idle.notify_all();
+        }
+    }
+}
+
+EventLoopSignal::EventLoopSignal(EventLoop &loop)
+    : m_loop(loop)
+    , m_id(0)
+{
+}
+
+EventLoopSignal::~EventLoopSignal()
+{
+    Disconnect();
+}
+
+int EventLoopSignal::Connect(EventLoop::Handler handler)
+{
+    if (m_id != 0)
+        return SCAPE_ENOTREADY;
+
+    uint64_t id = 0;
+    RETURN_CALL(m_loop.AddSignal(std::move(handler), id));
+    m_id = id;
+    return SCAPE_EOK;
+}
+
+int EventLoopSignal::Disconnect()
+{
+    const uint64_t id = m_id.exchange(0);
+    if (id == 0)
+        return SCAPE_ENOTREADY;
+    return m_loop.Remove(id);
+}
+
+void EventLoopSignal::Set()
+{
+    Event::Set();
+    const uint64_t id = m_id;
+    if (id != 0)
+        m_loop.Signal(id);
+}
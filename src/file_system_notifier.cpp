@@ -0,0 +1,226 @@
+#include "file_system_notifier.h"
+#include "error.h"
+#include "log.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileSystemNotifier::FileSystemNotifier(EventLoop &loop)
+    : m_loop(loop)
+    , m_inotify(-1)
+    , m_watch(-1)
+    , m_is_started(false)
+    , m_directory()
+    , m_poll_period_ms(0)
+    , m_callback()
+    , m_descriptor_id(0)
+    , m_debounce_id(0)
+    , m_poll_id(0)
+    , m_is_debouncing(false)
+    , m_debounce_deadline()
+    , m_names()
+{
+#ifdef __linux__
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0)
+        Log::log->warn("Failed to initialize inotify, falling back to polling.");
+#endif
+}
+
+FileSystemNotifier::~FileSystemNotifier()
+{
+    Stop();
+#ifdef __linux__
+    if (m_inotify >= 0)
+        close(m_inotify);
+#endif
+}
+
+int FileSystemNotifier::Start(const std::filesystem::path &directory, int poll_period_ms,
+                              Callback callback)
+{
+    if (m_is_started)
+        return SCAPE_ENOTREADY;
+
+    m_directory = directory;
+    m_poll_period_ms = poll_period_ms;
+    m_callback = std::move(callback);
+    m_is_debouncing = false;
+    m_names.clear();
+
+    RETURN_CALL(m_loop.AddTimer([this] { OnDebounce(); }, m_debounce_id));
+    RETURN_CALL(m_loop.AddTimer([this] { OnPoll(); }, m_poll_id));
+    m_is_started = true;
+
+    /* The watch is set up before the descriptor is added to the loop so that
+       the handler doesn't run while we're at it. Any events in between are
+       picked up once the descriptor is added. */
+    int result = Watch();
+#ifdef __linux__
+    if (m_inotify >= 0 &&
+        SCAPE_EOK != m_loop.AddDescriptor(m_inotify, [this] { OnReadable(); }, m_descriptor_id))
+    {
+        Log::log->warn("Failed to add inotify to the event loop, falling back to polling.");
+        close(m_inotify);
+        m_inotify = -1;
+        m_watch = -1;
+        m_descriptor_id = 0;
+        result = SCAPE_EUNSUPPORTED;
+    }
+#endif
+
+    /* The first poll runs right away, giving the owner its initial look at
+       the directory on the loop thread. We keep polling if there's no watch. */
+    if (SCAPE_EOK != result)
+        Log::log->trace("Polling '{}' for changes.", m_directory.string());
+    m_loop.SetTimer(m_poll_id, 0, SCAPE_EOK != result ? m_poll_period_ms : 0);
+
+    return SCAPE_EOK;
+}
+
+int FileSystemNotifier::Stop()
+{
+    if (!m_is_started)
+        return SCAPE_ENOTREADY;
+
+    if (m_descriptor_id != 0)
+        m_loop.Remove(m_descriptor_id);
+    m_loop.Remove(m_debounce_id);
+    m_loop.Remove(m_poll_id);
+    m_descriptor_id = 0;
+    m_debounce_id = 0;
+    m_poll_id = 0;
+
+#ifdef __linux__
+    if (m_watch >= 0)
+        inotify_rm_watch(m_inotify, m_watch);
+    m_watch = -1;
+
+    /* Drain any events left over so they don't show up after a restart. */
+    ReadEvents();
+#endif
+
+    m_names.clear();
+    m_is_started = false;
+    return SCAPE_EOK;
+}
+
+bool FileSystemNotifier::IsWatching() const
+{
+    return m_watch >= 0;
+}
+
+void FileSystemNotifier::OnReadable()
+{
+    ReadEvents();
+
+    /* Collect events until the directory goes quiet, but don't let a busy
+       directory postpone the callback indefinitely. */
+    const auto now = std::chrono::steady_clock::now();
+    if (!m_is_debouncing)
+    {
+        m_is_debouncing = true;
+        m_debounce_deadline = now + std::chrono::milliseconds(MAX_DEBOUNCE_MS);
+    }
+
+    const auto remaining =
+        std::chrono::duration_cast<std::chrono::milliseconds>(m_debounce_deadline - now).count();
+    m_loop.SetTimer(m_debounce_id, static_cast<int>(std::clamp<decltype(remaining)>(
+                                       remaining, 0, DEBOUNCE_MS)));
+}
+
+void FileSystemNotifier::OnDebounce()
+{
+    m_is_debouncing = false;
+    std::set<std::string> names{};
+    names.swap(m_names);
+
+    /* If the watch was lost, the directory may come back later. */
+    if (!IsWatching())
+        m_loop.SetTimer(m_poll_id, m_poll_period_ms, m_poll_period_ms);
+
+    m_callback(names);
+}
+
+void FileSystemNotifier::OnPoll()
+{
+    /* Keep trying to set up the watch, and stop polling once we succeed. The
+       callback still runs to pick up anything that happened before. */
+    if (!IsWatching() && SCAPE_EOK == Watch())
+        m_loop.SetTimer(m_poll_id, -1);
+
+    m_callback({});
+}
+
+#ifdef __linux__
+
+int FileSystemNotifier::Watch()
+{
+    if (m_inotify < 0)
+        return SCAPE_EUNSUPPORTED;
+
+    if (m_watch >= 0)
+    {
+        inotify_rm_watch(m_inotify, m_watch);
+        m_watch = -1;
+    }
+
+    /* IN_CLOSE_WRITE is left out on purpose: closing a file we've already seen
+       being modified is not a change. */
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM |
+                          IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+    m_watch = inotify_add_watch(m_inotify, m_directory.c_str(), mask);
+    if (m_watch < 0)
+        return SCAPE_EEXTERNAL;
+
+    return SCAPE_EOK;
+}
+
+void FileSystemNotifier::ReadEvents()
+{
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;)
+    {
+        const ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+        if (length <= 0)
+            return;
+
+        for (ssize_t i = 0; i < length;)
+        {
+            const auto event = reinterpret_cast<const struct inotify_event *>(buffer + i);
+            if ((event->mask & IN_MOVE_SELF) && event->wd == m_watch)
+            {
+                /* The path no longer refers to the directory we're watching. */
+                inotify_rm_watch(m_inotify, m_watch);
+                m_watch = -1;
+            }
+            else if ((event->mask & IN_IGNORED) && event->wd == m_watch)
+            {
+                m_watch = -1;
+            }
+            else if ((event->mask & (IN_CREATE | IN_MODIFY | IN_MOVED_TO)) && event->len > 0)
+            {
+                m_names.emplace(event->name);
+            }
+
+            i += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+#else
+
+int FileSystemNotifier::Watch()
+{
+    return SCAPE_EUNSUPPORTED;
+}
+
+void FileSystemNotifier::ReadEvents()
+{
+}
+
+#endif
@@ -6,9 +6,13 @@
 FileWatcher::FileWatcher(const std::filesystem::path &path)
     : m_path{path}
     , m_timestamp{}
+    , m_is_running{false}
     , m_is_watching{false}
     , m_ignore_next_update{false}
+    , m_notifier{}
+    , m_message_signal{std::make_shared<EventLoopSignal>()}
 {
+    _SetMessageEvent(m_message_signal);
 }
 
 FileWatcher::~FileWatcher()
@@ -21,76 +25,104 @@ const std::filesystem::path &FileWatcher::GetPath()
     return m_path;
 }
 
-void FileWatcher::MainLoop()
+int FileWatcher::Start()
 {
+    if (m_is_running)
+        return SCAPE_ENOTREADY;
+
     /* Avoid watching an empty path. */
     if (m_path.empty())
     {
         Log::log->error("The file watcher cannot watch an empty path.");
-        m_thread_exit_code = SCAPE_EINTERNAL;
-        return;
+        return SCAPE_EINTERNAL;
     }
 
     Log::log->trace("Starting file watcher for '{}'.", m_path.string());
-    m_thread_exit_code = SCAPE_EOK;
 
-    /* Before we enter the main loop, we check if the file exists. If it
-       doesn't, we emit the `FILE_DOES_NOT_EXIST` message. Message should only
-       be emitted once, which is why it sits outside the loop. */
+    /* If the file doesn't exist, we emit the `FILE_DOES_NOT_EXIST` message.
+       Message should only be emitted once, which is why it's not part of the
+       regular check. */
     if (!std::filesystem::exists(m_path))
         _EmplaceMessage(FileWatcherMessageId::FILE_DOES_NOT_EXIST);
 
-    for (;;)
+    /* We watch the parent directory since the file may not exist yet, or be
+       replaced by an editor saving through a temporary file. Both the checks
+       and the incoming messages are handled on the loop thread, so they never
+       run concurrently. Messages that arrived while we weren't running are
+       handled right away. */
+    const auto directory = m_path.has_parent_path() ? m_path.parent_path()
+                                                    : std::filesystem::path(".");
+    const auto filename = m_path.filename().string();
+    RETURN_CALL(m_notifier.Start(directory, POLL_PERIOD_MS, [this, filename](const auto &names) {
+        CheckFile(names.count(filename) > 0);
+    }));
+    int result = m_message_signal->Connect([this] { HandleMessages(); });
+    if (result != SCAPE_EOK)
+    {
+        m_notifier.Stop();
+        return result;
+    }
+    m_message_signal->Set();
+
+    m_is_running = true;
+    return SCAPE_EOK;
+}
+
+int FileWatcher::Stop()
+{
+    if (!m_is_running)
+        return SCAPE_ENOTREADY;
+
+    m_message_signal->Disconnect();
+    m_notifier.Stop();
+    m_is_running = false;
+
+    Log::log->trace("Stopping file watcher for '{}'.", m_path.string());
+    return SCAPE_EOK;
+}
+
+void FileWatcher::CheckFile(bool is_modified)
+{
+    if (std::filesystem::exists(m_path))
     {
-        if (std::filesystem::exists(m_path))
+        auto timestamp = std::filesystem::last_write_time(m_path);
+        if (!m_is_watching)
+        {
+            /* The file has been created, read the contents in full and emit a message. */
+            m_is_watching = true;
+            m_timestamp = timestamp;
+            std::string contents{};
+            ReadContents(contents);
+            _EmplaceMessage(FileWatcherMessageId::FILE_CREATED, std::move(contents));
+        }
+        else if (timestamp != m_timestamp || is_modified)
         {
-            auto timestamp = std::filesystem::last_write_time(m_path);
-            if (!m_is_watching)
+            /* The file has been changed, we only read the contents and emit
+               a message unless instructed to ignore the next update
+               (usually because this application is responsible for the
+               change so we don't have to synchronize again). A reported
+               modification counts even if the timestamp is too coarse to
+               tell the difference. */
+            m_timestamp = timestamp;
+            if (m_ignore_next_update)
             {
-                /* The file has been created, read the contents in full and emit a message. */
-                m_is_watching = true;
-                m_timestamp = timestamp;
-                std::string contents{};
-                ReadContents(contents);
-                _EmplaceMessage(FileWatcherMessageId::FILE_CREATED, std::move(contents));
+                m_ignore_next_update = false;
             }
-            else if (timestamp != m_timestamp)
+            else
             {
-                /* The file has been changed, we only read the contents and emit
-                   a message unless instructed to ignore the next update
-                   (usually because this application is responsible for the
-                   change so we don't have to synchronize again). */
-                m_timestamp = timestamp;
-                if (m_ignore_next_update)
-                {
-                    m_ignore_next_update = false;
-                }
-                else
-                {
-                    std::string contents{};
-                    ReadContents(contents);
-                    _EmplaceMessage(FileWatcherMessageId::FILE_UPDATED, std::move(contents));
-                }
+                std::string contents{};
+                ReadContents(contents);
+                _EmplaceMessage(FileWatcherMessageId::FILE_UPDATED, std::move(contents));
             }
         }
-        else if (m_is_watching)
-        {
-            /* File was erased, emit a message. */
-            m_is_watching = false;
-            m_timestamp = std::filesystem::file_time_type();
-            _EmplaceMessage(FileWatcherMessageId::FILE_DELETED);
-        }
-
-        /* Handle any incoming messages. */
-        HandleMessages();
-
-        /* We implement the sleep using the stop event to be able to immediately
-           react to the event being set. */
-        if (m_should_stop.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
-            break;
     }
-
-    Log::log->trace("Stopping file watcher for '{}'.", m_path.string());
+    else if (m_is_watching)
+    {
+        /* File was erased, emit a message. */
+        m_is_watching = false;
+        m_timestamp = std::filesystem::file_time_type();
+        _EmplaceMessage(FileWatcherMessageId::FILE_DELETED);
+    }
 }
 
 void FileWatcher::ReadContents(std::string &str)
@@ -115,7 +147,7 @@ void FileWatcher::HandleMessages()
 {
     /* Empty the inwards facing message queue. */
     FileWatcherMessage message;
-    while (SCAPE_EOK == _WaitForMessage(message, 250))
+    while (SCAPE_EOK == _WaitForMessage(message, 0))
     {
         switch (message.id)
         {
@@ -0,0 +1,639 @@
+#include "fourier_transform.h"
+#include "error.h"
+
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+
+/* Complex multiplication without the NaN/infinity recovery that the standard
+   library performs. That recovery path is a function call per product, which
+   is significant in the butterfly loops. */
+static inline std::complex<double> Multiply(const std::complex<double> &a,
+                                            const std::complex<double> &b)
+{
+    return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+/* Multiplication by -i. */
+static inline std::complex<double> MultiplyNegativeI(const std::complex<double> &a)
+{
+    return {a.imag(), -a.real()};
+}
+
+/* The small DFTs (butterflies) of the mixed-radix stages, evaluated in place. */
+template <size_t R>
+static inline void Butterfly(std::complex<double> *a);
+
+template <>
+inline void Butterfly<2>(std::complex<double> *a)
+{
+    const auto a0 = a[0];
+    a[0] = a0 + a[1];
+    a[1] = a0 - a[1];
+}
+
+template <>
+inline void Butterfly<3>(std::complex<double> *a)
+{
+    static const double S = std::sqrt(3.0) / 2.0;
+    const auto t1 = a[1] + a[2];
+    const auto t2 = S * (a[1] - a[2]);
+    const auto m = a[0] - 0.5 * t1;
+    a[0] = a[0] + t1;
+    a[1] = m + MultiplyNegativeI(t2);
+    a[2] = m - MultiplyNegativeI(t2);
+}
+
+template <>
+inline void Butterfly<4>(std::complex<double> *a)
+{
+    const auto t0 = a[0] + a[2];
+    const auto t1 = a[0] - a[2];
+    const auto t2 = a[1] + a[3];
+    const auto t3 = MultiplyNegativeI(a[1] - a[3]);
+    a[0] = t0 + t2;
+    a[1] = t1 + t3;
+    a[2] = t0 - t2;
+    a[3] = t1 - t3;
+}
+
+template <>
+inline void Butterfly<5>(std::complex<double> *a)
+{
+    static const double C1 = std::cos(2.0 * M_PI / 5.0);
+    static const double C2 = std::cos(4.0 * M_PI / 5.0);
+    static const double S1 = std::sin(2.0 * M_PI / 5.0);
+    static const double S2 = std::sin(4.0 * M_PI / 5.0);
+
+    const auto t1 = a[1] + a[4];
+    const auto t2 = a[2] + a[3];
+    const auto d1 = a[1] - a[4];
+    const auto d2 = a[2] - a[3];
+
+    const auto b1 = a[0] + C1 * t1 + C2 * t2;
+    const auto b2 = a[0] + C2 * t1 + C1 * t2;
+    const auto e1 = MultiplyNegativeI(S1 * d1 + S2 * d2);
+    const auto e2 = MultiplyNegativeI(S2 * d1 - S1 * d2);
+
+    a[0] = a[0] + t1 + t2;
+    a[1] = b1 + e1;
+    a[2] = b2 + e2;
+    a[3] = b2 - e2;
+    a[4] = b1 - e1;
+}
+
+/* One decimation-in-time stage, combining R transforms of length `m` into
+   transforms of length `m * R`. */
+template <size_t R>
+static void Stage(std::complex<double> *y, size_t length, size_t m,
+                  const std::complex<double> *twiddles)
+{
+    const size_t size = m * R;
+    const size_t stride = length / size;
+    for (size_t start = 0; start < length; start += size)
+    {
+        for (size_t j = 0; j < m; ++j)
+        {
+            std::complex<double> a[R];
+            a[0] = y[start + j];
+            for (size_t q = 1; q < R; ++q)
+                a[q] = Multiply(twiddles[stride * j * q], y[start + j + q * m]);
+
+            Butterfly<R>(a);
+
+            for (size_t k = 0; k < R; ++k)
+                y[start + j + k * m] = a[k];
+        }
+    }
+}
+
+ComplexFourierTransform::ComplexFourierTransform(size_t length, size_t nof_workers)
+    : m_length(length)
+    , m_nof_workers(nof_workers)
+    , m_scratch_size(0)
+    , m_parallel_scratch_size(0)
+    , m_radices{}
+    , m_twiddles{}
+    , m_permutation{}
+    , m_chirp{}
+    , m_kernel{}
+    , m_convolution{}
+    , m_columns{}
+    , m_rows{}
+{
+    if (IsFast(length))
+    {
+        /* Factorize the length, favoring radix-4 stages over radix-2 stages. */
+        size_t remainder = length;
+        size_t nof_twos = 0;
+        while (remainder % 2 == 0)
+        {
+            remainder /= 2;
+            ++nof_twos;
+        }
+
+        if (nof_twos % 2)
+            m_radices.push_back(2);
+        for (size_t i = 0; i < nof_twos / 2; ++i)
+            m_radices.push_back(4);
+        for (; remainder % 3 == 0; remainder /= 3)
+            m_radices.push_back(3);
+        for (; remainder % 5 == 0; remainder /= 5)
+            m_radices.push_back(5);
+
+        m_twiddles.resize(length);
+        for (size_t k = 0; k < length; ++k)
+        {
+            const double phase = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(length);
+            m_twiddles[k] = {std::cos(phase), std::sin(phase)};
+        }
+
+        /* The last stage combines the subsequences x[R n + q] (for each q),
+           each of which has been transformed in a contiguous block. Applying
+           that recursively yields the position of each input sample. */
+        m_permutation.resize(length);
+        for (size_t n = 0; n < length; ++n)
+        {
+            size_t position = 0;
+            size_t size = length;
+            size_t index = n;
+            for (auto radix = m_radices.rbegin(); radix != m_radices.rend(); ++radix)
+            {
+                size /= *radix;
+                position += (index % *radix) * size;
+                index /= *radix;
+            }
+            m_permutation[n] = static_cast<uint32_t>(position);
+        }
+
+        m_scratch_size = length;
+
+        /* For the four-step algorithm, we split the stages so that the length
+           of the column transforms is close to the square root of the length,
+           leaving at least one stage for the row transforms. */
+        if (nof_workers > 0 && m_radices.size() >= 2)
+        {
+            size_t nof_rows = 1;
+            for (const auto radix : m_radices)
+            {
+                if (nof_rows * nof_rows >= length || nof_rows * radix >= length)
+                    break;
+                nof_rows *= radix;
+            }
+
+            m_columns = std::make_unique<ComplexFourierTransform>(nof_rows);
+            m_rows = std::make_unique<ComplexFourierTransform>(length / nof_rows);
+            m_parallel_scratch_size =
+                length + nof_workers * BLOCK_SIZE * std::max(nof_rows, length / nof_rows);
+        }
+    }
+    else
+    {
+        size_t convolution_length = 1;
+        while (convolution_length < 2 * length - 1)
+            convolution_length *= 2;
+
+        m_convolution = std::make_unique<ComplexFourierTransform>(convolution_length, nof_workers);
+
+        /* We reduce n^2 modulo 2M before the conversion to keep the precision
+           of the phase for large n. */
+        m_chirp.resize(length);
+        for (size_t n = 0; n < length; ++n)
+        {
+            const auto n2 = static_cast<uint64_t>(n) * static_cast<uint64_t>(n) % (2 * length);
+            const double phase = -M_PI * static_cast<double>(n2) / static_cast<double>(length);
+            m_chirp[n] = {std::cos(phase), std::sin(phase)};
+        }
+
+        /* Construct the convolution kernel and transform it, folding in the
+           normalization of the inverse transform. */
+        m_kernel.resize(convolution_length);
+        m_kernel[0] = std::conj(m_chirp[0]);
+        for (size_t n = 1; n < length; ++n)
+        {
+            m_kernel[n] = std::conj(m_chirp[n]);
+            m_kernel[convolution_length - n] = std::conj(m_chirp[n]);
+        }
+
+        std::vector<std::complex<double>> scratch(m_convolution->ScratchSize());
+        m_convolution->Forward(m_kernel.data(), scratch.data());
+        for (auto &k : m_kernel)
+            k /= static_cast<double>(convolution_length);
+
+        m_scratch_size = 2 * convolution_length;
+        if (m_convolution->IsParallel())
+            m_parallel_scratch_size = convolution_length + m_convolution->ParallelScratchSize();
+    }
+}
+
+bool ComplexFourierTransform::IsFast(size_t length)
+{
+    if (length == 0)
+        return false;
+
+    for (const size_t factor : {2, 3, 5})
+    {
+        while (length % factor == 0)
+            length /= factor;
+    }
+
+    return length == 1;
+}
+
+size_t ComplexFourierTransform::NextFastLength(size_t length)
+{
+    /* The fast lengths are dense enough for a linear search to be sufficient. */
+    size_t result = std::max(length, static_cast<size_t>(1));
+    while (!IsFast(result))
+        ++result;
+    return result;
+}
+
+size_t ComplexFourierTransform::PreviousFastLength(size_t length)
+{
+    size_t result = std::max(length, static_cast<size_t>(1));
+    while (!IsFast(result))
+        --result;
+    return result;
+}
+
+void ComplexFourierTransform::Forward(std::complex<double> *y, std::complex<double> *scratch) const
+{
+    if (!IsPermutable())
+    {
+        Bluestein(y, scratch);
+        return;
+    }
+
+    std::copy(y, y + m_length, scratch);
+    for (size_t n = 0; n < m_length; ++n)
+        y[m_permutation[n]] = scratch[n];
+
+    ForwardPermuted(y);
+}
+
+void ComplexFourierTransform::ForwardPermuted(std::complex<double> *y) const
+{
+    size_t m = 1;
+    for (const auto radix : m_radices)
+    {
+        switch (radix)
+        {
+        case 2:
+            Stage<2>(y, m_length, m, m_twiddles.data());
+            break;
+        case 3:
+            Stage<3>(y, m_length, m, m_twiddles.data());
+            break;
+        case 4:
+            Stage<4>(y, m_length, m, m_twiddles.data());
+            break;
+        case 5:
+            Stage<5>(y, m_length, m, m_twiddles.data());
+            break;
+        default:
+            break;
+        }
+        m *= radix;
+    }
+}
+
+void ComplexFourierTransform::ForwardParallel(std::complex<double> *y,
+                                              std::complex<double> *scratch,
+                                              WorkerPool &pool) const
+{
+    if (IsPermutable())
+        FourStep(y, scratch, pool);
+    else
+        BluesteinParallel(y, scratch, pool);
+}
+
+void ComplexFourierTransform::FourStep(std::complex<double> *y, std::complex<double> *scratch,
+                                       WorkerPool &pool) const
+{
+    /* With n = M2 n1 + n2 and k = k1 + M1 k2, the transform is
+
+         X[k1 + M1 k2] = sum_n2 W^(n2 k2)_M2 W^(n2 k1)_M sum_n1 x[M2 n1 + n2] W^(n1 k1)_M1
+
+       where the inner sums are the transforms of the M2 columns of the input
+       viewed as an M1 x M2 matrix. The product n2 k1 never exceeds M - 1, so
+       we can use the twiddle factors of the full length directly. */
+    const size_t M1 = m_columns->Length();
+    const size_t M2 = m_rows->Length();
+    const auto &column_permutation = m_columns->Permutation();
+    const auto &row_permutation = m_rows->Permutation();
+
+    /* The matrix is traversed with a large stride, so we process a block of
+       adjacent columns (or rows) together to make use of every cache line we
+       touch. We split the work into one range per worker, each with its own
+       block of working memory following the matrix in `scratch`. The ranges
+       are disjoint, so the first index identifies the block. The workers then
+       claim the blocks of the matrix one at a time to even out the load. */
+    const size_t nof_workers = std::min(m_nof_workers, pool.GetConcurrency());
+    const auto working_memory = scratch + m_length;
+    const size_t working_memory_size = BLOCK_SIZE * std::max(M1, M2);
+
+    /* Transform the columns and apply the twiddle factors, writing the result
+       to `scratch` in the same layout as the input. */
+    const size_t nof_column_blocks = (M2 + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::atomic<size_t> next_column_block{0};
+    pool.ParallelFor(nof_workers, [&](size_t worker, size_t) {
+        const auto columns = working_memory + worker * working_memory_size;
+        for (size_t block = next_column_block++; block < nof_column_blocks;
+             block = next_column_block++)
+        {
+            const size_t n2_begin = block * BLOCK_SIZE;
+            const size_t size = std::min(BLOCK_SIZE, M2 - n2_begin);
+
+            for (size_t n1 = 0; n1 < M1; ++n1)
+            {
+                for (size_t b = 0; b < size; ++b)
+                    columns[b * M1 + column_permutation[n1]] = y[M2 * n1 + n2_begin + b];
+            }
+
+            for (size_t b = 0; b < size; ++b)
+                m_columns->ForwardPermuted(columns + b * M1);
+
+            for (size_t k1 = 0; k1 < M1; ++k1)
+            {
+                for (size_t b = 0; b < size; ++b)
+                {
+                    const size_t n2 = n2_begin + b;
+                    scratch[M2 * k1 + n2] = Multiply(m_twiddles[n2 * k1], columns[b * M1 + k1]);
+                }
+            }
+        }
+    });
+
+    /* Transform the rows, transposing the result into `y`. */
+    const size_t nof_row_blocks = (M1 + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::atomic<size_t> next_row_block{0};
+    pool.ParallelFor(nof_workers, [&](size_t worker, size_t) {
+        const auto rows = working_memory + worker * working_memory_size;
+        for (size_t block = next_row_block++; block < nof_row_blocks; block = next_row_block++)
+        {
+            const size_t k1_begin = block * BLOCK_SIZE;
+            const size_t size = std::min(BLOCK_SIZE, M1 - k1_begin);
+
+            for (size_t b = 0; b < size; ++b)
+            {
+                const auto row = scratch + M2 * (k1_begin + b);
+                for (size_t n2 = 0; n2 < M2; ++n2)
+                    rows[b * M2 + row_permutation[n2]] = row[n2];
+                m_rows->ForwardPermuted(rows + b * M2);
+            }
+
+            for (size_t k2 = 0; k2 < M2; ++k2)
+            {
+                for (size_t b = 0; b < size; ++b)
+                    y[k1_begin + b + M1 * k2] = rows[b * M2 + k2];
+            }
+        }
+    });
+}
+
+void ComplexFourierTransform::BluesteinParallel(std::complex<double> *y,
+                                                std::complex<double> *scratch,
+                                                WorkerPool &pool) const
+{
+    /* The same as `Bluestein()` but with the convolution evaluated by parallel
+       transforms, which expect their input in natural order. */
+    const size_t K = m_convolution->Length();
+    auto a = scratch;
+    auto b = scratch + K;
+
+    pool.ParallelFor(K, [&](size_t begin, size_t end) {
+        for (size_t n = begin; n < end; ++n)
+            a[n] = n < m_length ? Multiply(y[n], m_chirp[n]) : std::complex<double>{};
+    });
+
+    m_convolution->ForwardParallel(a, b, pool);
+
+    pool.ParallelFor(K, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k)
+            a[k] = std::conj(Multiply(a[k], m_kernel[k]));
+    });
+
+    m_convolution->ForwardParallel(a, b, pool);
+
+    pool.ParallelFor(m_length, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k)
+            y[k] = Multiply(std::conj(a[k]), m_chirp[k]);
+    });
+}
+
+void ComplexFourierTransform::Bluestein(std::complex<double> *y, std::complex<double> *scratch) const
+{
+    /* With the chirp w[n] = exp(-i pi n^2 / M), the transform is
+
+         X[k] = w[k] sum_n (x[n] w[n]) w*[k - n]
+
+       i.e. a convolution that we evaluate with transforms of a length K that
+       is a power of two. The inverse transform is computed as the conjugate of
+       the forward transform of the conjugated sequence. */
+    const size_t K = m_convolution->Length();
+    const auto &permutation = m_convolution->Permutation();
+    auto a = scratch;
+    auto c = scratch + K;
+
+    std::fill(a, a + K, std::complex<double>{});
+    for (size_t n = 0; n < m_length; ++n)
+        a[permutation[n]] = Multiply(y[n], m_chirp[n]);
+
+    m_convolution->ForwardPermuted(a);
+
+    for (size_t k = 0; k < K; ++k)
+        c[permutation[k]] = std::conj(Multiply(a[k], m_kernel[k]));
+
+    m_convolution->ForwardPermuted(c);
+
+    for (size_t k = 0; k < m_length; ++k)
+        y[k] = Multiply(std::conj(c[k]), m_chirp[k]);
+}
+
+FourierTransformPlan::FourierTransformPlan(size_t length, std::shared_ptr<WorkerPool> pool)
+    : m_length(length)
+    , m_pool(pool)
+    , m_transform((length % 2 == 0) ? length / 2 : length,
+                  pool != NULL ? pool->GetConcurrency() : 0)
+    , m_twiddles{}
+    , m_scratch{}
+{
+    /* Some (short) lengths cannot be split. */
+    if (!m_transform.IsParallel())
+        m_pool = NULL;
+
+    if (m_length % 2 == 0)
+    {
+        m_twiddles.resize(m_length / 4 + 1);
+        for (size_t k = 0; k < m_twiddles.size(); ++k)
+        {
+            const double phase = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(m_length);
+            m_twiddles[k] = {std::cos(phase), std::sin(phase)};
+        }
+
+        /* The packed sequence is loaded directly into the output buffer and
+           only Bluestein's algorithm requires additional memory. */
+        if (m_pool != NULL)
+            m_scratch.resize(m_transform.ParallelScratchSize());
+        else if (!m_transform.IsPermutable())
+            m_scratch.resize(m_transform.ScratchSize());
+    }
+    else if (m_pool != NULL)
+    {
+        m_scratch.resize(m_length + m_transform.ParallelScratchSize());
+    }
+    else
+    {
+        m_scratch.resize(m_length + m_transform.ScratchSize());
+    }
+}
+
+bool FourierTransformPlan::IsSupported(size_t length)
+{
+    /* At least two samples and with room for the 32-bit permutation tables. */
+    return length >= 2 && length <= (static_cast<size_t>(1) << 31);
+}
+
+void FourierTransformPlan::Forward(const double *x, std::complex<double> *y)
+{
+    if (m_length % 2 != 0)
+    {
+        /* Odd lengths are transformed as a complex sequence, keeping the
+           nonredundant half of the result. */
+        auto z = m_scratch.data();
+        if (m_pool != NULL)
+        {
+            For(m_length, [&](size_t begin, size_t end) {
+                for (size_t n = begin; n < end; ++n)
+                    z[n] = {x[n], 0.0};
+            });
+            m_transform.ForwardParallel(z, m_scratch.data() + m_length, *m_pool);
+        }
+        else if (m_transform.IsPermutable())
+        {
+            const auto &permutation = m_transform.Permutation();
+            for (size_t n = 0; n < m_length; ++n)
+                z[permutation[n]] = {x[n], 0.0};
+            m_transform.ForwardPermuted(z);
+        }
+        else
+        {
+            for (size_t n = 0; n < m_length; ++n)
+                z[n] = {x[n], 0.0};
+            m_transform.Forward(z, m_scratch.data() + m_length);
+        }
+
+        std::copy(z, z + Bins(), y);
+        return;
+    }
+
+    const size_t M = m_length / 2;
+
+    /* Pack the real sequence into a complex sequence of half the length,
+       applying the permutation as we go if possible. */
+    if (m_pool != NULL)
+    {
+        For(M, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                y[i] = {x[2 * i], x[2 * i + 1]};
+        });
+        m_transform.ForwardParallel(y, m_scratch.data(), *m_pool);
+    }
+    else if (m_transform.IsPermutable())
+    {
+        const auto &permutation = m_transform.Permutation();
+        for (size_t i = 0; i < M; ++i)
+            y[permutation[i]] = {x[2 * i], x[2 * i + 1]};
+        m_transform.ForwardPermuted(y);
+    }
+    else
+    {
+        for (size_t i = 0; i < M; ++i)
+            y[i] = {x[2 * i], x[2 * i + 1]};
+        m_transform.Forward(y, m_scratch.data());
+    }
+
+    /* Split the transform of the packed sequence Z into the transform X of
+       the real sequence. With E[k] = (Z[k] + Z*[M - k]) / 2 being the
+       transform of the even samples and O[k] = -i (Z[k] - Z*[M - k]) / 2 being
+       the transform of the odd samples, we have
+
+         X[k] = E[k] + W^k O[k], and
+         X[M - k] = (E[k] - W^k O[k])*
+
+       which lets us process the bins pairwise and in place. */
+    const auto z0 = y[0];
+    y[0] = {z0.real() + z0.imag(), 0.0};
+    y[M] = {z0.real() - z0.imag(), 0.0};
+
+    For(M / 2, [&](size_t begin, size_t end) {
+        for (size_t k = begin + 1; k <= end; ++k)
+        {
+            const auto zk = y[k];
+            const auto zm = std::conj(y[M - k]);
+            const auto even = 0.5 * (zk + zm);
+            const auto odd = 0.5 * MultiplyNegativeI(zk - zm);
+            const auto product = Multiply(m_twiddles[k], odd);
+
+            y[k] = even + product;
+            y[M - k] = std::conj(even - product);
+        }
+    });
+}
+
+int FourierTransformPlan::Forward(const std::vector<double> &x,
+                                  std::vector<std::complex<double>> &y)
+{
+    if (x.size() < m_length || y.size() < Bins())
+        return SCAPE_EINVAL;
+
+    Forward(x.data(), y.data());
+    return SCAPE_EOK;
+}
+
+void FourierTransformPlan::For(size_t count, const std::function<void(size_t, size_t)> &function)
+{
+    if (m_pool != NULL)
+        m_pool->ParallelFor(count, function);
+    else
+        function(0, count);
+}
+
+FourierTransformCache::FourierTransformCache()
+    : m_plan{}
+    , m_pool{}
+    , m_parallel_threshold(0)
+{}
+
+std::shared_ptr<FourierTransformPlan> FourierTransformCache::GetPlan(size_t length)
+{
+    /* Like the window cache, we expect a hit almost every time. */
+    if (m_plan != NULL && m_plan->Length() == length)
+        return m_plan;
+
+    if (!FourierTransformPlan::IsSupported(length))
+        return NULL;
+
+    /* Let go of the previous plan before creating the next one. */
+    m_plan.reset();
+    const bool parallel = m_pool != NULL && m_parallel_threshold > 0 &&
+                          length >= m_parallel_threshold;
+    m_plan = std::make_shared<FourierTransformPlan>(length, parallel ? m_pool : NULL);
+    return m_plan;
+}
+
+void FourierTransformCache::SetParallel(std::shared_ptr<WorkerPool> pool, size_t threshold)
+{
+    if (pool == m_pool && threshold == m_parallel_threshold)
+        return;
+
+    m_pool = pool;
+    m_parallel_threshold = threshold;
+    Clear();
+}
+
+void FourierTransformCache::Clear()
+{
+    m_plan.reset();
+}
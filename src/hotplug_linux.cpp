@@ -12,8 +12,13 @@ public:
 };
 
 HotplugLinux::HotplugLinux()
-    : m_handle(NULL)
+    : m_loop(EventLoop::Shared())
+    , m_handle(NULL)
+    , m_monitor(NULL)
     , m_nof_devices(0)
+    , m_is_running(false)
+    , m_monitor_id(0)
+    , m_check_id(0)
 {}
 
 HotplugLinux::~HotplugLinux()
@@ -78,44 +83,98 @@ int HotplugLinux::CreateHandle()
     return SCAPE_EOK;
 }
 
+int HotplugLinux::CreateMonitor()
+{
+    m_monitor = udev_monitor_new_from_netlink(m_handle, "udev");
+    if (m_monitor == NULL)
+        return SCAPE_EEXTERNAL;
+
+    if (udev_monitor_filter_add_match_subsystem_devtype(m_monitor, "pci", NULL) < 0 ||
+        udev_monitor_enable_receiving(m_monitor) < 0)
+    {
+        return SCAPE_EEXTERNAL;
+    }
+
+    return m_loop.AddDescriptor(udev_monitor_get_fd(m_monitor), [this] { ReceiveEvents(); },
+                                m_monitor_id);
+}
+
 void HotplugLinux::DestroyHandle()
 {
+    if (m_monitor != NULL)
+        udev_monitor_unref(m_monitor);
+    m_monitor = NULL;
+
     if (m_handle != NULL)
         udev_unref(m_handle);
     m_handle = NULL;
 }
 
-void HotplugLinux::MainLoop()
+void HotplugLinux::ReceiveEvents()
 {
-    m_thread_exit_code = CreateHandle();
-    if (m_thread_exit_code != SCAPE_EOK)
+    /* The monitor is nonblocking. Drain it and count the devices once, since
+       a device typically shows up as a burst of events. */
+    struct udev_device *device;
+    while ((device = udev_monitor_receive_device(m_monitor)) != NULL)
+        udev_device_unref(device);
+
+    CheckForEvents();
+}
+
+int HotplugLinux::Start()
+{
+    if (m_is_running)
+        return SCAPE_ENOTREADY;
+
+    int result = CreateHandle();
+    if (result != SCAPE_EOK)
     {
         DestroyHandle();
-        return;
+        return result;
     }
 
     Log::log->info("Starting Linux hotplug event detector.");
 
-    for (;;)
+    /* The initial check runs on the loop as well, so every call to
+       `CheckForEvents` happens on the same thread. Without a monitor, the
+       check is repeated periodically instead. */
+    result = m_loop.AddTimer([this] { CheckForEvents(); }, m_check_id);
+    if (result != SCAPE_EOK)
     {
-        /* Check for any hotplug events. */
-        CheckForEvents();
+        DestroyHandle();
+        return result;
+    }
 
-        /* We implement the sleep using the stop event to be able to immediately
-           react to the event being set. */
-        if (m_should_stop.wait_for(std::chrono::milliseconds(1000)) == std::future_status::ready)
-            break;
+    if (SCAPE_EOK != CreateMonitor())
+    {
+        Log::log->warn("Failed to set up the udev monitor, polling for hotplug events.");
+        m_loop.SetTimer(m_check_id, 0, POLL_PERIOD_MS);
+    }
+    else
+    {
+        m_loop.SetTimer(m_check_id, 0);
     }
 
-    Log::log->trace("Stopping Linux hotplug event detector.");
+    m_is_running = true;
+    return SCAPE_EOK;
 }
 
 int HotplugLinux::Stop()
 {
-    /* We manually stop the thread (calling the base class `Stop()`) before
-       destroying the udev objects. Otherwise, the thread may be using them
-       while they are being destroyed. */
-    int result = Hotplug::Stop();
+    if (!m_is_running)
+        return SCAPE_ENOTREADY;
+
+    /* Remove the handlers from the loop before destroying the udev objects.
+       Otherwise, a handler may be using them while they are being destroyed. */
+    if (m_monitor_id != 0)
+        m_loop.Remove(m_monitor_id);
+    m_loop.Remove(m_check_id);
+    m_monitor_id = 0;
+    m_check_id = 0;
+
     DestroyHandle();
-    return result;
+    m_is_running = false;
+
+    Log::log->trace("Stopping Linux hotplug event detector.");
+    return SCAPE_EOK;
 }
@@ -5,6 +5,7 @@
 #include "fmt/format.h"
 #include "format.h"
 
+#include <algorithm>
 #include <cmath>
 
 void ImGui::RenderTableContents(const std::vector<std::vector<TableCell>> &rows)
@@ -24,14 +25,15 @@ void ImGui::RenderTableContents(const std::vector<std::vector<TableCell>> &rows)
 
 ImGui::InputDoubleMetric::InputDoubleMetric(const std::string &label, double value,
                                             const std::string &format, double highest_prefix,
-                                            ImGuiInputTextFlags flags)
-    : value(value)
+                                            ImGuiInputTextFlags flags, double minimum)
+    : value(std::max(value, minimum))
     , first(true)
     , str(Format::Metric(value, format, highest_prefix))
     , label(label)
     , format(format)
     , highest_prefix(highest_prefix)
     , flags(flags | DEFAULT_FLAGS)
+    , minimum(minimum)
 {}
 
 bool ImGui::InputDoubleMetric::Changed()
@@ -58,6 +60,8 @@ bool ImGui::InputDoubleMetric::Changed()
         if (std::isnan(value) || std::isinf(value))
             return false;
 
+        value = std::max(value, minimum);
+
         str = Format::Metric(value, format, highest_prefix);
         str.reserve(64);
 
@@ -0,0 +1,776 @@
+#include "sample_conversion.h"
+
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SAMPLE_CONVERSION_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+/* GCC and Clang require the instruction set to be enabled per function to emit
+   the corresponding intrinsics without enabling them for the entire
+   translation unit. MSVC always allows the intrinsics. */
+#if defined(SAMPLE_CONVERSION_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+/* The kernels share the signature below and are specialized for the data type
+   `T`, the trace type `U`, the presence of a trace (`TRACE`) and a window
+   (`WINDOW`) and the vertical conversion mode (`CONVERT`). The first
+   `nof_fft_samples` samples produce both outputs and the remaining samples
+   only produce the time domain trace. Every sample contributes to the
+   statistics of the codes. The arithmetic is always carried out in double
+   precision. */
+struct KernelParameters
+{
+    double trace_scale;
+    double trace_offset;
+    double unit_scale;
+    double reference;
+    double code_low;
+    double code_high;
+};
+
+static inline void Accumulate(double value, const KernelParameters &p, SampleStatistics &s)
+{
+    const double difference = value - p.reference;
+    s.min = std::min(s.min, value);
+    s.max = std::max(s.max, value);
+    s.sum += difference;
+    s.sum_of_squares += difference * difference;
+    s.nof_clipped_low += (value <= p.code_low) ? 1 : 0;
+    s.nof_clipped_high += (value >= p.code_high) ? 1 : 0;
+}
+
+template <typename T, typename U, bool TRACE, bool WINDOW, bool CONVERT>
+static void ConvertScalar(const T *data, size_t begin, size_t count, U *y, double *fft,
+                          size_t nof_fft_samples, const double *window,
+                          const KernelParameters &p, SampleStatistics &s)
+{
+    size_t i = begin;
+    for (; i < nof_fft_samples; ++i)
+    {
+        const double value = static_cast<double>(data[i]);
+        if (TRACE)
+            y[i] = static_cast<U>(CONVERT ? value * p.trace_scale + p.trace_offset : value);
+        fft[i] = WINDOW ? value * p.unit_scale * window[i] : value * p.unit_scale;
+        Accumulate(value, p, s);
+    }
+
+    for (; i < count; ++i)
+    {
+        const double value = static_cast<double>(data[i]);
+        if (TRACE)
+            y[i] = static_cast<U>(CONVERT ? value * p.trace_scale + p.trace_offset : value);
+        Accumulate(value, p, s);
+    }
+}
+
+template <typename T, typename U, bool TRACE, bool WINDOW, bool CONVERT>
+static void ConvertScalar(const T *data, size_t count, U *y, double *fft, size_t nof_fft_samples,
+                          const double *window, const KernelParameters &p, SampleStatistics &s)
+{
+    ConvertScalar<T, U, TRACE, WINDOW, CONVERT>(data, 0, count, y, fft, nof_fft_samples, window,
+                                                p, s);
+}
+
+/* The decibel kernels evaluate the natural logarithm without library calls.
+   The exponent is extracted from the bit pattern (without any integer to
+   floating point conversion) and the logarithm of the mantissa m, scaled to
+   [1/sqrt(2), sqrt(2)], is evaluated from the series
+
+     ln(m) = 2 * atanh(s) = 2 * (s + s^3 / 3 + s^5 / 5 + ...), s = (m - 1) / (m + 1)
+
+   where |s| < 0.172. Truncating after s^17 leaves an error below 1e-14. Values
+   that aren't positive, normal and finite are rare and are passed on to the
+   library function instead. The SIMD kernels perform the exact same sequence
+   of operations. */
+static constexpr double DECIBELS_PER_NEPER = 10.0 / M_LN10;
+static constexpr uint64_t MANTISSA_MASK = 0x000FFFFFFFFFFFFF;
+static constexpr uint64_t ONE_BITS = 0x3FF0000000000000;
+static constexpr uint64_t TWO_TO_52_BITS = 0x4330000000000000;
+static constexpr double EXPONENT_BIAS = 4503599627370496.0 + 1023.0;
+
+static inline double NaturalLogarithm(double x)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+
+    /* Placing the exponent in the mantissa of 2^52 and subtracting 2^52 along
+       with the bias yields the unbiased exponent. */
+    const uint64_t exponent_bits = (bits >> 52) | TWO_TO_52_BITS;
+    double exponent;
+    std::memcpy(&exponent, &exponent_bits, sizeof(exponent));
+    exponent -= EXPONENT_BIAS;
+
+    const uint64_t mantissa_bits = (bits & MANTISSA_MASK) | ONE_BITS;
+    double m;
+    std::memcpy(&m, &mantissa_bits, sizeof(m));
+
+    if (m > M_SQRT2)
+    {
+        m *= 0.5;
+        exponent += 1.0;
+    }
+
+    const double s = (m - 1.0) / (m + 1.0);
+    const double z = s * s;
+    double series = 1.0 / 17;
+    series = series * z + 1.0 / 15;
+    series = series * z + 1.0 / 13;
+    series = series * z + 1.0 / 11;
+    series = series * z + 1.0 / 9;
+    series = series * z + 1.0 / 7;
+    series = series * z + 1.0 / 5;
+    series = series * z + 1.0 / 3;
+    series = series * z + 1.0;
+    return exponent * M_LN2 + (2.0 * s) * series;
+}
+
+template <typename U>
+static void DecibelsScalar(const double *power, size_t begin, size_t count, double offset, U *y)
+{
+    for (size_t i = begin; i < count; ++i)
+    {
+        const double x = power[i];
+        if (x >= DBL_MIN && x <= DBL_MAX)
+            y[i] = static_cast<U>(DECIBELS_PER_NEPER * NaturalLogarithm(x) + offset);
+        else
+            y[i] = static_cast<U>(10.0 * std::log10(x) + offset);
+    }
+}
+
+#if defined(SAMPLE_CONVERSION_X86)
+
+/* Load two codes, converted to double precision. */
+TARGET_SSE41 static inline __m128d Load2(const int16_t *data)
+{
+    int32_t packed;
+    std::memcpy(&packed, data, sizeof(packed));
+    return _mm_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_cvtsi32_si128(packed)));
+}
+
+TARGET_SSE41 static inline __m128d Load2(const int32_t *data)
+{
+    return _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(data)));
+}
+
+/* Store two values to the trace. */
+TARGET_SSE41 static inline void Store2(double *y, __m128d value)
+{
+    _mm_storeu_pd(y, value);
+}
+
+TARGET_SSE41 static inline void Store2(float *y, __m128d value)
+{
+    _mm_storel_pi(reinterpret_cast<__m64 *>(y), _mm_cvtpd_ps(value));
+}
+
+/* The statistics are accumulated per lane and combined once the vectorized
+   part of the conversion is complete. The clipped codes are counted as 1.0 per
+   lane, which is exact for any realistic record length. */
+struct Statistics2
+{
+    __m128d min;
+    __m128d max;
+    __m128d sum;
+    __m128d sum_of_squares;
+    __m128d nof_clipped_low;
+    __m128d nof_clipped_high;
+};
+
+TARGET_SSE41 static inline void Initialize(Statistics2 &a, const SampleStatistics &s)
+{
+    a.min = _mm_set1_pd(s.min);
+    a.max = _mm_set1_pd(s.max);
+    a.sum = _mm_setzero_pd();
+    a.sum_of_squares = _mm_setzero_pd();
+    a.nof_clipped_low = _mm_setzero_pd();
+    a.nof_clipped_high = _mm_setzero_pd();
+}
+
+TARGET_SSE41 static inline void Accumulate2(Statistics2 &a, __m128d value,
+                                            const KernelParameters &p)
+{
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d difference = _mm_sub_pd(value, _mm_set1_pd(p.reference));
+    a.min = _mm_min_pd(a.min, value);
+    a.max = _mm_max_pd(a.max, value);
+    a.sum = _mm_add_pd(a.sum, difference);
+    a.sum_of_squares = _mm_add_pd(a.sum_of_squares, _mm_mul_pd(difference, difference));
+    a.nof_clipped_low = _mm_add_pd(
+        a.nof_clipped_low, _mm_and_pd(_mm_cmple_pd(value, _mm_set1_pd(p.code_low)), one));
+    a.nof_clipped_high = _mm_add_pd(
+        a.nof_clipped_high, _mm_and_pd(_mm_cmpge_pd(value, _mm_set1_pd(p.code_high)), one));
+}
+
+TARGET_SSE41 static inline void Reduce(const Statistics2 &a, SampleStatistics &s)
+{
+    double lanes[6][2];
+    _mm_storeu_pd(lanes[0], a.min);
+    _mm_storeu_pd(lanes[1], a.max);
+    _mm_storeu_pd(lanes[2], a.sum);
+    _mm_storeu_pd(lanes[3], a.sum_of_squares);
+    _mm_storeu_pd(lanes[4], a.nof_clipped_low);
+    _mm_storeu_pd(lanes[5], a.nof_clipped_high);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        s.min = std::min(s.min, lanes[0][i]);
+        s.max = std::max(s.max, lanes[1][i]);
+        s.sum += lanes[2][i];
+        s.sum_of_squares += lanes[3][i];
+        s.nof_clipped_low += static_cast<size_t>(lanes[4][i]);
+        s.nof_clipped_high += static_cast<size_t>(lanes[5][i]);
+    }
+}
+
+template <typename T, typename U, bool TRACE, bool WINDOW, bool CONVERT>
+TARGET_SSE41 static void ConvertSse41(const T *data, size_t count, U *y, double *fft,
+                                      size_t nof_fft_samples, const double *window,
+                                      const KernelParameters &p, SampleStatistics &s)
+{
+    const __m128d trace_scale = _mm_set1_pd(p.trace_scale);
+    const __m128d trace_offset = _mm_set1_pd(p.trace_offset);
+    const __m128d unit_scale = _mm_set1_pd(p.unit_scale);
+
+    Statistics2 statistics;
+    Initialize(statistics, s);
+
+    size_t i = 0;
+    for (; i + 2 <= nof_fft_samples; i += 2)
+    {
+        const __m128d value = Load2(data + i);
+        if (TRACE && CONVERT)
+            Store2(y + i, _mm_add_pd(_mm_mul_pd(value, trace_scale), trace_offset));
+        else if (TRACE)
+            Store2(y + i, value);
+
+        __m128d unit = _mm_mul_pd(value, unit_scale);
+        if (WINDOW)
+            unit = _mm_mul_pd(unit, _mm_loadu_pd(window + i));
+        _mm_storeu_pd(fft + i, unit);
+        Accumulate2(statistics, value, p);
+    }
+
+    /* Handle an odd transform length before continuing with the trace. */
+    if (i < nof_fft_samples)
+    {
+        ConvertScalar<T, U, TRACE, WINDOW, CONVERT>(data, i, nof_fft_samples, y, fft,
+                                                    nof_fft_samples, window, p, s);
+        i = nof_fft_samples;
+    }
+
+    for (; i + 2 <= count; i += 2)
+    {
+        const __m128d value = Load2(data + i);
+        if (TRACE && CONVERT)
+            Store2(y + i, _mm_add_pd(_mm_mul_pd(value, trace_scale), trace_offset));
+        else if (TRACE)
+            Store2(y + i, value);
+        Accumulate2(statistics, value, p);
+    }
+
+    Reduce(statistics, s);
+    ConvertScalar<T, U, TRACE, WINDOW, CONVERT>(data, i, count, y, fft, nof_fft_samples, window,
+                                                p, s);
+}
+
+template <typename U>
+TARGET_SSE41 static void DecibelsSse41(const double *power, size_t count, double offset, U *y)
+{
+    const __m128i mantissa_mask = _mm_set1_epi64x(static_cast<int64_t>(MANTISSA_MASK));
+    const __m128i one_bits = _mm_set1_epi64x(static_cast<int64_t>(ONE_BITS));
+    const __m128i two_to_52_bits = _mm_set1_epi64x(static_cast<int64_t>(TWO_TO_52_BITS));
+    const __m128d exponent_bias = _mm_set1_pd(EXPONENT_BIAS);
+    const __m128d lowest = _mm_set1_pd(DBL_MIN);
+    const __m128d highest = _mm_set1_pd(DBL_MAX);
+    const __m128d sqrt2 = _mm_set1_pd(M_SQRT2);
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d two = _mm_set1_pd(2.0);
+    const __m128d ln2 = _mm_set1_pd(M_LN2);
+    const __m128d decibels_per_neper = _mm_set1_pd(DECIBELS_PER_NEPER);
+    const __m128d offset_ = _mm_set1_pd(offset);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        const __m128d x = _mm_loadu_pd(power + i);
+        const __m128i bits = _mm_castpd_si128(x);
+
+        __m128d exponent = _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), two_to_52_bits));
+        exponent = _mm_sub_pd(exponent, exponent_bias);
+        __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, mantissa_mask), one_bits));
+
+        const __m128d upper = _mm_cmpgt_pd(m, sqrt2);
+        m = _mm_blendv_pd(m, _mm_mul_pd(m, half), upper);
+        exponent = _mm_add_pd(exponent, _mm_and_pd(upper, one));
+
+        const __m128d s = _mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one));
+        const __m128d z = _mm_mul_pd(s, s);
+        __m128d series = _mm_set1_pd(1.0 / 17);
+        series = _mm_add_pd(_mm_mul_pd(series, z), _mm_set1_pd(1.0 / 15));
+        series = _mm_add_pd(_mm_mul_pd(series, z), _mm_set1_pd(1.0 / 13));
+        series = _mm_add_pd(_mm_mul_pd(series, z), _mm_set1_pd(1.0 / 11));
+        series = _mm_add_pd(_mm_mul_pd(series, z), _mm_set1_pd(1.0 / 9));
+        series = _mm_add_pd(_mm_mul_pd(series, z), _mm_set1_pd(1.0 / 7));
+        series = _mm_add_pd(_mm_mul_pd(series, z), _mm_set1_pd(1.0 / 5));
+        series = _mm_add_pd(_mm_mul_pd(series, z), _mm_set1_pd(1.0 / 3));
+        series = _mm_add_pd(_mm_mul_pd(series, z), one);
+
+        const __m128d logarithm = _mm_add_pd(_mm_mul_pd(exponent, ln2),
+                                             _mm_mul_pd(_mm_mul_pd(two, s), series));
+        Store2(y + i, _mm_add_pd(_mm_mul_pd(decibels_per_neper, logarithm), offset_));
+
+        const __m128d valid = _mm_and_pd(_mm_cmpge_pd(x, lowest), _mm_cmple_pd(x, highest));
+        if (_mm_movemask_pd(valid) != 0x3)
+            DecibelsScalar(power, i, i + 2, offset, y);
+    }
+
+    DecibelsScalar(power, i, count, offset, y);
+}
+
+/* Load four codes, converted to double precision. */
+TARGET_AVX2 static inline __m256d Load4(const int16_t *data)
+{
+    return _mm256_cvtepi32_pd(
+        _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(data))));
+}
+
+TARGET_AVX2 static inline __m256d Load4(const int32_t *data)
+{
+    return _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data)));
+}
+
+/* Store four values to the trace. */
+TARGET_AVX2 static inline void Store4(double *y, __m256d value)
+{
+    _mm256_storeu_pd(y, value);
+}
+
+TARGET_AVX2 static inline void Store4(float *y, __m256d value)
+{
+    _mm_storeu_ps(y, _mm256_cvtpd_ps(value));
+}
+
+struct Statistics4
+{
+    __m256d min;
+    __m256d max;
+    __m256d sum;
+    __m256d sum_of_squares;
+    __m256d nof_clipped_low;
+    __m256d nof_clipped_high;
+};
+
+TARGET_AVX2 static inline void Initialize(Statistics4 &a, const SampleStatistics &s)
+{
+    a.min = _mm256_set1_pd(s.min);
+    a.max = _mm256_set1_pd(s.max);
+    a.sum = _mm256_setzero_pd();
+    a.sum_of_squares = _mm256_setzero_pd();
+    a.nof_clipped_low = _mm256_setzero_pd();
+    a.nof_clipped_high = _mm256_setzero_pd();
+}
+
+TARGET_AVX2 static inline void Accumulate4(Statistics4 &a, __m256d value,
+                                           const KernelParameters &p)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d difference = _mm256_sub_pd(value, _mm256_set1_pd(p.reference));
+    a.min = _mm256_min_pd(a.min, value);
+    a.max = _mm256_max_pd(a.max, value);
+    a.sum = _mm256_add_pd(a.sum, difference);
+    a.sum_of_squares = _mm256_add_pd(a.sum_of_squares, _mm256_mul_pd(difference, difference));
+    a.nof_clipped_low = _mm256_add_pd(
+        a.nof_clipped_low,
+        _mm256_and_pd(_mm256_cmp_pd(value, _mm256_set1_pd(p.code_low), _CMP_LE_OQ), one));
+    a.nof_clipped_high = _mm256_add_pd(
+        a.nof_clipped_high,
+        _mm256_and_pd(_mm256_cmp_pd(value, _mm256_set1_pd(p.code_high), _CMP_GE_OQ), one));
+}
+
+TARGET_AVX2 static inline void Reduce(const Statistics4 &a, SampleStatistics &s)
+{
+    double lanes[6][4];
+    _mm256_storeu_pd(lanes[0], a.min);
+    _mm256_storeu_pd(lanes[1], a.max);
+    _mm256_storeu_pd(lanes[2], a.sum);
+    _mm256_storeu_pd(lanes[3], a.sum_of_squares);
+    _mm256_storeu_pd(lanes[4], a.nof_clipped_low);
+    _mm256_storeu_pd(lanes[5], a.nof_clipped_high);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        s.min = std::min(s.min, lanes[0][i]);
+        s.max = std::max(s.max, lanes[1][i]);
+        s.sum += lanes[2][i];
+        s.sum_of_squares += lanes[3][i];
+        s.nof_clipped_low += static_cast<size_t>(lanes[4][i]);
+        s.nof_clipped_high += static_cast<size_t>(lanes[5][i]);
+    }
+}
+
+template <typename T, typename U, bool TRACE, bool WINDOW, bool CONVERT>
+TARGET_AVX2 static void ConvertAvx2(const T *data, size_t count, U *y, double *fft,
+                                    size_t nof_fft_samples, const double *window,
+                                    const KernelParameters &p, SampleStatistics &s)
+{
+    /* We intentionally avoid fused multiply-add to get results that are
+       identical to the other kernels. */
+    const __m256d trace_scale = _mm256_set1_pd(p.trace_scale);
+    const __m256d trace_offset = _mm256_set1_pd(p.trace_offset);
+    const __m256d unit_scale = _mm256_set1_pd(p.unit_scale);
+
+    /* Stores that straddle cache lines are expensive, so we align the trace
+       with a few scalar iterations. */
+    constexpr size_t ALIGNMENT = 4 * sizeof(U);
+    size_t i = 0;
+    const size_t nof_unaligned =
+        (ALIGNMENT - reinterpret_cast<uintptr_t>(y) % ALIGNMENT) % ALIGNMENT / sizeof(U);
+    if (nof_unaligned > 0)
+    {
+        i = std::min(nof_unaligned, count);
+        ConvertScalar<T, U, TRACE, WINDOW, CONVERT>(data, 0, i, y, fft,
+                                                    std::min(i, nof_fft_samples), window, p, s);
+    }
+
+    Statistics4 statistics;
+    Initialize(statistics, s);
+
+    for (; i + 4 <= nof_fft_samples; i += 4)
+    {
+        const __m256d value = Load4(data + i);
+        if (TRACE && CONVERT)
+            Store4(y + i, _mm256_add_pd(_mm256_mul_pd(value, trace_scale), trace_offset));
+        else if (TRACE)
+            Store4(y + i, value);
+
+        __m256d unit = _mm256_mul_pd(value, unit_scale);
+        if (WINDOW)
+            unit = _mm256_mul_pd(unit, _mm256_loadu_pd(window + i));
+        _mm256_storeu_pd(fft + i, unit);
+        Accumulate4(statistics, value, p);
+    }
+
+    if (i < nof_fft_samples)
+    {
+        ConvertScalar<T, U, TRACE, WINDOW, CONVERT>(data, i, nof_fft_samples, y, fft,
+                                                    nof_fft_samples, window, p, s);
+        i = nof_fft_samples;
+    }
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256d value = Load4(data + i);
+        if (TRACE && CONVERT)
+            Store4(y + i, _mm256_add_pd(_mm256_mul_pd(value, trace_scale), trace_offset));
+        else if (TRACE)
+            Store4(y + i, value);
+        Accumulate4(statistics, value, p);
+    }
+
+    Reduce(statistics, s);
+
+    /* Avoid the transition penalty when returning to code using the legacy
+       SSE encoding. */
+    _mm256_zeroupper();
+    ConvertScalar<T, U, TRACE, WINDOW, CONVERT>(data, i, count, y, fft, nof_fft_samples, window,
+                                                p, s);
+}
+
+template <typename U>
+TARGET_AVX2 static void DecibelsAvx2(const double *power, size_t count, double offset, U *y)
+{
+    /* We intentionally avoid fused multiply-add to get results that are
+       identical to the other kernels. */
+    const __m256i mantissa_mask = _mm256_set1_epi64x(static_cast<int64_t>(MANTISSA_MASK));
+    const __m256i one_bits = _mm256_set1_epi64x(static_cast<int64_t>(ONE_BITS));
+    const __m256i two_to_52_bits = _mm256_set1_epi64x(static_cast<int64_t>(TWO_TO_52_BITS));
+    const __m256d exponent_bias = _mm256_set1_pd(EXPONENT_BIAS);
+    const __m256d lowest = _mm256_set1_pd(DBL_MIN);
+    const __m256d highest = _mm256_set1_pd(DBL_MAX);
+    const __m256d sqrt2 = _mm256_set1_pd(M_SQRT2);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d ln2 = _mm256_set1_pd(M_LN2);
+    const __m256d decibels_per_neper = _mm256_set1_pd(DECIBELS_PER_NEPER);
+    const __m256d offset_ = _mm256_set1_pd(offset);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256d x = _mm256_loadu_pd(power + i);
+        const __m256i bits = _mm256_castpd_si256(x);
+
+        __m256d exponent = _mm256_castsi256_pd(
+            _mm256_or_si256(_mm256_srli_epi64(bits, 52), two_to_52_bits));
+        exponent = _mm256_sub_pd(exponent, exponent_bias);
+        __m256d m = _mm256_castsi256_pd(
+            _mm256_or_si256(_mm256_and_si256(bits, mantissa_mask), one_bits));
+
+        const __m256d upper = _mm256_cmp_pd(m, sqrt2, _CMP_GT_OQ);
+        m = _mm256_blendv_pd(m, _mm256_mul_pd(m, half), upper);
+        exponent = _mm256_add_pd(exponent, _mm256_and_pd(upper, one));
+
+        const __m256d s = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+        const __m256d z = _mm256_mul_pd(s, s);
+        __m256d series = _mm256_set1_pd(1.0 / 17);
+        series = _mm256_add_pd(_mm256_mul_pd(series, z), _mm256_set1_pd(1.0 / 15));
+        series = _mm256_add_pd(_mm256_mul_pd(series, z), _mm256_set1_pd(1.0 / 13));
+        series = _mm256_add_pd(_mm256_mul_pd(series, z), _mm256_set1_pd(1.0 / 11));
+        series = _mm256_add_pd(_mm256_mul_pd(series, z), _mm256_set1_pd(1.0 / 9));
+        series = _mm256_add_pd(_mm256_mul_pd(series, z), _mm256_set1_pd(1.0 / 7));
+        series = _mm256_add_pd(_mm256_mul_pd(series, z), _mm256_set1_pd(1.0 / 5));
+        series = _mm256_add_pd(_mm256_mul_pd(series, z), _mm256_set1_pd(1.0 / 3));
+        series = _mm256_add_pd(_mm256_mul_pd(series, z), one);
+
+        const __m256d logarithm = _mm256_add_pd(_mm256_mul_pd(exponent, ln2),
+                                                _mm256_mul_pd(_mm256_mul_pd(two, s), series));
+        Store4(y + i, _mm256_add_pd(_mm256_mul_pd(decibels_per_neper, logarithm), offset_));
+
+        const __m256d valid = _mm256_and_pd(_mm256_cmp_pd(x, lowest, _CMP_GE_OQ),
+                                            _mm256_cmp_pd(x, highest, _CMP_LE_OQ));
+        if (_mm256_movemask_pd(valid) != 0xF)
+        {
+            _mm256_zeroupper();
+            DecibelsScalar(power, i, i + 4, offset, y);
+        }
+    }
+
+    _mm256_zeroupper();
+    DecibelsScalar(power, i, count, offset, y);
+}
+
+#endif
+
+SampleConversion::SampleConversion(double code_normalization, double input_range,
+                                   double dc_offset, bool convert_vertical)
+    : SampleConversion(code_normalization, input_range, dc_offset, convert_vertical,
+                       GetSupportedInstructionSet())
+{}
+
+SampleConversion::SampleConversion(double code_normalization, double input_range,
+                                   double dc_offset, bool convert_vertical,
+                                   InstructionSet instruction_set)
+    : m_trace_scale(input_range / code_normalization / 1e3)
+    , m_trace_offset(-dc_offset / 1e3)
+    , m_unit_scale(2.0 / code_normalization)
+    , m_code_low(-code_normalization / 2)
+    , m_code_high(code_normalization / 2 - 1)
+    , m_convert_vertical(convert_vertical)
+    , m_instruction_set(instruction_set)
+{
+    /* Never go beyond what the processor supports. */
+    if (static_cast<int>(m_instruction_set) > static_cast<int>(GetSupportedInstructionSet()))
+        m_instruction_set = GetSupportedInstructionSet();
+}
+
+SampleConversion::InstructionSet SampleConversion::GetSupportedInstructionSet()
+{
+    /* The processor isn't going to change while we're running. */
+    static const InstructionSet instruction_set = []() {
+#if defined(SAMPLE_CONVERSION_X86) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return InstructionSet::AVX2;
+        if (__builtin_cpu_supports("sse4.1"))
+            return InstructionSet::SSE41;
+#elif defined(SAMPLE_CONVERSION_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        const int nof_ids = info[0];
+
+        __cpuid(info, 1);
+        const bool sse41 = (info[2] & (1 << 19)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+
+        /* AVX also requires the operating system to save the YMM registers. */
+        bool avx2 = false;
+        if (nof_ids >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+
+        if (avx2)
+            return InstructionSet::AVX2;
+        if (sse41)
+            return InstructionSet::SSE41;
+#endif
+        return InstructionSet::SCALAR;
+    }();
+
+    return instruction_set;
+}
+
+template <typename T, typename U>
+void SampleConversion::Dispatch(const T *data, size_t count, U *y, double *fft,
+                                size_t nof_fft_samples, const double *window,
+                                SampleStatistics *statistics) const
+{
+    using Kernel = void (*)(const T *, size_t, U *, double *, size_t, const double *,
+                            const KernelParameters &, SampleStatistics &);
+
+    /* Resolve the specialization once per record instead of branching per
+       sample. The tables are indexed by [trace][window][convert]. */
+    static const Kernel SCALAR[2][2][2] = {
+        {
+            {ConvertScalar<T, U, false, false, false>, ConvertScalar<T, U, false, false, true>},
+            {ConvertScalar<T, U, false, true, false>, ConvertScalar<T, U, false, true, true>},
+        },
+        {
+            {ConvertScalar<T, U, true, false, false>, ConvertScalar<T, U, true, false, true>},
+            {ConvertScalar<T, U, true, true, false>, ConvertScalar<T, U, true, true, true>},
+        },
+    };
+
+#if defined(SAMPLE_CONVERSION_X86)
+    static const Kernel SSE41[2][2][2] = {
+        {
+            {ConvertSse41<T, U, false, false, false>, ConvertSse41<T, U, false, false, true>},
+            {ConvertSse41<T, U, false, true, false>, ConvertSse41<T, U, false, true, true>},
+        },
+        {
+            {ConvertSse41<T, U, true, false, false>, ConvertSse41<T, U, true, false, true>},
+            {ConvertSse41<T, U, true, true, false>, ConvertSse41<T, U, true, true, true>},
+        },
+    };
+
+    static const Kernel AVX2[2][2][2] = {
+        {
+            {ConvertAvx2<T, U, false, false, false>, ConvertAvx2<T, U, false, false, true>},
+            {ConvertAvx2<T, U, false, true, false>, ConvertAvx2<T, U, false, true, true>},
+        },
+        {
+            {ConvertAvx2<T, U, true, false, false>, ConvertAvx2<T, U, true, false, true>},
+            {ConvertAvx2<T, U, true, true, false>, ConvertAvx2<T, U, true, true, true>},
+        },
+    };
+#endif
+
+    /* Without a target for the transform input, only the trace is produced. */
+    if (fft == NULL)
+        nof_fft_samples = 0;
+    else if (nof_fft_samples > count)
+        nof_fft_samples = count;
+
+    /* The statistics are always gathered. They're cheap compared to the
+       memory traffic of the conversion. */
+    SampleStatistics s{};
+    s.min = std::numeric_limits<double>::infinity();
+    s.max = -std::numeric_limits<double>::infinity();
+    s.reference = count > 0 ? static_cast<double>(data[0]) : 0.0;
+    s.count = count;
+
+    const KernelParameters parameters{m_trace_scale, m_trace_offset, m_unit_scale,
+                                      s.reference,   m_code_low,     m_code_high};
+    const int has_trace = y != NULL ? 1 : 0;
+    const int has_window = window != NULL ? 1 : 0;
+    const int convert = m_convert_vertical ? 1 : 0;
+
+    switch (m_instruction_set)
+    {
+#if defined(SAMPLE_CONVERSION_X86)
+    case InstructionSet::AVX2:
+        AVX2[has_trace][has_window][convert](data, count, y, fft, nof_fft_samples, window,
+                                             parameters, s);
+        break;
+
+    case InstructionSet::SSE41:
+        SSE41[has_trace][has_window][convert](data, count, y, fft, nof_fft_samples, window,
+                                              parameters, s);
+        break;
+#endif
+
+    case InstructionSet::SCALAR:
+    default:
+        SCALAR[has_trace][has_window][convert](data, count, y, fft, nof_fft_samples, window,
+                                               parameters, s);
+        break;
+    }
+
+    if (statistics != NULL)
+        *statistics = s;
+}
+
+void SampleConversion::Convert(const int16_t *data, size_t count, double *y, double *fft,
+                               size_t nof_fft_samples, const double *window,
+                               SampleStatistics *statistics) const
+{
+    Dispatch(data, count, y, fft, nof_fft_samples, window, statistics);
+}
+
+void SampleConversion::Convert(const int32_t *data, size_t count, double *y, double *fft,
+                               size_t nof_fft_samples, const double *window,
+                               SampleStatistics *statistics) const
+{
+    Dispatch(data, count, y, fft, nof_fft_samples, window, statistics);
+}
+
+void SampleConversion::Convert(const int16_t *data, size_t count, float *y, double *fft,
+                               size_t nof_fft_samples, const double *window,
+                               SampleStatistics *statistics) const
+{
+    Dispatch(data, count, y, fft, nof_fft_samples, window, statistics);
+}
+
+void SampleConversion::Convert(const int32_t *data, size_t count, float *y, double *fft,
+                               size_t nof_fft_samples, const double *window,
+                               SampleStatistics *statistics) const
+{
+    Dispatch(data, count, y, fft, nof_fft_samples, window, statistics);
+}
+
+template <typename U>
+void SampleConversion::DispatchDecibels(const double *power, size_t count, double offset, U *y,
+                                        InstructionSet instruction_set)
+{
+    /* Never go beyond what the processor supports. */
+    if (static_cast<int>(instruction_set) > static_cast<int>(GetSupportedInstructionSet()))
+        instruction_set = GetSupportedInstructionSet();
+
+    switch (instruction_set)
+    {
+#if defined(SAMPLE_CONVERSION_X86)
+    case InstructionSet::AVX2:
+        DecibelsAvx2(power, count, offset, y);
+        break;
+
+    case InstructionSet::SSE41:
+        DecibelsSse41(power, count, offset, y);
+        break;
+#endif
+
+    case InstructionSet::SCALAR:
+    default:
+        DecibelsScalar(power, 0, count, offset, y);
+        break;
+    }
+}
+
+void SampleConversion::Decibels(const double *power, size_t count, double offset, double *y,
+                                InstructionSet instruction_set)
+{
+    DispatchDecibels(power, count, offset, y, instruction_set);
+}
+
+void SampleConversion::Decibels(const double *power, size_t count, double offset, float *y,
+                                InstructionSet instruction_set)
+{
+    DispatchDecibels(power, count, offset, y, instruction_set);
+}
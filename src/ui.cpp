@@ -78,19 +78,19 @@ void Ui::ChannelUiState::SaveToFile(
 
     nlohmann::json json;
     json["label"] = record->label;
-    json["time_domain"]["x"]["data"] = record->time_domain->x;
-    json["time_domain"]["x"]["unit"] = record->time_domain->x_properties.unit;
+    json["time_domain"]["x"]["data"] = record->time_domain->MaterializeX();
+    json["time_domain"]["x"]["unit"] = record->time_domain->x_properties->unit;
     json["time_domain"]["y"]["data"] = record->time_domain->y;
-    json["time_domain"]["y"]["unit"] = record->time_domain->y_properties.unit;
+    json["time_domain"]["y"]["unit"] = record->time_domain->y_properties->unit;
 
     json["time_domain"]["markers"] = nlohmann::json::array();
     for (const auto &marker : time_domain_markers)
         json["time_domain"]["markers"] += {{"x", marker.x.value}, {"y", marker.y.value}};
 
-    json["frequency_domain"]["x"]["data"] = record->frequency_domain->x;
-    json["frequency_domain"]["x"]["unit"] = record->frequency_domain->x_properties.unit;
+    json["frequency_domain"]["x"]["data"] = record->frequency_domain->MaterializeX();
+    json["frequency_domain"]["x"]["unit"] = record->frequency_domain->x_properties->unit;
     json["frequency_domain"]["y"]["data"] = record->frequency_domain->y;
-    json["frequency_domain"]["y"]["unit"] = record->frequency_domain->y_properties.unit;
+    json["frequency_domain"]["y"]["unit"] = record->frequency_domain->y_properties->unit;
 
     json["frequency_domain"]["markers"] = nlohmann::json::array();
     for (const auto &marker : frequency_domain_markers)
@@ -234,6 +234,7 @@ Ui::Ui()
     , m_libadq{}
     , m_file_browser(ImGuiFileBrowserFlags_EnterNewFilename | ImGuiFileBrowserFlags_CreateNewDir |
                      ImGuiFileBrowserFlags_CloseOnEsc)
+    , m_waterfall_rows{}
 {
 }
 
@@ -1674,7 +1675,7 @@ void Ui::MarkerTree(Markers &markers, bool inverse_delta)
                                                 marker.x.FormatDelta(delta_x, true),
                                                 marker.y.FormatDelta(delta_y, true)));
 
-                        if (inverse_delta && !marker.x.properties.inverse_delta_unit.empty())
+                        if (inverse_delta && !marker.x.properties->inverse_delta_unit.empty())
                         {
                             const double idelta_x = std::abs(1.0 / delta_x);
                             ImGui::Text(fmt::format(" {}", marker.x.FormatInverseDelta(idelta_x)));
@@ -1811,7 +1812,7 @@ void Ui::RenderSensorGroup(SensorGroupUiState &group, bool is_first)
             else
             {
                 ImGui::Text(fmt::format("{:7.3f} {}", sensor.record.y.back(),
-                                        sensor.record.y_properties.unit));
+                                        sensor.record.y_properties->unit));
             }
         }
 
@@ -2245,6 +2246,88 @@ void Ui::RenderProcessingOptions(const ImVec2 &position, const ImVec2 &size)
         push_parameters = true;
     }
 
+    const auto LengthGetter = [](void *, int idx, const char **label) -> bool
+    {
+        /* Assume a straight mapping between the index and the enumeration. */
+        static const std::vector<const char *> length_labels = TRANSFORM_LENGTH_LABELS;
+        *label = length_labels.at(idx);
+        return true;
+    };
+
+    static int length_idx = static_cast<int>(DataProcessingParameters().fft_length);
+    ImGui::SetNextItemWidth(WIDGET_WIDTH);
+    if (ImGui::Combo("FFT length", &length_idx, LengthGetter, NULL,
+                     static_cast<int>(TransformLength::NOF_ENTRIES)))
+    {
+        m_processing_parameters.fft_length = static_cast<TransformLength>(length_idx);
+        push_parameters = true;
+    }
+
+    /* Transforms of at least this length are split over the worker threads.
+       The topmost position disables the parallel transform. */
+    static const ImS32 FFT_PARALLEL_LIMIT_LOW = 14;
+    static const ImS32 FFT_PARALLEL_LIMIT_HIGH = 28;
+    static ImS32 fft_parallel_exponent = 20;
+    const std::string fft_parallel_label =
+        fft_parallel_exponent == FFT_PARALLEL_LIMIT_HIGH
+            ? "Off"
+            : Format::Metric(static_cast<double>(1u << fft_parallel_exponent), "{:.0f} {}");
+    ImGui::SetNextItemWidth(WIDGET_WIDTH);
+    if (ImGui::SliderScalar("Parallel FFT", ImGuiDataType_S32, &fft_parallel_exponent,
+                            &FFT_PARALLEL_LIMIT_LOW, &FFT_PARALLEL_LIMIT_HIGH,
+                            fft_parallel_label.c_str(), ImGuiSliderFlags_NoInput))
+    {
+        m_processing_parameters.fft_parallel_threshold =
+            fft_parallel_exponent == FFT_PARALLEL_LIMIT_HIGH ? 0 : (size_t{1} << fft_parallel_exponent);
+        push_parameters = true;
+    }
+
+    /* Welch's method averages the spectra of overlapping segments of this
+       length. The bottom position transforms the entire record instead. */
+    static const ImS32 WELCH_LIMIT_LOW = 7;
+    static const ImS32 WELCH_LIMIT_HIGH = 20;
+    static ImS32 welch_exponent = WELCH_LIMIT_LOW;
+    const std::string welch_label =
+        welch_exponent == WELCH_LIMIT_LOW
+            ? "Off"
+            : Format::Metric(static_cast<double>(1u << welch_exponent), "{:.0f} {}");
+    ImGui::SetNextItemWidth(WIDGET_WIDTH);
+    if (ImGui::SliderScalar("Welch segment", ImGuiDataType_S32, &welch_exponent,
+                            &WELCH_LIMIT_LOW, &WELCH_LIMIT_HIGH, welch_label.c_str(),
+                            ImGuiSliderFlags_NoInput))
+    {
+        m_processing_parameters.welch_segment_length =
+            welch_exponent == WELCH_LIMIT_LOW ? 0 : (size_t{1} << welch_exponent);
+        push_parameters = true;
+    }
+
+    static const ImS32 WATERFALL_DEPTH_LIMIT_LOW = 4;
+    static const ImS32 WATERFALL_DEPTH_LIMIT_HIGH = 12;
+    static ImS32 waterfall_depth_exponent = 5;
+    ImGui::SetNextItemWidth(WIDGET_WIDTH);
+    if (ImGui::SliderScalar("Waterfall rows", ImGuiDataType_S32, &waterfall_depth_exponent,
+                            &WATERFALL_DEPTH_LIMIT_LOW, &WATERFALL_DEPTH_LIMIT_HIGH,
+                            fmt::format("{}", 1 << waterfall_depth_exponent).c_str(),
+                            ImGuiSliderFlags_NoInput))
+    {
+        m_processing_parameters.waterfall_depth = size_t{1} << waterfall_depth_exponent;
+        push_parameters = true;
+    }
+
+    /* The number of records of each kind kept in memory for reuse. */
+    static const ImS32 RECYCLED_RECORDS_LIMIT_LOW = 0;
+    static const ImS32 RECYCLED_RECORDS_LIMIT_HIGH = 16;
+    static ImS32 nof_recycled_records =
+        static_cast<ImS32>(DataProcessingParameters().nof_recycled_records);
+    ImGui::SetNextItemWidth(WIDGET_WIDTH);
+    if (ImGui::SliderScalar("Recycled records", ImGuiDataType_S32, &nof_recycled_records,
+                            &RECYCLED_RECORDS_LIMIT_LOW, &RECYCLED_RECORDS_LIMIT_HIGH, "%d",
+                            ImGuiSliderFlags_NoInput))
+    {
+        m_processing_parameters.nof_recycled_records = static_cast<size_t>(nof_recycled_records);
+        push_parameters = true;
+    }
+
     static ImGui::InputDoubleMetric fundamental_frequency(
         "Fixed fundamental", m_processing_parameters.fundamental_frequency, "{:.3f} {}Hz", 1e6);
     static bool fundamental_frequency_enable = false;
@@ -2271,9 +2354,52 @@ void Ui::RenderProcessingOptions(const ImVec2 &position, const ImVec2 &size)
         push_parameters = true;
     }
 
+    /* Tone tracking measures the tones at the fixed fundamental frequency
+       without computing the spectrum. */
+    if (ImGui::Checkbox("Tone tracking", &m_processing_parameters.tone_tracking))
+        push_parameters = true;
+
     if (!fundamental_frequency_enable)
         ImGui::EndDisabled();
 
+    /* The zoom transform shows the span around the center frequency. The span
+       is zero while disabled. */
+    static ImGui::InputDoubleMetric zoom_center_frequency("Zoom center", 100e6, "{:.3f} {}Hz", 1e6);
+    /* A narrow span needs a long filter, so we put a lower limit on it. */
+    static const double ZOOM_SPAN_LIMIT_LOW = 100e3;
+    static ImGui::InputDoubleMetric zoom_span("Zoom span", 10e6, "{:.3f} {}Hz", 1e6, 0,
+                                              ZOOM_SPAN_LIMIT_LOW);
+    static bool zoom_enable = false;
+
+    if (ImGui::Checkbox("##zoomenable", &zoom_enable))
+    {
+        m_processing_parameters.zoom_center_frequency = zoom_center_frequency.value;
+        m_processing_parameters.zoom_span = zoom_enable ? zoom_span.value : 0.0;
+        push_parameters = true;
+    }
+
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(WIDGET_WIDTH - 27.0f);
+
+    if (!zoom_enable)
+        ImGui::BeginDisabled();
+
+    if (zoom_center_frequency.Changed())
+    {
+        m_processing_parameters.zoom_center_frequency = zoom_center_frequency.value;
+        push_parameters = true;
+    }
+
+    ImGui::SetNextItemWidth(WIDGET_WIDTH);
+    if (zoom_span.Changed())
+    {
+        m_processing_parameters.zoom_span = zoom_span.value;
+        push_parameters = true;
+    }
+
+    if (!zoom_enable)
+        ImGui::EndDisabled();
+
     static const ImS32 NOF_SKIRT_BINS_LIMIT_LOW = 0;
     static const ImS32 NOF_SKIRT_BINS_LIMIT_HIGH = 16;
     static ImS32 nof_skirt_bins = m_processing_parameters.nof_skirt_bins;
@@ -2286,14 +2412,37 @@ void Ui::RenderProcessingOptions(const ImVec2 &position, const ImVec2 &size)
         push_parameters = true;
     }
 
+    const auto AveragingGetter = [](void *, int idx, const char **label) -> bool
+    {
+        /* Assume a straight mapping between the index and the enumeration. */
+        static const std::vector<const char *> averaging_labels = FREQUENCY_DOMAIN_AVERAGING_LABELS;
+        *label = averaging_labels.at(idx);
+        return true;
+    };
+
+    static int averaging_idx = static_cast<int>(DataProcessingParameters().fft_averaging);
+    ImGui::SetNextItemWidth(WIDGET_WIDTH);
+    if (ImGui::Combo("FFT averaging", &averaging_idx, AveragingGetter, NULL,
+                     static_cast<int>(FrequencyDomainAveraging::NOF_ENTRIES)))
+    {
+        m_processing_parameters.fft_averaging = static_cast<FrequencyDomainAveraging>(averaging_idx);
+        push_parameters = true;
+    }
+
     static const ImS32 NOF_FFT_AVERAGES_LIMIT_LOW = 0;
     static const ImS32 NOF_FFT_AVERAGES_LIMIT_HIGH = 10;
     static ImS32 nof_fft_averages = 0;
     if (ImGui::Button("Clear"))
         PushMessage({DigitizerMessageId::CLEAR_PROCESSING_MEMORY}, true);
 
+    /* The number of averages has no meaning for the cumulative average. */
+    const bool cumulative =
+        m_processing_parameters.fft_averaging == FrequencyDomainAveraging::CUMULATIVE;
+
     ImGui::SameLine();
     ImGui::SetNextItemWidth(WIDGET_WIDTH - 51.0f);
+    if (cumulative)
+        ImGui::BeginDisabled();
     if (ImGui::SliderScalar("FFT averages", ImGuiDataType_S32, &nof_fft_averages,
                             &NOF_FFT_AVERAGES_LIMIT_LOW, &NOF_FFT_AVERAGES_LIMIT_HIGH,
                             fmt::format("{}", 1 << nof_fft_averages).c_str(),
@@ -2302,6 +2451,8 @@ void Ui::RenderProcessingOptions(const ImVec2 &position, const ImVec2 &size)
         m_processing_parameters.nof_fft_averages = static_cast<int>(1u << nof_fft_averages);
         push_parameters = true;
     }
+    if (cumulative)
+        ImGui::EndDisabled();
 
     if (ImGui::Checkbox("FFT maximum hold", &m_processing_parameters.fft_maximum_hold))
         push_parameters = true;
@@ -2324,6 +2475,10 @@ void Ui::RenderProcessingOptions(const ImVec2 &position, const ImVec2 &size)
     if (ImGui::Checkbox("Full-scale ENOB", &m_processing_parameters.fullscale_enob))
         push_parameters = true;
 
+    /* Compute the metrics of every record, not just the ones we have time to show. */
+    if (ImGui::Checkbox("Full-rate metrics", &m_processing_parameters.full_rate_metrics))
+        push_parameters = true;
+
     if (push_parameters)
         PushMessage({DigitizerMessageId::SET_PROCESSING_PARAMETERS, m_processing_parameters}, false);
 
@@ -2473,84 +2628,24 @@ void Ui::Reduce(double xsize, double sampling_period, int &count, int &stride)
 
 void Ui::SnapX(double x, const BaseRecord *record, double &snap_x, double &snap_y)
 {
-    if (x < record->x.front())
-    {
-        snap_x = record->x.front();
-        snap_y = record->y.front();
-    }
-    else if (x > record->x.back())
+    /* The spectrum is empty while tracking tones. */
+    if (record->y.empty())
     {
-        snap_x = record->x.back();
-        snap_y = record->y.back();
+        snap_x = x;
+        snap_y = 0.0;
     }
     else
     {
-        /* Get the distance to the first sample, which we now know is a positive
-           value in the range spanned by the x-vector. */
-        double distance = x - record->x.front();
-        size_t index = static_cast<size_t>(std::round(distance / record->step));
-        snap_x = record->x[index];
+        const size_t index = record->ClosestIndex(x);
+        snap_x = record->X(index);
         snap_y = record->y[index];
     }
 }
 
-void Ui::GetClosestSampleIndex(double x, double y, const BaseRecord *record, const ImPlotRect &view,
+bool Ui::GetClosestSampleIndex(double x, double y, const BaseRecord *record, const ImPlotRect &view,
                                size_t &index)
 {
-    /* Find the closest sample to the coordinates (x,y) by minimizing the
-       Euclidian distance. We have to normalize the data fpr this method to give
-       the desired results---namely, we have to normalize using the _plot_
-       limits since that is the perceived reference frame of the user. */
-
-    const double kx = (view.X.Max - view.X.Min) / 2;
-    const double mx = -(view.X.Min + kx);
-    const double ky = (view.Y.Max - view.Y.Min) / 2;
-    const double my = -(view.Y.Min + ky);
-
-    const double x_normalized = (x + mx) / kx;
-    const double x_step_normalized = record->step / kx;
-    const double y_normalized = (y + my) / ky;
-
-    const double x0_normalized = (record->x.front() + mx) / kx;
-    const double center = std::round((x_normalized - x0_normalized) / x_step_normalized);
-
-    /* Create a symmetric span around the rounded x-coordinate and then clip the
-       limits to the range where there's data. */
-    const double span = 16.0;
-    const double low_limit = 0.0;
-    const double high_limit = static_cast<double>(record->x.size() - 1);
-    double span_low = center - span;
-    double span_high = center + span;
-
-    if (span_low < low_limit)
-        span_low = low_limit;
-    else if (span_low > (high_limit - span))
-        span_low = std::max(high_limit - span, low_limit);
-
-    if (span_high < (low_limit + span))
-        span_high = std::min(low_limit + span, high_limit);
-    else if (span_high > high_limit)
-        span_high = high_limit;
-
-    const size_t low = static_cast<size_t>(span_low);
-    const size_t high = static_cast<size_t>(span_high);
-    double distance_min = std::numeric_limits<double>::max();
-
-    for (size_t i = low; i <= high; ++i)
-    {
-        const double xi = (record->x[i] + mx) / kx;
-        const double yi = (record->y[i] + my) / ky;
-
-        const double x2 = std::pow(x_normalized - xi, 2);
-        const double y2 = std::pow(y_normalized - yi, 2);
-        const double distance = x2 + y2;
-
-        if (distance < distance_min)
-        {
-            index = i;
-            distance_min = distance;
-        }
-    }
+    return record->ClosestIndex(x, y, view.X.Min, view.X.Max, view.Y.Min, view.Y.Max, index);
 }
 
 std::vector<std::tuple<size_t, size_t, Ui::ChannelUiState *>> Ui::FilterUiStates()
@@ -2701,10 +2796,10 @@ void Ui::PlotTimeDomainSelected()
         if (first)
         {
             const auto &record = ui->record->time_domain;
-            ImPlot::SetupAxisFormat(ImAxis_X1, Format::Metric, record->x_properties.unit.data());
-            ImPlot::SetupAxisFormat(ImAxis_Y1, Format::Metric, record->y_properties.unit.data());
-            m_time_domain_units_per_division.x_unit = record->x_properties.delta_unit;
-            m_time_domain_units_per_division.y_unit = record->y_properties.delta_unit;
+            ImPlot::SetupAxisFormat(ImAxis_X1, Format::Metric, record->x_properties->unit.data());
+            ImPlot::SetupAxisFormat(ImAxis_Y1, Format::Metric, record->y_properties->unit.data());
+            m_time_domain_units_per_division.x_unit = record->x_properties->delta_unit;
+            m_time_domain_units_per_division.y_unit = record->y_properties->delta_unit;
 
             if (m_should_fit_to_input_range)
               ImPlot::SetupAxisLimits(ImAxis_Y1, 1.1 * range_min, 1.1 * range_max, ImPlotCond_Always);
@@ -2757,9 +2852,9 @@ void Ui::PlotTimeDomainSelected()
                     continue;
 
                 const std::string label = fmt::format("##{}{}", record->label.c_str(), j);
-                ImPlot::PlotLine(label.c_str(), record->time_domain->x.data(),
-                                 record->time_domain->y.data(),
-                                 static_cast<int>(record->time_domain->x.size()));
+                ImPlot::PlotLine(label.c_str(), record->time_domain->y.data(),
+                                 static_cast<int>(record->time_domain->y.size()),
+                                 record->time_domain->step, record->time_domain->start);
             }
         }
 
@@ -2767,9 +2862,9 @@ void Ui::PlotTimeDomainSelected()
            information about and interact with via the markers and friends.
            Depending on the current 'fill' of the frame, this may be a record
            from the last frame and thus not plotted by the loop above. */
-        ImPlot::PlotLine(ui->record->label.c_str(), ui->record->time_domain->x.data(),
-                         ui->record->time_domain->y.data(),
-                         static_cast<int>(ui->record->time_domain->x.size()));
+        ImPlot::PlotLine(ui->record->label.c_str(), ui->record->time_domain->y.data(),
+                         static_cast<int>(ui->record->time_domain->y.size()),
+                         ui->record->time_domain->step, ui->record->time_domain->start);
 
         ImPlot::PopStyleColor();
 
@@ -2786,9 +2881,10 @@ void Ui::PlotTimeDomainSelected()
             {
                 const auto &memory_record = ui->memory[m];
                 const std::string label = fmt::format("M{} {}", m, memory_record->label);
-                ImPlot::PlotLine(label.c_str(), memory_record->time_domain->x.data(),
-                                 memory_record->time_domain->y.data(),
-                                 static_cast<int>(memory_record->time_domain->x.size()));
+                ImPlot::PlotLine(label.c_str(), memory_record->time_domain->y.data(),
+                                 static_cast<int>(memory_record->time_domain->y.size()),
+                                 memory_record->time_domain->step,
+                                 memory_record->time_domain->start);
             }
             ImPlot::PopStyleColor();
         }
@@ -2845,14 +2941,19 @@ void Ui::MaybeAddMarker(size_t digitizer, size_t channel, const BaseRecord *reco
 {
     if (ImPlot::IsPlotHovered() && ImGui::GetIO().KeyCtrl && ImGui::IsMouseClicked(0))
     {
+        /* The spectrum is empty while tracking tones, so there may not be a
+           sample to place the marker on. */
         size_t index;
-        GetClosestSampleIndex(ImPlot::GetPlotMousePos().x, ImPlot::GetPlotMousePos().y, record,
-                              ImPlot::GetPlotLimits(), index);
+        if (!GetClosestSampleIndex(ImPlot::GetPlotMousePos().x, ImPlot::GetPlotMousePos().y,
+                                   record, ImPlot::GetPlotLimits(), index))
+        {
+            return;
+        }
 
         /* FIXME: Probably need to consider the initial x/y-values to be
                   special. Otherwise, the marker can seem to wander a bit if the
                   signal is noisy. */
-        markers.insert(digitizer, channel, index, record->ValueX(record->x[index]),
+        markers.insert(digitizer, channel, index, record->ValueX(record->X(index)),
                        record->ValueY(record->y[index]));
         markers.is_adding = true;
         markers.is_dragging = false;
@@ -2864,9 +2965,12 @@ void Ui::MaybeAddMarker(size_t digitizer, size_t channel, const BaseRecord *reco
         if (!markers.is_dragging)
         {
             size_t index;
-            GetClosestSampleIndex(ImPlot::GetPlotMousePos().x, ImPlot::GetPlotMousePos().y, record,
-                                  ImPlot::GetPlotLimits(), index);
-            markers.insert(digitizer, channel, index, record->ValueX(record->x[index]),
+            if (!GetClosestSampleIndex(ImPlot::GetPlotMousePos().x, ImPlot::GetPlotMousePos().y,
+                                       record, ImPlot::GetPlotLimits(), index))
+            {
+                return;
+            }
+            markers.insert(digitizer, channel, index, record->ValueX(record->X(index)),
                            record->ValueY(record->y[index]), true);
         }
 
@@ -2961,8 +3065,9 @@ void Ui::PlotSensorsSelected()
                     continue;
 
                 const auto label = fmt::format("{}: {}", digitizer.ui.identifier, sensor.label);
-                ImPlot::PlotLine(label.c_str(), sensor.record.x.data(), sensor.record.y.data(),
-                                 static_cast<int>(sensor.record.x.size()));
+                ImPlot::PlotLine(label.c_str(), sensor.record.y.data(),
+                                 static_cast<int>(sensor.record.y.size()), sensor.record.step,
+                                 sensor.record.start);
             }
         }
     }
@@ -3180,9 +3285,9 @@ void Ui::PlotFourierTransformSelected()
         if (first)
         {
             const auto &record = ui->record->frequency_domain;
-            ImPlot::SetupAxisFormat(ImAxis_X1, Format::Metric, record->x_properties.unit.data());
-            m_frequency_domain_units_per_division.x_unit = record->x_properties.delta_unit;
-            m_frequency_domain_units_per_division.y_unit = record->y_properties.delta_unit;
+            ImPlot::SetupAxisFormat(ImAxis_X1, Format::Metric, record->x_properties->unit.data());
+            m_frequency_domain_units_per_division.x_unit = record->x_properties->delta_unit;
+            m_frequency_domain_units_per_division.y_unit = record->y_properties->delta_unit;
             first = false;
         }
 
@@ -3192,9 +3297,9 @@ void Ui::PlotFourierTransformSelected()
           m_should_auto_fit_frequency_domain = false;
 
         ImPlot::PushStyleColor(ImPlotCol_Line, ui->color);
-        ImPlot::PlotLine(ui->record->label.c_str(), ui->record->frequency_domain->x.data(),
-                         ui->record->frequency_domain->y.data(),
-                         static_cast<int>(ui->record->frequency_domain->x.size()));
+        ImPlot::PlotLine(ui->record->label.c_str(), ui->record->frequency_domain->y.data(),
+                         static_cast<int>(ui->record->frequency_domain->y.size()),
+                         ui->record->frequency_domain->step, ui->record->frequency_domain->start);
         ImPlot::PopStyleColor();
 
         /* Plot any waveforms in memory. */
@@ -3210,9 +3315,10 @@ void Ui::PlotFourierTransformSelected()
             {
                 const auto &memory_record = ui->memory[m];
                 const std::string label = fmt::format("M{} {}", m, memory_record->label);
-                ImPlot::PlotLine(label.c_str(), memory_record->frequency_domain->x.data(),
-                                 memory_record->frequency_domain->y.data(),
-                                 static_cast<int>(memory_record->frequency_domain->x.size()));
+                ImPlot::PlotLine(label.c_str(), memory_record->frequency_domain->y.data(),
+                                 static_cast<int>(memory_record->frequency_domain->y.size()),
+                                 memory_record->frequency_domain->step,
+                                 memory_record->frequency_domain->start);
             }
             ImPlot::PopStyleColor();
         }
@@ -3328,7 +3434,7 @@ void Ui::PlotWaterfallSelected(double &scale_min, double &scale_max)
         /* TODO: Y-axis scale (probably time delta?) */
         const auto &[i, ch, ui] = filtered_ui.back();
         ImPlot::SetupAxisFormat(ImAxis_X1, Format::Metric,
-                                ui->record->frequency_domain->x_properties.unit.data());
+                                ui->record->frequency_domain->x_properties->unit.data());
 
         /* Unset the automatic auto fit as soon as we know we have something to
            plot (it's already been armed at this point). */
@@ -3338,12 +3444,23 @@ void Ui::PlotWaterfallSelected(double &scale_min, double &scale_max)
         scale_min = std::round(ui->record->frequency_domain->noise_moving_average.value);
         scale_max = 0.0;
 
-        const double TOP_RIGHT = ui->record->time_domain->sampling_frequency.value / 2;
-        ImPlot::PlotHeatmap("heat", ui->record->waterfall->data.data(),
-                            static_cast<int>(ui->record->waterfall->rows),
-                            static_cast<int>(ui->record->waterfall->columns),
-                            scale_min, scale_max, NULL,
-                            ImPlotPoint(0, 0), ImPlotPoint(TOP_RIGHT, 1));
+        const auto &waterfall = ui->record->waterfall;
+        if (waterfall == NULL)
+            return;
+
+        /* The waterfall is a ring buffer shared with the processing thread.
+           We copy out the rows we're showing, newest first, instead of holding
+           the lock while plotting, which would stall the processing. */
+        const size_t nof_rows = waterfall->Copy(ui->record->waterfall_sequence, m_waterfall_rows);
+        if (nof_rows == 0)
+            return;
+
+        /* The columns cover the bins of the spectra in the waterfall, which
+           may be a zoomed in band, and not necessarily those of the current
+           record. */
+        ImPlot::PlotHeatmap("heat", m_waterfall_rows.data(), static_cast<int>(nof_rows),
+                            static_cast<int>(waterfall->columns), scale_min, scale_max, NULL,
+                            ImPlotPoint(waterfall->x_min, 0), ImPlotPoint(waterfall->x_max, 1));
         return;
     }
 }
@@ -3493,10 +3610,10 @@ void Ui::SaveSensorsToFile(const std::filesystem::path &path)
                 if (!sensor.is_plotted)
                     continue;
 
-                json[digitizer.ui.identifier][group.label][sensor.label]["x"]["data"] = sensor.record.x;
-                json[digitizer.ui.identifier][group.label][sensor.label]["x"]["unit"] = sensor.record.x_properties.unit;
+                json[digitizer.ui.identifier][group.label][sensor.label]["x"]["data"] = sensor.record.MaterializeX();
+                json[digitizer.ui.identifier][group.label][sensor.label]["x"]["unit"] = sensor.record.x_properties->unit;
                 json[digitizer.ui.identifier][group.label][sensor.label]["y"]["data"] = sensor.record.y;
-                json[digitizer.ui.identifier][group.label][sensor.label]["y"]["unit"] = sensor.record.y_properties.unit;
+                json[digitizer.ui.identifier][group.label][sensor.label]["y"]["unit"] = sensor.record.y_properties->unit;
             }
         }
     }
@@ -11,10 +11,10 @@ Window::Window(size_t length)
 {}
 
 WindowCache::WindowCache()
-    : hamming_windows{}
-    , blackman_harris_windows{}
-    , hanning_windows{}
-    , flat_top_windows{}
+    : hamming_window{}
+    , blackman_harris_window{}
+    , hanning_window{}
+    , flat_top_window{}
 {}
 
 std::shared_ptr<Window> WindowCache::GetWindow(WindowType type, size_t length)
@@ -25,16 +25,16 @@ std::shared_ptr<Window> WindowCache::GetWindow(WindowType type, size_t length)
         return NULL;
 
     case WindowType::HAMMING:
-        return GetWindow(hamming_windows, length, Hamming);
+        return GetWindow(hamming_window, length, Hamming);
 
     case WindowType::BLACKMAN_HARRIS:
-        return GetWindow(blackman_harris_windows, length, BlackmanHarris);
+        return GetWindow(blackman_harris_window, length, BlackmanHarris);
 
     case WindowType::HANNING:
-        return GetWindow(hanning_windows, length, Hanning);
+        return GetWindow(hanning_window, length, Hanning);
 
     case WindowType::FLAT_TOP:
-        return GetWindow(flat_top_windows, length, FlatTop);
+        return GetWindow(flat_top_window, length, FlatTop);
 
     default:
         break;
@@ -43,15 +43,16 @@ std::shared_ptr<Window> WindowCache::GetWindow(WindowType type, size_t length)
     return NULL;
 }
 
-std::shared_ptr<Window> WindowCache::GetWindow(std::map<size_t, std::shared_ptr<Window>> &windows,
-                                               size_t length,
+std::shared_ptr<Window> WindowCache::GetWindow(std::shared_ptr<Window> &cached, size_t length,
                                                std::function<double(size_t, size_t)> f)
 {
-    /* First we try to find a window of matching length in the cache. This will
-       almost always return a hit (which is obviously the point of the cache). */
-    auto search = windows.find(length);
-    if (search != windows.end())
-        return search->second;
+    /* First we check if the cached window has the right length. This will
+       almost always be the case (which is obviously the point of the cache). */
+    if (cached != NULL && cached->length == length)
+        return cached;
+
+    /* Let go of the previous window before creating the next one. */
+    cached.reset();
 
     /* Create a new window with the target length. */
     auto window = std::make_shared<Window>(length);
@@ -78,7 +79,7 @@ std::shared_ptr<Window> WindowCache::GetWindow(std::map<size_t, std::shared_ptr<
        this operation that out and instead scales by the energy factor. */
     window->amplitude_to_energy = window->energy_factor / window->amplitude_factor;
 
-    windows.insert({length, window});
+    cached = window;
     return window;
 }
 
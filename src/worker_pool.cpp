@@ -0,0 +1,357 @@
+#include "worker_pool.h"
+#include "error.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/* The pool and queue index of the worker running on this thread, if any. */
+static thread_local const WorkerPool *this_pool = NULL;
+static thread_local size_t this_queue = 0;
+
+WorkerPool::WorkerPool(size_t nof_threads, const std::vector<int> &affinity)
+    : m_queues{}
+    , m_threads{}
+    , m_next_queue{0}
+    , m_mutex{}
+    , m_signal{}
+    , m_nof_tasks{0}
+    , m_should_stop{false}
+{
+    for (size_t i = 0; i < nof_threads; ++i)
+        m_queues.emplace_back(std::make_unique<Queue>());
+
+    for (size_t i = 0; i < nof_threads; ++i)
+    {
+        m_threads.emplace_back(&WorkerPool::MainLoop, this, i);
+        if (!affinity.empty())
+            SetAffinity(m_threads.back(), affinity[i % affinity.size()]);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::unique_lock lock{m_mutex};
+        m_should_stop = true;
+    }
+
+    m_signal.notify_all();
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+std::shared_ptr<WorkerPool> WorkerPool::Shared()
+{
+    static const auto pool = []() {
+        /* The calling thread always participates in `ParallelFor`, so by
+           default we leave one core for it. */
+        size_t nof_threads = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+        std::vector<int> affinity{};
+
+        const char *threads_env = std::getenv("SIGSCAPE_WORKER_THREADS");
+        if (threads_env != NULL)
+        {
+            char *end = NULL;
+            const long value = std::strtol(threads_env, &end, 10);
+            if (end != threads_env && *end == '\0' && value >= 0)
+                nof_threads = static_cast<size_t>(value);
+            else
+                Log::log->warn("Ignoring invalid worker thread count '{}'.", threads_env);
+        }
+
+        const char *affinity_env = std::getenv("SIGSCAPE_WORKER_AFFINITY");
+        if (affinity_env != NULL && SCAPE_EOK != ParseCpuList(affinity_env, affinity))
+        {
+            Log::log->warn("Ignoring invalid worker affinity '{}'.", affinity_env);
+            affinity.clear();
+        }
+
+        Log::log->info("Starting {} worker threads.", nof_threads);
+        return std::make_shared<WorkerPool>(nof_threads, affinity);
+    }();
+
+    return pool;
+}
+
+int WorkerPool::ParseCpuList(const std::string &str, std::vector<int> &cpus)
+{
+    std::vector<int> result{};
+    std::stringstream ss{str};
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        int first = 0;
+        int last = 0;
+        char dash = '\0';
+        char extra = '\0';
+
+        std::stringstream rss{range};
+        if (!(rss >> first))
+            return SCAPE_EINVAL;
+
+        if (rss >> dash)
+        {
+            if (dash != '-' || !(rss >> last) || rss >> extra)
+                return SCAPE_EINVAL;
+        }
+        else
+        {
+            last = first;
+        }
+
+        if (first < 0 || last < first)
+            return SCAPE_EINVAL;
+
+        for (int cpu = first; cpu <= last; ++cpu)
+            result.push_back(cpu);
+    }
+
+    if (result.empty())
+        return SCAPE_EINVAL;
+
+    cpus = std::move(result);
+    return SCAPE_EOK;
+}
+
+void WorkerPool::Post(std::function<void()> task)
+{
+    if (m_threads.empty())
+    {
+        task();
+        return;
+    }
+
+    /* A worker keeps the tasks it posts for itself, anyone else spreads them
+       evenly over the queues. Idle workers will steal them if needed. */
+    const size_t index = this_pool == this ? this_queue : m_next_queue++ % m_queues.size();
+
+    /* The task is counted before it's published, i.e. a worker can't pop it
+       and decrement the counter before the increment. */
+    {
+        std::unique_lock lock{m_mutex};
+        ++m_nof_tasks;
+        std::unique_lock queue_lock{m_queues[index]->mutex};
+        m_queues[index]->tasks.emplace_back(std::move(task));
+    }
+
+    m_signal.notify_one();
+}
+
+void WorkerPool::Defer(std::function<void()> task)
+{
+    if (this_pool != this)
+    {
+        Post(std::move(task));
+        return;
+    }
+
+    /* Our own queue is processed newest first, so the oldest end is the back
+       of the line. It's also where the other workers steal from. */
+    {
+        std::unique_lock lock{m_mutex};
+        ++m_nof_tasks;
+        std::unique_lock queue_lock{m_queues[this_queue]->mutex};
+        m_queues[this_queue]->tasks.emplace_front(std::move(task));
+    }
+
+    m_signal.notify_one();
+}
+
+void WorkerPool::ParallelFor(size_t count, const std::function<void(size_t, size_t)> &function)
+{
+    /* We split the range into a few chunks per thread to even out the load
+       if some threads are busy with other work. */
+    const size_t nof_chunks = std::min(count, 4 * GetConcurrency());
+    if (nof_chunks <= 1)
+    {
+        if (count > 0)
+            function(0, count);
+        return;
+    }
+
+    /* The state is shared with the helper tasks, which may outlive this call
+       if they start after every chunk has been claimed. However, they never
+       touch the `function` in that case. */
+    struct Job
+    {
+        std::atomic<size_t> next{0};
+        size_t nof_completed{0};
+        std::mutex mutex{};
+        std::condition_variable completed{};
+    };
+
+    auto job = std::make_shared<Job>();
+    const auto Run = [job, count, nof_chunks, &function]() {
+        size_t nof_completed = 0;
+        for (size_t chunk = job->next++; chunk < nof_chunks; chunk = job->next++)
+        {
+            function(chunk * count / nof_chunks, (chunk + 1) * count / nof_chunks);
+            ++nof_completed;
+        }
+
+        if (nof_completed > 0)
+        {
+            std::unique_lock lock{job->mutex};
+            job->nof_completed += nof_completed;
+            if (job->nof_completed == nof_chunks)
+                job->completed.notify_all();
+        }
+    };
+
+    const size_t nof_helpers = std::min(m_threads.size(), nof_chunks - 1);
+    for (size_t i = 0; i < nof_helpers; ++i)
+        Post(Run);
+
+    Run();
+
+    std::unique_lock lock{job->mutex};
+    job->completed.wait(lock, [&] { return job->nof_completed == nof_chunks; });
+}
+
+bool WorkerPool::TryPop(size_t index, std::function<void()> &task)
+{
+    /* Our own queue is processed newest first while we steal the oldest task
+       from the others, starting with our closest neighbor. */
+    {
+        auto &queue = *m_queues[index];
+        std::unique_lock lock{queue.mutex};
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < m_queues.size(); ++i)
+    {
+        auto &queue = *m_queues[(index + i) % m_queues.size()];
+        std::unique_lock lock{queue.mutex};
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkerPool::MainLoop(size_t index)
+{
+    this_pool = this;
+    this_queue = index;
+
+    for (;;)
+    {
+        std::function<void()> task;
+        if (TryPop(index, task))
+        {
+            {
+                std::unique_lock lock{m_mutex};
+                --m_nof_tasks;
+            }
+
+            task();
+            continue;
+        }
+
+        std::unique_lock lock{m_mutex};
+        m_signal.wait(lock, [&] { return m_should_stop || m_nof_tasks > 0; });
+        if (m_should_stop)
+            return;
+    }
+}
+
+void WorkerPool::SetAffinity(std::thread &thread, int cpu)
+{
+#if defined(_WIN32)
+    if (cpu >= static_cast<int>(8 * sizeof(DWORD_PTR)) ||
+        SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{1} << cpu) == 0)
+    {
+        Log::log->warn("Failed to set the affinity of a worker thread to core {}.", cpu);
+    }
+#else
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &cpuset);
+    if (cpu >= CPU_SETSIZE ||
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpuset), &cpuset) != 0)
+        Log::log->warn("Failed to set the affinity of a worker thread to core {}.", cpu);
+#endif
+}
+
+WorkerPool::Strand::Strand(std::shared_ptr<WorkerPool> pool)
+    : m_pool(pool)
+    , m_state(std::make_shared<State>())
+{
+}
+
+void WorkerPool::Strand::Post(std::function<void()> task)
+{
+    {
+        std::unique_lock lock{m_state->mutex};
+        m_state->tasks.emplace_back(std::move(task));
+        if (m_state->is_scheduled)
+            return;
+        m_state->is_scheduled = true;
+    }
+
+    m_pool->Post([pool = m_pool.get(), state = m_state]() { Run(pool, state); });
+}
+
+void WorkerPool::Strand::Run(WorkerPool *pool, std::shared_ptr<State> state)
+{
+    /* Only one instance of this function runs per strand. We run the tasks
+       that are queued when we start and then give way to other work if more
+       tasks have arrived in the meantime. Once the queue is empty, the next
+       call to `Post` has to schedule us again. The pool outlives any task
+       running on it, so the plain pointer is safe. Without any threads, there
+       is nothing to give way to and we keep going. */
+    size_t nof_tasks = 0;
+    {
+        std::unique_lock lock{state->mutex};
+        nof_tasks = state->tasks.size();
+    }
+
+    for (;;)
+    {
+        for (size_t i = 0; i < nof_tasks; ++i)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock lock{state->mutex};
+                task = std::move(state->tasks.front());
+                state->tasks.pop_front();
+            }
+
+            task();
+        }
+
+        {
+            std::unique_lock lock{state->mutex};
+            nof_tasks = state->tasks.size();
+            if (nof_tasks == 0)
+            {
+                state->is_scheduled = false;
+                return;
+            }
+        }
+
+        if (!pool->m_threads.empty())
+        {
+            pool->Defer([pool, state]() { Run(pool, state); });
+            return;
+        }
+    }
+}
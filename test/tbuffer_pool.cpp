@@ -0,0 +1,187 @@
+#include "buffer_pool.h"
+#include "CppUTest/TestHarness.h"
+
+#include <vector>
+
+/* A buffer that counts the number of live instances. */
+struct CountedBuffer
+{
+    CountedBuffer(size_t size)
+        : data(size)
+    {
+        nof_instances++;
+    }
+
+    ~CountedBuffer()
+    {
+        nof_instances--;
+    }
+
+    std::vector<char> data;
+    static int nof_instances;
+};
+
+int CountedBuffer::nof_instances = 0;
+
+TEST_GROUP(BufferPool)
+{
+    void teardown()
+    {
+        LONGS_EQUAL(0, CountedBuffer::nof_instances);
+    }
+};
+
+TEST(BufferPool, Recycle)
+{
+    BufferPool<CountedBuffer> pool;
+
+    std::shared_ptr<CountedBuffer> buffer;
+    LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 1024, 1024));
+    LONGS_EQUAL(1024, buffer->data.size());
+    const auto *address = buffer.get();
+
+    /* Dropping the last reference returns the buffer to the pool. */
+    buffer.reset();
+    auto statistics = pool.GetStatistics();
+    LONGS_EQUAL(0, statistics.nof_hits);
+    LONGS_EQUAL(1, statistics.nof_misses);
+    LONGS_EQUAL(1, statistics.nof_buffers_held);
+    LONGS_EQUAL(1024, statistics.bytes_held);
+    LONGS_EQUAL(1, CountedBuffer::nof_instances);
+
+    /* A request of the same size gets the same buffer back, while another size
+       has to allocate a new one. */
+    LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 1024, 1024));
+    CHECK(address == buffer.get());
+
+    std::shared_ptr<CountedBuffer> other;
+    LONGS_EQUAL(SCAPE_EOK, pool.Get(other, 2048, 2048));
+    LONGS_EQUAL(2048, other->data.size());
+
+    statistics = pool.GetStatistics();
+    LONGS_EQUAL(1, statistics.nof_hits);
+    LONGS_EQUAL(2, statistics.nof_misses);
+    LONGS_EQUAL(0, statistics.bytes_held);
+
+    buffer.reset();
+    other.reset();
+    LONGS_EQUAL(3072, pool.GetStatistics().bytes_held);
+
+    pool.Clear();
+    LONGS_EQUAL(0, pool.GetStatistics().bytes_held);
+    LONGS_EQUAL(0, CountedBuffer::nof_instances);
+}
+
+TEST(BufferPool, Capacity)
+{
+    BufferPool<CountedBuffer> pool(4);
+
+    std::vector<std::shared_ptr<CountedBuffer>> buffers(6);
+    for (auto &buffer : buffers)
+        LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 1024, 1024));
+
+    /* Only four buffers are kept. */
+    buffers.clear();
+    auto statistics = pool.GetStatistics();
+    LONGS_EQUAL(4, statistics.nof_buffers_held);
+    LONGS_EQUAL(4096, statistics.bytes_held);
+    LONGS_EQUAL(2, statistics.nof_discarded);
+    LONGS_EQUAL(4, CountedBuffer::nof_instances);
+
+    /* Lowering the limit frees buffers right away. */
+    pool.SetCapacity(2);
+    statistics = pool.GetStatistics();
+    LONGS_EQUAL(2, statistics.nof_buffers_held);
+    LONGS_EQUAL(2048, statistics.bytes_held);
+    LONGS_EQUAL(2, statistics.capacity);
+    LONGS_EQUAL(2, CountedBuffer::nof_instances);
+
+    pool.SetCapacity(0);
+    LONGS_EQUAL(0, CountedBuffer::nof_instances);
+}
+
+TEST(BufferPool, StaleBuckets)
+{
+    BufferPool<CountedBuffer> pool(2);
+
+    std::vector<std::shared_ptr<CountedBuffer>> buffers(2);
+    for (auto &buffer : buffers)
+        LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 1024, 1024));
+
+    /* Return one of the buffers and keep the other one for later. */
+    buffers.pop_back();
+    LONGS_EQUAL(1024, pool.GetStatistics().bytes_held);
+
+    /* The size changes, e.g. with the record length. The old bucket is freed
+       once it hasn't been requested in the last two requests. */
+    std::shared_ptr<CountedBuffer> buffer;
+    LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 2048, 2048));
+    buffer.reset();
+    LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 2048, 2048));
+    buffer.reset();
+    LONGS_EQUAL(3072, pool.GetStatistics().bytes_held);
+
+    LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 2048, 2048));
+    buffer.reset();
+    auto statistics = pool.GetStatistics();
+    LONGS_EQUAL(1, statistics.nof_buffers_held);
+    LONGS_EQUAL(2048, statistics.bytes_held);
+    LONGS_EQUAL(2, CountedBuffer::nof_instances);
+
+    /* A buffer of the old size is freed once it's returned. */
+    buffers.clear();
+    LONGS_EQUAL(1, CountedBuffer::nof_instances);
+    LONGS_EQUAL(1, pool.GetStatistics().nof_buffers_held);
+}
+
+TEST(BufferPool, InterleavedSizes)
+{
+    /* Sizes requested in turn, e.g. by the two channels of a generator, are
+       all kept. */
+    BufferPool<CountedBuffer> pool;
+
+    std::shared_ptr<CountedBuffer> buffer;
+    for (int i = 0; i < 16; ++i)
+    {
+        LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 512, 512));
+        buffer.reset();
+        LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 64, 64));
+        buffer.reset();
+    }
+
+    const auto statistics = pool.GetStatistics();
+    LONGS_EQUAL(2, statistics.nof_misses);
+    LONGS_EQUAL(30, statistics.nof_hits);
+    LONGS_EQUAL(0, statistics.nof_discarded);
+    LONGS_EQUAL(576, statistics.bytes_held);
+}
+
+TEST(BufferPool, OutlivePool)
+{
+    /* A buffer outliving the pool is freed once it's released. */
+    std::shared_ptr<CountedBuffer> buffer;
+    {
+        BufferPool<CountedBuffer> pool;
+        LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 512, 512));
+    }
+
+    LONGS_EQUAL(1, CountedBuffer::nof_instances);
+    buffer.reset();
+    LONGS_EQUAL(0, CountedBuffer::nof_instances);
+}
+
+TEST(BufferPool, RecycleFunction)
+{
+    /* The recycle function runs as the buffer is returned to the pool. */
+    BufferPool<CountedBuffer> pool(BufferPool<CountedBuffer>::DEFAULT_CAPACITY,
+                                   [](CountedBuffer &buffer) { buffer.data.assign(buffer.data.size(), 0); });
+
+    std::shared_ptr<CountedBuffer> buffer;
+    LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 4, 4));
+    buffer->data = {1, 2, 3, 4};
+    buffer.reset();
+
+    LONGS_EQUAL(SCAPE_EOK, pool.Get(buffer, 4, 4));
+    LONGS_EQUAL(1, pool.GetStatistics().nof_hits);
+    CHECK(std::vector<char>(4, 0) == buffer->data);
+}
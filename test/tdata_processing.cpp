@@ -2,6 +2,7 @@
 #include "mock_control_unit.h"
 #include "nlohmann/json.hpp"
 
+#include <algorithm>
 #include <thread>
 #include <chrono>
 
@@ -147,3 +148,413 @@ TEST(DataProcessing, RepeatedStartStop)
         LONGS_EQUAL(ADQ_EOK, ADQ_StopDataAcquisition(&mock_control_unit, index));
     }
 }
+
+TEST(DataProcessing, ToneIdentification)
+{
+    constexpr size_t RECORD_LENGTH = 8192;
+    constexpr double FREQUENCY = 37e6;
+
+    nlohmann::json top = {
+        {
+            "top",
+            {
+                {
+                    {"amplitude", 1.0},
+                    {"frequency", FREQUENCY},
+                    {"harmonic_distortion", true},
+                    {"interleaving_distortion", false},
+                    {"noise", 0.01},
+                    {"offset", 0.0},
+                    {"phase", 0.0},
+                    {"record_length", RECORD_LENGTH},
+                    {"trigger_frequency", 20.0},
+                    {"randomize", false},
+                },
+            },
+        },
+    };
+
+    auto str = top.dump();
+    ADQ_SetParametersString(&mock_control_unit, index, str.c_str(), str.size());
+
+    LONGS_EQUAL(SCAPE_EOK, processing->Start());
+    LONGS_EQUAL(ADQ_EOK, ADQ_StartDataAcquisition(&mock_control_unit, index));
+
+    std::shared_ptr<ProcessedRecord> record = NULL;
+    LONGS_EQUAL(SCAPE_EOK, processing->WaitForBuffer(record, 1000));
+    CHECK(record != NULL);
+
+    /* The time domain statistics gathered during the conversion match the trace. */
+    const auto &time_domain = record->time_domain;
+    const auto [min, max] = std::minmax_element(time_domain->y.begin(), time_domain->y.end());
+    double mean = 0.0;
+    for (const auto &y : time_domain->y)
+        mean += y / static_cast<double>(time_domain->y.size());
+    DOUBLES_EQUAL(*max, time_domain->metrics.max.value, 1e-6);
+    DOUBLES_EQUAL(*min, time_domain->metrics.min.value, 1e-6);
+    DOUBLES_EQUAL(mean, time_domain->metrics.mean.value, 1e-6);
+    CHECK(time_domain->metrics.sdev.value > 0.0);
+
+    /* The fundamental is located to within a fraction of a bin. */
+    const auto &frequency_domain = record->frequency_domain;
+    const auto &fundamental = std::get<0>(frequency_domain->fundamental);
+    CHECK(fundamental.valid);
+    DOUBLES_EQUAL(FREQUENCY, fundamental.value, 0.1 * frequency_domain->step);
+    DOUBLES_EQUAL(0.0, std::get<1>(frequency_domain->fundamental).value, 0.5);
+
+    /* The harmonics are placed relative to the fundamental. */
+    LONGS_EQUAL(4, frequency_domain->harmonics.size());
+    for (size_t i = 0; i < frequency_domain->harmonics.size(); ++i)
+    {
+        const auto &harmonic = std::get<0>(frequency_domain->harmonics[i]);
+        DOUBLES_EQUAL((i + 2) * FREQUENCY, harmonic.value, frequency_domain->step);
+    }
+
+    CHECK(frequency_domain->AreAllMetricsValid());
+
+    LONGS_EQUAL(SCAPE_EOK, processing->Stop());
+    LONGS_EQUAL(ADQ_EOK, ADQ_StopDataAcquisition(&mock_control_unit, index));
+}
+
+TEST(DataProcessing, Welch)
+{
+    constexpr size_t RECORD_LENGTH = 16384;
+    constexpr size_t SEGMENT_LENGTH = 1024;
+    constexpr double FREQUENCY = 37e6;
+
+    nlohmann::json top = {
+        {
+            "top",
+            {
+                {
+                    {"amplitude", 1.0},
+                    {"frequency", FREQUENCY},
+                    {"harmonic_distortion", true},
+                    {"interleaving_distortion", false},
+                    {"noise", 0.01},
+                    {"offset", 0.0},
+                    {"phase", 0.0},
+                    {"record_length", RECORD_LENGTH},
+                    {"trigger_frequency", 20.0},
+                    {"randomize", false},
+                },
+            },
+        },
+    };
+
+    auto str = top.dump();
+    ADQ_SetParametersString(&mock_control_unit, index, str.c_str(), str.size());
+
+    DataProcessingParameters parameters{};
+    parameters.welch_segment_length = SEGMENT_LENGTH;
+    processing->EmplaceMessage(DataProcessingMessageId::SET_PROCESSING_PARAMETERS, parameters);
+
+    LONGS_EQUAL(SCAPE_EOK, processing->Start());
+    LONGS_EQUAL(ADQ_EOK, ADQ_StartDataAcquisition(&mock_control_unit, index));
+
+    std::shared_ptr<ProcessedRecord> record = NULL;
+    LONGS_EQUAL(SCAPE_EOK, processing->WaitForBuffer(record, 1000));
+    CHECK(record != NULL);
+
+    /* The time domain record is kept intact while the spectrum has the
+       resolution of a single segment. */
+    LONGS_EQUAL(RECORD_LENGTH, record->time_domain->y.size());
+    const auto &frequency_domain = record->frequency_domain;
+    LONGS_EQUAL(SEGMENT_LENGTH / 2 + 1, frequency_domain->y.size());
+    DOUBLES_EQUAL(static_cast<double>(SEGMENT_LENGTH), frequency_domain->size.value, 0.0);
+    DOUBLES_EQUAL(record->time_domain->sampling_frequency.value / SEGMENT_LENGTH,
+                  frequency_domain->step, 1e-6);
+
+    /* The averaged spectrum still yields the tone and its power. */
+    const auto &fundamental = std::get<0>(frequency_domain->fundamental);
+    CHECK(fundamental.valid);
+    DOUBLES_EQUAL(FREQUENCY, fundamental.value, 0.1 * frequency_domain->step);
+    DOUBLES_EQUAL(0.0, std::get<1>(frequency_domain->fundamental).value, 0.5);
+    CHECK(frequency_domain->AreAllMetricsValid());
+
+    LONGS_EQUAL(SCAPE_EOK, processing->Stop());
+    LONGS_EQUAL(ADQ_EOK, ADQ_StopDataAcquisition(&mock_control_unit, index));
+}
+
+TEST(DataProcessing, Zoom)
+{
+    constexpr size_t RECORD_LENGTH = 131072;
+    constexpr double FREQUENCY = 37e6;
+    constexpr double CENTER_FREQUENCY = 36e6;
+    constexpr double SPAN = 5e6;
+
+    nlohmann::json top = {
+        {
+            "top",
+            {
+                {
+                    {"amplitude", 1.0},
+                    {"frequency", FREQUENCY},
+                    {"harmonic_distortion", true},
+                    {"interleaving_distortion", false},
+                    {"noise", 0.01},
+                    {"offset", 0.0},
+                    {"phase", 0.0},
+                    {"record_length", RECORD_LENGTH},
+                    {"trigger_frequency", 20.0},
+                    {"randomize", false},
+                },
+            },
+        },
+    };
+
+    auto str = top.dump();
+    ADQ_SetParametersString(&mock_control_unit, index, str.c_str(), str.size());
+
+    DataProcessingParameters parameters{};
+    parameters.zoom_center_frequency = CENTER_FREQUENCY;
+    parameters.zoom_span = SPAN;
+    processing->EmplaceMessage(DataProcessingMessageId::SET_PROCESSING_PARAMETERS, parameters);
+
+    LONGS_EQUAL(SCAPE_EOK, processing->Start());
+    LONGS_EQUAL(ADQ_EOK, ADQ_StartDataAcquisition(&mock_control_unit, index));
+
+    std::shared_ptr<ProcessedRecord> record = NULL;
+    LONGS_EQUAL(SCAPE_EOK, processing->WaitForBuffer(record, 1000));
+    CHECK(record != NULL);
+
+    /* The spectrum covers the span around the center frequency with a much
+       finer resolution than a transform of the entire record. */
+    LONGS_EQUAL(RECORD_LENGTH, record->time_domain->y.size());
+    const auto &frequency_domain = record->frequency_domain;
+    const double fs = record->time_domain->sampling_frequency.value;
+    CHECK(frequency_domain->y.size() > 1);
+    CHECK(frequency_domain->step < fs / RECORD_LENGTH * 4);
+    CHECK(frequency_domain->X(0) >= CENTER_FREQUENCY - SPAN / 2);
+    CHECK(frequency_domain->BackX() <= CENTER_FREQUENCY + SPAN / 2);
+    DOUBLES_EQUAL(CENTER_FREQUENCY, (frequency_domain->X(0) + frequency_domain->BackX()) / 2,
+                  frequency_domain->step);
+
+    /* The waterfall lines up with the zoomed in spectrum. */
+    CHECK(record->waterfall != NULL);
+    DOUBLES_EQUAL(frequency_domain->X(0) - frequency_domain->step / 2, record->waterfall->x_min,
+                  1e-6);
+    CHECK(record->waterfall->x_max < CENTER_FREQUENCY + SPAN / 2 + frequency_domain->step);
+
+    /* The tone is found at its absolute frequency with the correct power. */
+    const auto &fundamental = std::get<0>(frequency_domain->fundamental);
+    CHECK(fundamental.valid);
+    DOUBLES_EQUAL(FREQUENCY, fundamental.value, 0.1 * frequency_domain->step);
+    DOUBLES_EQUAL(0.0, std::get<1>(frequency_domain->fundamental).value, 0.5);
+
+    /* The distortion metrics are outside the band. */
+    LONGS_EQUAL(4, frequency_domain->harmonics.size());
+    CHECK(!std::get<1>(frequency_domain->harmonics[0]).valid);
+    CHECK(!frequency_domain->snr.valid);
+    CHECK(frequency_domain->npsd.valid);
+    CHECK(frequency_domain->sfdr_dbc.valid);
+
+    LONGS_EQUAL(SCAPE_EOK, processing->Stop());
+    LONGS_EQUAL(ADQ_EOK, ADQ_StopDataAcquisition(&mock_control_unit, index));
+}
+
+TEST(DataProcessing, ToneTracking)
+{
+    constexpr size_t RECORD_LENGTH = 8192;
+    constexpr double FREQUENCY = 37e6;
+
+    nlohmann::json top = {
+        {
+            "top",
+            {
+                {
+                    {"amplitude", 1.0},
+                    {"frequency", FREQUENCY},
+                    {"harmonic_distortion", true},
+                    {"interleaving_distortion", false},
+                    {"noise", 0.01},
+                    {"offset", 0.0},
+                    {"phase", 0.0},
+                    {"record_length", RECORD_LENGTH},
+                    {"trigger_frequency", 20.0},
+                    {"randomize", false},
+                },
+            },
+        },
+    };
+
+    auto str = top.dump();
+    ADQ_SetParametersString(&mock_control_unit, index, str.c_str(), str.size());
+
+    /* Analyze one record with a transform and one with tone tracking. */
+    DataProcessingParameters parameters{};
+    parameters.fundamental_frequency = FREQUENCY;
+    parameters.fft_length = TransformLength::EXACT;
+
+    std::shared_ptr<ProcessedRecord> records[2] = {NULL, NULL};
+    for (auto &record : records)
+    {
+        processing->EmplaceMessage(DataProcessingMessageId::SET_PROCESSING_PARAMETERS, parameters);
+        LONGS_EQUAL(SCAPE_EOK, processing->Start());
+        LONGS_EQUAL(ADQ_EOK, ADQ_StartDataAcquisition(&mock_control_unit, index));
+        LONGS_EQUAL(SCAPE_EOK, processing->WaitForBuffer(record, 1000));
+        CHECK(record != NULL);
+        LONGS_EQUAL(SCAPE_EOK, processing->Stop());
+        LONGS_EQUAL(ADQ_EOK, ADQ_StopDataAcquisition(&mock_control_unit, index));
+        parameters.tone_tracking = true;
+    }
+
+    const auto &transform = records[0]->frequency_domain;
+    const auto &tracking = records[1]->frequency_domain;
+    CHECK(!transform->y.empty());
+    CHECK(tracking->y.empty());
+    CHECK(records[1]->waterfall == NULL);
+    LONGS_EQUAL(RECORD_LENGTH, records[1]->time_domain->y.size());
+
+    /* The tones are measured at their exact frequencies. */
+    DOUBLES_EQUAL(FREQUENCY, std::get<0>(tracking->fundamental).value, 0.0);
+    DOUBLES_EQUAL(0.0, std::get<1>(tracking->fundamental).value, 0.1);
+    LONGS_EQUAL(4, tracking->harmonics.size());
+    for (size_t i = 0; i < tracking->harmonics.size(); ++i)
+    {
+        DOUBLES_EQUAL(std::get<0>(transform->harmonics[i]).value,
+                      std::get<0>(tracking->harmonics[i]).value, transform->step);
+    }
+
+    /* The metrics agree with the ones from the transform. */
+    CHECK(tracking->AreAllMetricsValid());
+    CHECK(tracking->snr.valid);
+    CHECK(tracking->npsd.valid);
+    DOUBLES_EQUAL(transform->snr.value, tracking->snr.value, 1.0);
+    DOUBLES_EQUAL(transform->sinad.value, tracking->sinad.value, 1.0);
+    DOUBLES_EQUAL(transform->thd.value, tracking->thd.value, 1.0);
+    DOUBLES_EQUAL(transform->enob.value, tracking->enob.value, 0.2);
+    DOUBLES_EQUAL(transform->npsd.value, tracking->npsd.value, 1.0);
+}
+
+TEST(DataProcessing, RecycledRecords)
+{
+    /* Records whose memory has been recycled must not carry any state over
+       from their previous use. */
+    constexpr size_t RECORD_LENGTH = 4096;
+    constexpr double FREQUENCY = 37e6;
+    constexpr int NOF_RECORDS = 40;
+
+    nlohmann::json top = {
+        {
+            "top",
+            {
+                {
+                    {"amplitude", 1.0},
+                    {"frequency", FREQUENCY},
+                    {"harmonic_distortion", true},
+                    {"interleaving_distortion", false},
+                    {"noise", 0.01},
+                    {"offset", 0.0},
+                    {"phase", 0.0},
+                    {"record_length", RECORD_LENGTH},
+                    {"trigger_frequency", 200.0},
+                    {"randomize", false},
+                },
+            },
+        },
+    };
+
+    auto str = top.dump();
+    ADQ_SetParametersString(&mock_control_unit, index, str.c_str(), str.size());
+
+    /* Each of the four pools keeps at most two records for reuse. */
+    constexpr size_t NOF_RECYCLED_RECORDS = 2;
+    DataProcessingParameters parameters{};
+    parameters.nof_recycled_records = NOF_RECYCLED_RECORDS;
+    processing->EmplaceMessage(DataProcessingMessageId::SET_PROCESSING_PARAMETERS, parameters);
+
+    LONGS_EQUAL(SCAPE_EOK, processing->Start());
+    LONGS_EQUAL(ADQ_EOK, ADQ_StartDataAcquisition(&mock_control_unit, index));
+
+    std::shared_ptr<ProcessedRecord> record = NULL;
+    for (int i = 0; i < NOF_RECORDS; ++i)
+    {
+        record.reset();
+        LONGS_EQUAL(SCAPE_EOK, processing->WaitForBuffer(record, 1000));
+        CHECK(record != NULL);
+
+        LONGS_EQUAL(RECORD_LENGTH, record->time_domain->y.size());
+        STRCMP_EQUAL("SPD-SIM01 CHA", record->label.c_str());
+        STRCMP_EQUAL("V", record->time_domain->y_properties->unit.c_str());
+        CHECK(record->time_domain->metrics.max.properties == record->time_domain->y_properties);
+
+        const auto &frequency_domain = record->frequency_domain;
+        LONGS_EQUAL(RECORD_LENGTH / 2 + 1, frequency_domain->power.size());
+        LONGS_EQUAL(RECORD_LENGTH / 2 + 1, frequency_domain->y.size());
+        LONGS_EQUAL(4, frequency_domain->harmonics.size());
+        LONGS_EQUAL(4, frequency_domain->relative_power.harmonics.size());
+        DOUBLES_EQUAL(FREQUENCY, std::get<0>(frequency_domain->fundamental).value,
+                      0.1 * frequency_domain->step);
+        CHECK(frequency_domain->AreAllMetricsValid());
+
+        LONGS_EQUAL(DataProcessingParameters().waterfall_depth, record->waterfall->rows);
+        LONGS_EQUAL(RECORD_LENGTH / 2 + 1, record->waterfall->columns);
+        CHECK(record->waterfall_sequence >= 1);
+    }
+
+    const auto &statistics = record->recycled_records;
+    LONGS_EQUAL(4 * NOF_RECYCLED_RECORDS, statistics.capacity);
+    CHECK(statistics.nof_buffers_held <= statistics.capacity);
+    CHECK(statistics.nof_hits > 0);
+
+    LONGS_EQUAL(SCAPE_EOK, processing->Stop());
+    LONGS_EQUAL(ADQ_EOK, ADQ_StopDataAcquisition(&mock_control_unit, index));
+}
+
+TEST(DataProcessing, FullRateMetrics)
+{
+    /* With the outbound queue full, the records are still analyzed but only
+       the ones that fit in the queue are shown. */
+    constexpr size_t RECORD_LENGTH = 1024;
+    constexpr size_t CAPACITY = 100;
+
+    nlohmann::json top = {
+        {
+            "top",
+            {
+                {
+                    {"amplitude", 1.0},
+                    {"frequency", 37e6},
+                    {"harmonic_distortion", true},
+                    {"interleaving_distortion", false},
+                    {"noise", 0.01},
+                    {"offset", 0.0},
+                    {"phase", 0.0},
+                    {"record_length", RECORD_LENGTH},
+                    {"trigger_frequency", 2000.0},
+                    {"randomize", false},
+                },
+            },
+        },
+    };
+
+    auto str = top.dump();
+    ADQ_SetParametersString(&mock_control_unit, index, str.c_str(), str.size());
+
+    DataProcessingParameters parameters{};
+    parameters.full_rate_metrics = true;
+    processing->EmplaceMessage(DataProcessingMessageId::SET_PROCESSING_PARAMETERS, parameters);
+
+    LONGS_EQUAL(SCAPE_EOK, processing->Start());
+    LONGS_EQUAL(ADQ_EOK, ADQ_StartDataAcquisition(&mock_control_unit, index));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    std::shared_ptr<ProcessedRecord> record = NULL;
+    for (size_t i = 0; i < CAPACITY; ++i)
+    {
+        LONGS_EQUAL(SCAPE_EOK, processing->WaitForBuffer(record, 1000));
+        CHECK(record != NULL);
+    }
+
+    /* The statistics include the records analyzed while the queue was full,
+       whereas the waterfall only holds the records that were shown. */
+    LONGS_EQUAL(SCAPE_EOK, processing->WaitForBuffer(record, 1000));
+    CHECK(record != NULL);
+    LONGS_EQUAL(RECORD_LENGTH, record->time_domain->y.size());
+    CHECK(record->time_domain->metrics.max.Count() > CAPACITY + 1);
+    LONGS_EQUAL(CAPACITY + 1, record->waterfall_sequence);
+
+    LONGS_EQUAL(SCAPE_EOK, processing->Stop());
+    LONGS_EQUAL(ADQ_EOK, ADQ_StopDataAcquisition(&mock_control_unit, index));
+}
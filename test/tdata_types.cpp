@@ -0,0 +1,111 @@
+#include "data_types.h"
+#include "CppUTest/TestHarness.h"
+
+#include <vector>
+
+TEST_GROUP(BaseRecord)
+{
+    static constexpr size_t RECORD_LENGTH = 16;
+    std::vector<int16_t> data{};
+    ADQGen4RecordHeader header{};
+    ADQAnalogFrontendParametersChannel afe{};
+    TimeDomainRecord record{RECORD_LENGTH};
+
+    void setup() override
+    {
+        data.resize(RECORD_LENGTH);
+        for (size_t i = 0; i < RECORD_LENGTH; ++i)
+            data[i] = static_cast<int16_t>(100 * i);
+
+        /* 200 ps between samples and the record starts 16 samples before the
+           trigger, i.e. at -3.2 ns. */
+        header.record_length = RECORD_LENGTH;
+        header.data_format = ADQ_DATA_FORMAT_INT16;
+        header.time_unit = 25e-12;
+        header.sampling_period = 8;
+        header.record_start = -128;
+        afe.input_range = 1000.0;
+        afe.dc_offset = 0.0;
+    }
+};
+
+TEST(BaseRecord, ConvertedAxis)
+{
+    record.Convert(header, data.data(), afe, 65536.0, true, true);
+    DOUBLES_EQUAL(-3.2e-9, record.start, 1e-15);
+    DOUBLES_EQUAL(200e-12, record.step, 1e-15);
+    DOUBLES_EQUAL(-3.2e-9, record.X(0), 1e-15);
+    DOUBLES_EQUAL(-3.0e-9, record.X(1), 1e-15);
+    DOUBLES_EQUAL(-0.2e-9, record.BackX(), 1e-15);
+
+    const auto x = record.MaterializeX();
+    LONGS_EQUAL(RECORD_LENGTH, x.size());
+    for (size_t i = 0; i < x.size(); ++i)
+        DOUBLES_EQUAL(record.X(i), x[i], 0.0);
+
+    /* Snap to the closest sample, clamping to either end. */
+    LONGS_EQUAL(0, record.ClosestIndex(-1.0));
+    LONGS_EQUAL(0, record.ClosestIndex(-3.2e-9));
+    LONGS_EQUAL(0, record.ClosestIndex(-3.11e-9));
+    LONGS_EQUAL(1, record.ClosestIndex(-3.09e-9));
+    LONGS_EQUAL(5, record.ClosestIndex(record.X(5) + 20e-12));
+    LONGS_EQUAL(RECORD_LENGTH - 1, record.ClosestIndex(record.BackX()));
+    LONGS_EQUAL(RECORD_LENGTH - 1, record.ClosestIndex(1.0));
+
+    /* Snap to the closest point as seen in a view of the whole record. */
+    size_t index = RECORD_LENGTH;
+    const double y_min = record.y.front();
+    const double y_max = record.y.back();
+    CHECK_TRUE(record.ClosestIndex(record.X(5), record.y[5], record.X(0), record.BackX(), y_min,
+                                   y_max, index));
+    LONGS_EQUAL(5, index);
+    CHECK_TRUE(record.ClosestIndex(1.0, y_max, record.X(0), record.BackX(), y_min, y_max, index));
+    LONGS_EQUAL(RECORD_LENGTH - 1, index);
+}
+
+TEST(BaseRecord, UnconvertedAxis)
+{
+    /* Without a conversion, the axis counts samples from zero. */
+    record.Convert(header, data.data(), afe, 65536.0, false, false);
+    DOUBLES_EQUAL(0.0, record.start, 0.0);
+    DOUBLES_EQUAL(1.0, record.step, 0.0);
+    DOUBLES_EQUAL(3.0, record.X(3), 0.0);
+    DOUBLES_EQUAL(static_cast<double>(RECORD_LENGTH - 1), record.BackX(), 0.0);
+
+    const auto x = record.MaterializeX();
+    LONGS_EQUAL(RECORD_LENGTH, x.size());
+    DOUBLES_EQUAL(static_cast<double>(RECORD_LENGTH - 1), x.back(), 0.0);
+
+    LONGS_EQUAL(0, record.ClosestIndex(-5.0));
+    LONGS_EQUAL(2, record.ClosestIndex(2.4));
+    LONGS_EQUAL(3, record.ClosestIndex(2.6));
+    LONGS_EQUAL(RECORD_LENGTH - 1, record.ClosestIndex(14.7));
+    LONGS_EQUAL(RECORD_LENGTH - 1, record.ClosestIndex(1e30));
+}
+
+TEST(BaseRecord, Empty)
+{
+    /* Without a trace, the axis collapses onto its start. */
+    record.Convert(header, data.data(), afe, 65536.0, true, true, NULL, 0, NULL, false);
+    LONGS_EQUAL(0, record.y.size());
+    DOUBLES_EQUAL(record.start, record.BackX(), 0.0);
+    LONGS_EQUAL(0, record.MaterializeX().size());
+    LONGS_EQUAL(0, record.ClosestIndex(0.0));
+
+    size_t index = RECORD_LENGTH;
+    CHECK_FALSE(record.ClosestIndex(0.0, 0.0, -1.0, 1.0, -1.0, 1.0, index));
+    LONGS_EQUAL(RECORD_LENGTH, index);
+}
+
+TEST(BaseRecord, EmptySpectrum)
+{
+    /* A spectrum is empty while tracking tones. There's no sample to snap to,
+       so the index is left untouched. */
+    FrequencyDomainRecord spectrum{RECORD_LENGTH};
+    spectrum.Reset(0);
+    LONGS_EQUAL(0, spectrum.y.size());
+
+    size_t index = RECORD_LENGTH;
+    CHECK_FALSE(spectrum.ClosestIndex(1e6, -50.0, 0.0, 2e6, -100.0, 0.0, index));
+    LONGS_EQUAL(RECORD_LENGTH, index);
+}
@@ -0,0 +1,176 @@
+#include "downconverter.h"
+#include "error.h"
+#include "CppUTest/TestHarness.h"
+
+#include <cmath>
+
+TEST_GROUP(Downconverter)
+{
+    static constexpr double SAMPLING_FREQUENCY = 1e9;
+    static constexpr double CENTER_FREQUENCY = 200e6;
+    static constexpr double SPAN = 10e6;
+    Downconverter downconverter;
+
+    static std::vector<double> Sine(size_t length, double frequency)
+    {
+        const double PI = std::acos(-1.0);
+        std::vector<double> x(length);
+        for (size_t n = 0; n < length; ++n)
+            x[n] = std::cos(2 * PI * frequency * static_cast<double>(n) / SAMPLING_FREQUENCY);
+        return x;
+    }
+};
+
+TEST(Downconverter, Configure)
+{
+    LONGS_EQUAL(SCAPE_EINVAL, downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, 0.0));
+    LONGS_EQUAL(SCAPE_EINVAL, downconverter.Configure(0.0, CENTER_FREQUENCY, SPAN));
+    LONGS_EQUAL(SCAPE_EINVAL, downconverter.Configure(SAMPLING_FREQUENCY, 1e6, SPAN));
+    LONGS_EQUAL(SCAPE_EINVAL, downconverter.Configure(SAMPLING_FREQUENCY, 499e6, SPAN));
+    LONGS_EQUAL(0, downconverter.OutputLength(1024));
+
+    LONGS_EQUAL(SCAPE_EOK, downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, SPAN));
+    LONGS_EQUAL(80, downconverter.Decimation());
+    DOUBLES_EQUAL(12.5e6, downconverter.OutputSamplingFrequency(), 1e-6);
+
+    const size_t length = downconverter.Length();
+    LONGS_EQUAL(0, downconverter.OutputLength(length - 1));
+    LONGS_EQUAL(1, downconverter.OutputLength(length));
+    LONGS_EQUAL(11, downconverter.OutputLength(length + 10 * 80));
+
+    /* The filters have to fit in the record and a vanishing span is rejected
+       before anything is allocated. */
+    LONGS_EQUAL(SCAPE_EINVAL,
+                downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, SPAN, length - 1));
+    LONGS_EQUAL(0, downconverter.Length());
+    LONGS_EQUAL(0, downconverter.Taps());
+    LONGS_EQUAL(SCAPE_EINVAL, downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, 1.0));
+    LONGS_EQUAL(SCAPE_EOK,
+                downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, SPAN, length + 1));
+    LONGS_EQUAL(length, downconverter.Length());
+}
+
+TEST(Downconverter, Stages)
+{
+    /* A small decimation factor is handled by a single filter. */
+    LONGS_EQUAL(SCAPE_EOK, downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, 150e6));
+    LONGS_EQUAL(5, downconverter.Decimation());
+    LONGS_EQUAL(1, downconverter.Stages());
+
+    /* D = 80 = 2^4 * 5 */
+    LONGS_EQUAL(SCAPE_EOK, downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, SPAN));
+    LONGS_EQUAL(5, downconverter.Stages());
+    const double work = downconverter.MultiplyAddsPerSample();
+
+    /* A single filter for D = 80 would need 5.5 / (0.2 / 80) = 2200 taps,
+       i.e. 55 complex multiply-adds per input sample. */
+    CHECK(downconverter.Taps() < 250);
+    CHECK(work < 25.0);
+
+    /* The decimation factor is rounded down to 2^S R with R in [4, 8). The
+       number of taps stays bounded and the work per input sample goes down
+       as the decimation factor goes up. */
+    LONGS_EQUAL(SCAPE_EOK, downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, 100e3));
+    LONGS_EQUAL(1024 * 7, downconverter.Decimation());
+    LONGS_EQUAL(11, downconverter.Stages());
+    CHECK(downconverter.Taps() < 250);
+    CHECK(downconverter.MultiplyAddsPerSample() < work);
+    CHECK(downconverter.MultiplyAddsPerSample() < 15.0);
+    CHECK(downconverter.OutputSamplingFrequency() >= 1.25 * 100e3);
+}
+
+TEST(Downconverter, InBand)
+{
+    /* A tone inside the band shows up at the offset from the center frequency
+       with half its amplitude. */
+    const double PI = std::acos(-1.0);
+    const double OFFSET = 2e6;
+    LONGS_EQUAL(SCAPE_EOK, downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, SPAN));
+
+    const auto x = Sine(65536, CENTER_FREQUENCY + OFFSET);
+    std::vector<std::complex<double>> y;
+    downconverter.Process(x.data(), x.size(), y);
+    LONGS_EQUAL(downconverter.OutputLength(x.size()), y.size());
+    CHECK(y.size() > 100);
+
+    const double phase_step = 2 * PI * OFFSET / downconverter.OutputSamplingFrequency();
+    for (size_t m = 0; m < y.size(); ++m)
+    {
+        DOUBLES_EQUAL(0.5, std::abs(y[m]), 1e-3);
+        if (m > 0)
+        {
+            const double phase = std::arg(y[m] * std::conj(y[m - 1]));
+            DOUBLES_EQUAL(phase_step, phase, 1e-3);
+        }
+    }
+}
+
+TEST(Downconverter, Alias)
+{
+    /* A tone that would alias onto the center frequency is suppressed. */
+    LONGS_EQUAL(SCAPE_EOK, downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, SPAN));
+
+    const auto x = Sine(65536, CENTER_FREQUENCY + downconverter.OutputSamplingFrequency());
+    std::vector<std::complex<double>> y;
+    downconverter.Process(x.data(), x.size(), y);
+    for (const auto &value : y)
+        CHECK(std::abs(value) < 0.5e-3);
+}
+
+TEST(Downconverter, Parallel)
+{
+    LONGS_EQUAL(SCAPE_EOK, downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, SPAN));
+
+    WorkerPool pool(3);
+    const auto x = Sine(65536, CENTER_FREQUENCY - 3e6);
+    std::vector<std::complex<double>> serial;
+    std::vector<std::complex<double>> parallel;
+    downconverter.Process(x.data(), x.size(), serial);
+    downconverter.Process(x.data(), x.size(), parallel, &pool);
+
+    LONGS_EQUAL(serial.size(), parallel.size());
+    for (size_t m = 0; m < serial.size(); ++m)
+    {
+        DOUBLES_EQUAL(serial[m].real(), parallel[m].real(), 0.0);
+        DOUBLES_EQUAL(serial[m].imag(), parallel[m].imag(), 0.0);
+    }
+}
+
+TEST(Downconverter, LargeDecimation)
+{
+    /* A tone inside a narrow band passes the cascade of filters while one
+       that would alias onto the center frequency is suppressed. */
+    const double PI = std::acos(-1.0);
+    const double NARROW_SPAN = 100e3;
+    const double OFFSET = 20e3;
+    LONGS_EQUAL(SCAPE_EOK,
+                downconverter.Configure(SAMPLING_FREQUENCY, CENTER_FREQUENCY, NARROW_SPAN));
+
+    const size_t length = downconverter.Length() + 64 * downconverter.Decimation();
+    auto x = Sine(length, CENTER_FREQUENCY + OFFSET);
+    std::vector<std::complex<double>> y;
+    downconverter.Process(x.data(), x.size(), y);
+    LONGS_EQUAL(65, y.size());
+
+    const double phase_step = 2 * PI * OFFSET / downconverter.OutputSamplingFrequency();
+    for (size_t m = 0; m < y.size(); ++m)
+    {
+        DOUBLES_EQUAL(0.5, std::abs(y[m]), 1e-3);
+        if (m > 0)
+        {
+            const double phase = std::arg(y[m] * std::conj(y[m - 1]));
+            DOUBLES_EQUAL(phase_step, phase, 1e-3);
+        }
+    }
+
+    for (const double f : {CENTER_FREQUENCY + downconverter.OutputSamplingFrequency(),
+                           CENTER_FREQUENCY - downconverter.OutputSamplingFrequency(),
+                           CENTER_FREQUENCY + 16 * downconverter.OutputSamplingFrequency(),
+                           CENTER_FREQUENCY + 3e6, 0.0})
+    {
+        x = Sine(length, f);
+        downconverter.Process(x.data(), x.size(), y);
+        for (const auto &value : y)
+            CHECK(std::abs(value) < 0.5e-3);
+    }
+}
@@ -0,0 +1,141 @@
+#include "event_loop.h"
+#include "error.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include "CppUTest/TestHarness.h"
+
+TEST_GROUP(EventLoop)
+{
+    EventLoop loop;
+};
+
+TEST(EventLoop, Timer)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    Event fired{};
+    std::atomic_int count{0};
+    uint64_t id = 0;
+    LONGS_EQUAL(SCAPE_EOK, loop.AddTimer([&]() { count++; fired.Set(); }, id));
+
+    /* Disarmed until set. */
+    CHECK_FALSE(fired.WaitUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(50)));
+
+    LONGS_EQUAL(SCAPE_EOK, loop.SetTimer(id, 100));
+    CHECK_TRUE(fired.WaitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(2)));
+    auto stop = std::chrono::high_resolution_clock::now();
+    CHECK(std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() >= 150);
+
+    /* A one-shot timer doesn't fire again. */
+    CHECK_FALSE(fired.WaitUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(150)));
+    LONGS_EQUAL(1, count);
+
+    /* Periodic */
+    LONGS_EQUAL(SCAPE_EOK, loop.SetTimer(id, 0, 20));
+    for (int i = 0; i < 3; ++i)
+        CHECK_TRUE(fired.WaitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(2)));
+    LONGS_EQUAL(SCAPE_EOK, loop.Remove(id));
+    CHECK(count >= 4);
+
+    LONGS_EQUAL(SCAPE_EINVAL, loop.SetTimer(id, 0));
+    LONGS_EQUAL(SCAPE_EINVAL, loop.Remove(id));
+}
+
+TEST(EventLoop, Signal)
+{
+    Event fired{};
+    std::atomic_int count{0};
+    uint64_t id = 0;
+    LONGS_EQUAL(SCAPE_EOK, loop.AddSignal([&]() { count++; fired.Set(); }, id));
+
+    for (int i = 0; i < 10; ++i)
+    {
+        LONGS_EQUAL(SCAPE_EOK, loop.Signal(id));
+        CHECK_TRUE(fired.WaitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(2)));
+    }
+    LONGS_EQUAL(10, count);
+    LONGS_EQUAL(SCAPE_EOK, loop.Remove(id));
+    LONGS_EQUAL(SCAPE_EINVAL, loop.Signal(id));
+}
+
+TEST(EventLoop, SignalEvent)
+{
+    auto signal = std::make_shared<EventLoopSignal>(loop);
+    std::atomic_int count{0};
+    Event fired{};
+
+    /* Inert until connected. */
+    signal->Set();
+    LONGS_EQUAL(SCAPE_EOK, signal->Connect([&]() { count++; fired.Set(); }));
+    LONGS_EQUAL(SCAPE_ENOTREADY, signal->Connect([]() {}));
+    CHECK_FALSE(fired.WaitUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(50)));
+
+    signal->Set();
+    CHECK_TRUE(fired.WaitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(2)));
+    LONGS_EQUAL(SCAPE_EOK, signal->Disconnect());
+    LONGS_EQUAL(SCAPE_ENOTREADY, signal->Disconnect());
+    LONGS_EQUAL(1, count);
+}
+
+TEST(EventLoop, Descriptor)
+{
+    int fds[2];
+    LONGS_EQUAL(0, pipe(fds));
+
+    Event fired{};
+    std::atomic_int count{0};
+    uint64_t id = 0;
+    LONGS_EQUAL(SCAPE_EOK, loop.AddDescriptor(fds[0], [&]() {
+        char c;
+        while (read(fds[0], &c, 1) == 1 && c != '\n')
+            count++;
+        fired.Set();
+    }, id));
+
+    LONGS_EQUAL(4, write(fds[1], "abc\n", 4));
+    CHECK_TRUE(fired.WaitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(2)));
+    LONGS_EQUAL(3, count);
+
+    LONGS_EQUAL(SCAPE_EOK, loop.Remove(id));
+    LONGS_EQUAL(2, write(fds[1], "d\n", 2));
+    CHECK_FALSE(fired.WaitUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
+    LONGS_EQUAL(3, count);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(EventLoop, RemoveWaitsForHandler)
+{
+    Event entered{};
+    std::atomic_bool is_done{false};
+    uint64_t id = 0;
+    LONGS_EQUAL(SCAPE_EOK, loop.AddSignal([&]() {
+        entered.Set();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        is_done = true;
+    }, id));
+
+    LONGS_EQUAL(SCAPE_EOK, loop.Signal(id));
+    CHECK_TRUE(entered.WaitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(2)));
+    LONGS_EQUAL(SCAPE_EOK, loop.Remove(id));
+    CHECK_TRUE(is_done);
+}
+
+TEST(EventLoop, HandlerRemovesItself)
+{
+    Event fired{};
+    uint64_t id = 0;
+    uint64_t other = 0;
+    LONGS_EQUAL(SCAPE_EOK, loop.AddTimer([&]() { fired.Set(); }, other));
+    LONGS_EQUAL(SCAPE_EOK, loop.AddSignal([&]() {
+        loop.Remove(id);
+        loop.SetTimer(other, 0);
+    }, id));
+
+    LONGS_EQUAL(SCAPE_EOK, loop.Signal(id));
+    CHECK_TRUE(fired.WaitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(2)));
+    LONGS_EQUAL(SCAPE_EINVAL, loop.Signal(id));
+    LONGS_EQUAL(SCAPE_EOK, loop.Remove(other));
+}
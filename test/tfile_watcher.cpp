@@ -95,3 +95,38 @@ TEST(FileWatcher, WriteToFile)
 
     LONGS_EQUAL(SCAPE_EOK, watcher.Stop());
 }
+
+TEST(FileWatcher, RenameIntoPlace)
+{
+    /* Editors often save by writing a temporary file and renaming it over the
+       original. We expect a single update with the new contents. */
+    const std::filesystem::path PATH = "./foo.txt";
+    const std::filesystem::path TEMPORARY = "./foo.txt.swp";
+    std::filesystem::remove(PATH);
+    {
+        std::ofstream ofs(PATH, std::ios::out);
+        ofs << "Old contents.";
+    }
+
+    FileWatcher watcher(PATH);
+    LONGS_EQUAL(SCAPE_EOK, watcher.Start());
+
+    FileWatcherMessage message;
+    LONGS_EQUAL(SCAPE_EOK, watcher.WaitForMessage(message, 300));
+    LONGS_EQUAL(FileWatcherMessageId::FILE_CREATED, message.id);
+    STRCMP_EQUAL("Old contents.", message.contents->c_str());
+
+    {
+        std::ofstream ofs(TEMPORARY, std::ios::out);
+        ofs << "New contents.";
+    }
+    std::filesystem::rename(TEMPORARY, PATH);
+
+    LONGS_EQUAL(SCAPE_EOK, watcher.WaitForMessage(message, 300));
+    LONGS_EQUAL(FileWatcherMessageId::FILE_UPDATED, message.id);
+    STRCMP_EQUAL("New contents.", message.contents->c_str());
+    LONGS_EQUAL(SCAPE_EAGAIN, watcher.WaitForMessage(message, 300));
+
+    LONGS_EQUAL(SCAPE_EOK, watcher.Stop());
+    std::filesystem::remove(PATH);
+}
@@ -0,0 +1,171 @@
+#include "fourier_transform.h"
+#include "error.h"
+#include "CppUTest/TestHarness.h"
+
+#include <cmath>
+#include <random>
+
+TEST_GROUP(FourierTransform)
+{
+    FourierTransformCache cache;
+    std::default_random_engine generator{1234};
+    std::uniform_real_distribution<double> distribution{-1.0, 1.0};
+
+    std::vector<double> Random(size_t length)
+    {
+        std::vector<double> x(length);
+        for (auto &v : x)
+            v = distribution(generator);
+        return x;
+    }
+
+    /* Straightforward evaluation of the DFT to compare against. */
+    static std::vector<std::complex<double>> Reference(const std::vector<double> &x)
+    {
+        const size_t N = x.size();
+        std::vector<std::complex<double>> y(N / 2 + 1);
+        for (size_t k = 0; k < y.size(); ++k)
+        {
+            for (size_t n = 0; n < N; ++n)
+            {
+                const double phase = -2.0 * M_PI * static_cast<double>((k * n) % N) / N;
+                y[k] += x[n] * std::complex<double>(std::cos(phase), std::sin(phase));
+            }
+        }
+        return y;
+    }
+
+    void CheckTransform(size_t length)
+    {
+        const auto x = Random(length);
+        const auto expected = Reference(x);
+        std::vector<std::complex<double>> y(length / 2 + 1);
+
+        const auto plan = cache.GetPlan(length);
+        CHECK(plan != NULL);
+        LONGS_EQUAL(length, plan->Length());
+        LONGS_EQUAL(SCAPE_EOK, plan->Forward(x, y));
+
+        const double tolerance = 1e-9 * static_cast<double>(length);
+        for (size_t k = 0; k < y.size(); ++k)
+        {
+            DOUBLES_EQUAL(expected[k].real(), y[k].real(), tolerance);
+            DOUBLES_EQUAL(expected[k].imag(), y[k].imag(), tolerance);
+        }
+    }
+};
+
+TEST(FourierTransform, PowersOfTwo)
+{
+    for (size_t length = 2; length <= 4096; length *= 2)
+        CheckTransform(length);
+}
+
+TEST(FourierTransform, MixedRadix)
+{
+    for (const size_t length : {6, 10, 12, 15, 30, 48, 90, 100, 360, 750, 1000, 1536, 3000})
+        CheckTransform(length);
+}
+
+TEST(FourierTransform, Bluestein)
+{
+    /* Lengths with prime factors other than 2, 3 and 5, both even and odd. */
+    for (const size_t length : {7, 14, 22, 97, 194, 210, 1022, 1023, 2002})
+        CheckTransform(length);
+}
+
+TEST(FourierTransform, OddLengths)
+{
+    for (const size_t length : {3, 5, 9, 15, 25, 45, 135, 625})
+        CheckTransform(length);
+}
+
+TEST(FourierTransform, FastLengths)
+{
+    CHECK(ComplexFourierTransform::IsFast(1));
+    CHECK(ComplexFourierTransform::IsFast(1024));
+    CHECK(ComplexFourierTransform::IsFast(1500000));
+    CHECK_FALSE(ComplexFourierTransform::IsFast(0));
+    CHECK_FALSE(ComplexFourierTransform::IsFast(7));
+    CHECK_FALSE(ComplexFourierTransform::IsFast(1022));
+
+    LONGS_EQUAL(1024, ComplexFourierTransform::NextFastLength(1021));
+    LONGS_EQUAL(1000, ComplexFourierTransform::PreviousFastLength(1021));
+    LONGS_EQUAL(1500000, ComplexFourierTransform::NextFastLength(1500000));
+    LONGS_EQUAL(1500000, ComplexFourierTransform::PreviousFastLength(1500000));
+}
+
+TEST(FourierTransform, Sine)
+{
+    /* A coherently sampled sine wave should put all its energy in one bin. */
+    constexpr size_t LENGTH = 1 << 16;
+    constexpr size_t BIN = 1031;
+    std::vector<double> x(LENGTH);
+    for (size_t i = 0; i < LENGTH; ++i)
+        x[i] = std::sin(2.0 * M_PI * BIN * static_cast<double>(i) / LENGTH);
+
+    std::vector<std::complex<double>> y(LENGTH / 2 + 1);
+    LONGS_EQUAL(SCAPE_EOK, cache.GetPlan(LENGTH)->Forward(x, y));
+
+    for (size_t k = 0; k < y.size(); ++k)
+    {
+        const double expected = (k == BIN) ? LENGTH / 2.0 : 0.0;
+        DOUBLES_EQUAL(expected, std::abs(y[k]), 1e-6);
+    }
+}
+
+TEST(FourierTransform, Cache)
+{
+    const auto plan = cache.GetPlan(1024);
+    CHECK(plan != NULL);
+    CHECK(plan == cache.GetPlan(1024));
+    CHECK(plan != cache.GetPlan(2048));
+
+    /* Only the plan for the most recent length is kept. */
+    LONGS_EQUAL(1, plan.use_count());
+    CHECK(plan != cache.GetPlan(1024));
+
+    CHECK(cache.GetPlan(0) == NULL);
+    CHECK(cache.GetPlan(1) == NULL);
+    CHECK(cache.GetPlan(1000) != NULL);
+    CHECK(cache.GetPlan(1021) != NULL);
+
+    /* The buffers must be large enough. */
+    std::vector<double> x(1024);
+    std::vector<std::complex<double>> y(512);
+    LONGS_EQUAL(SCAPE_EINVAL, plan->Forward(x, y));
+}
+
+TEST(FourierTransform, Parallel)
+{
+    /* The parallel transforms must agree with the serial transforms. We use a
+       pool with a few threads regardless of the number of cores. */
+    const auto pool = std::make_shared<WorkerPool>(3);
+    FourierTransformCache parallel_cache;
+    parallel_cache.SetParallel(pool, 16);
+
+    for (const size_t length : {16, 18, 30, 250, 1024, 3000, 7, 22, 97, 1022, 1023, 65536, 65538})
+    {
+        const auto x = Random(length);
+        std::vector<std::complex<double>> expected(length / 2 + 1);
+        std::vector<std::complex<double>> y(length / 2 + 1);
+
+        const auto plan = parallel_cache.GetPlan(length);
+        CHECK(plan != NULL);
+        CHECK(plan->IsParallel() || length < 32);
+        LONGS_EQUAL(SCAPE_EOK, plan->Forward(x, y));
+        LONGS_EQUAL(SCAPE_EOK, cache.GetPlan(length)->Forward(x, expected));
+
+        const double tolerance = 1e-12 * static_cast<double>(length);
+        for (size_t k = 0; k < y.size(); ++k)
+        {
+            DOUBLES_EQUAL(expected[k].real(), y[k].real(), tolerance);
+            DOUBLES_EQUAL(expected[k].imag(), y[k].imag(), tolerance);
+        }
+    }
+
+    /* Lengths below the threshold are transformed serially. */
+    CHECK_FALSE(parallel_cache.GetPlan(8)->IsParallel());
+    parallel_cache.SetParallel(pool, 0);
+    CHECK_FALSE(parallel_cache.GetPlan(1024)->IsParallel());
+}
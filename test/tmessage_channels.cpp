@@ -12,6 +12,9 @@ struct TestMessage
 class TestChannels : public MessageChannels<TestMessage>
 {
 public:
+    using MessageChannels<TestMessage>::_SetMessageEvent;
+    using MessageChannels<TestMessage>::_EmplaceMessage;
+
     /* Make public for testing purposes. */
     int _WaitForMessage(TestMessage &message, int timeout, uint32_t &id)
     {
@@ -70,3 +73,36 @@ TEST(MessageChannels, StampedMessages)
                     return count == NOF_THREADS;
                 }));
 }
+
+TEST(MessageChannels, Event)
+{
+    /* The events are set by messages passing in their respective direction. */
+    auto inbound = std::make_shared<Event>();
+    auto outbound = std::make_shared<Event>();
+    channels._SetMessageEvent(inbound);
+    channels.SetMessageEvent(outbound);
+
+    const auto Poll = [](Event &event) {
+        return event.WaitUntil(std::chrono::steady_clock::now());
+    };
+
+    CHECK(!Poll(*inbound));
+    CHECK(!Poll(*outbound));
+
+    LONGS_EQUAL(SCAPE_EOK, channels.PushMessage({1}));
+    CHECK(Poll(*inbound));
+    CHECK(!Poll(*inbound));
+    CHECK(!Poll(*outbound));
+
+    LONGS_EQUAL(SCAPE_EOK, channels._EmplaceMessage(TestMessage{2}));
+    CHECK(Poll(*outbound));
+    CHECK(!Poll(*inbound));
+
+    /* A thread waiting on the event is woken up by a message. */
+    std::thread pusher([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        channels.PushMessage({3});
+    });
+    CHECK(inbound->WaitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(5)));
+    pusher.join();
+}
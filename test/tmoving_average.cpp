@@ -0,0 +1,177 @@
+#include "data_types.h"
+#include "CppUTest/TestHarness.h"
+
+#include <random>
+
+TEST_GROUP(MovingAverage)
+{
+    MovingAverage average;
+
+    /* Insert a spectrum of `size` bins where every bin has the `value`,
+       returning the average in bin zero. */
+    double Insert(size_t size, double value)
+    {
+        double result = 0.0;
+        average.PrepareNewEntry(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            const double y = average.InsertAndAverage(i, value);
+            if (i == 0)
+                result = y;
+        }
+        return result;
+    }
+};
+
+TEST(MovingAverage, Boxcar)
+{
+    average.SetNumberOfAverages(3);
+    DOUBLES_EQUAL(1.0, Insert(8, 1.0), 1e-12);
+    DOUBLES_EQUAL(1.5, Insert(8, 2.0), 1e-12);
+    DOUBLES_EQUAL(2.0, Insert(8, 3.0), 1e-12);
+    DOUBLES_EQUAL(3.0, Insert(8, 4.0), 1e-12);
+    DOUBLES_EQUAL(4.0, Insert(8, 5.0), 1e-12);
+}
+
+TEST(MovingAverage, SingleEntry)
+{
+    DOUBLES_EQUAL(1.0, Insert(8, 1.0), 1e-12);
+    DOUBLES_EQUAL(2.0, Insert(8, 2.0), 1e-12);
+}
+
+TEST(MovingAverage, RepeatedInsert)
+{
+    /* Inserting the same bin twice in an entry must not count it twice. */
+    average.SetNumberOfAverages(2);
+    Insert(4, 1.0);
+    average.PrepareNewEntry(4);
+    DOUBLES_EQUAL(2.0, average.InsertAndAverage(0, 3.0), 1e-12);
+    DOUBLES_EQUAL(2.0, average.InsertAndAverage(0, 3.0), 1e-12);
+}
+
+TEST(MovingAverage, SizeChange)
+{
+    /* A change of size restarts the averaging. */
+    average.SetNumberOfAverages(4);
+    Insert(8, 1.0);
+    Insert(8, 2.0);
+    DOUBLES_EQUAL(5.0, Insert(16, 5.0), 1e-12);
+    DOUBLES_EQUAL(6.0, Insert(16, 7.0), 1e-12);
+}
+
+TEST(MovingAverage, Clear)
+{
+    average.SetNumberOfAverages(4);
+    Insert(8, 1.0);
+    Insert(8, 2.0);
+    average.Clear();
+    DOUBLES_EQUAL(7.0, Insert(8, 7.0), 1e-12);
+
+    /* Changing the number of averages also clears the log. */
+    average.SetNumberOfAverages(2);
+    DOUBLES_EQUAL(3.0, Insert(8, 3.0), 1e-12);
+
+    /* Releasing the memory leaves the average usable. */
+    average.Release();
+    DOUBLES_EQUAL(4.0, Insert(8, 4.0), 1e-12);
+    DOUBLES_EQUAL(5.0, Insert(8, 6.0), 1e-12);
+}
+
+TEST(MovingAverage, DynamicRange)
+{
+    /* Values spanning many orders of magnitude must not leave a residue in the
+       running sum once the large values have left the log. */
+    constexpr size_t NOF_AVERAGES = 5;
+    average.SetNumberOfAverages(NOF_AVERAGES);
+
+    std::default_random_engine generator{1234};
+    std::uniform_real_distribution<double> distribution{0.0, 1.0};
+    for (int i = 0; i < 100; ++i)
+        Insert(1, 1e6 * distribution(generator));
+
+    double result = 0.0;
+    for (size_t i = 0; i < NOF_AVERAGES; ++i)
+        result = Insert(1, 1e-12);
+
+    DOUBLES_EQUAL(1e-12, result, 1e-18);
+}
+
+TEST(MovingAverage, LongRun)
+{
+    /* The running sum is only ever updated, so the compensation has to hold
+       up over many revolutions of the log. */
+    constexpr size_t NOF_AVERAGES = 7;
+    average.SetNumberOfAverages(NOF_AVERAGES);
+
+    std::default_random_engine generator{5678};
+    std::uniform_real_distribution<double> distribution{0.0, 1.0};
+    for (int i = 0; i < 1000000; ++i)
+        Insert(1, 1e6 * distribution(generator));
+
+    double result = 0.0;
+    for (size_t i = 0; i < NOF_AVERAGES; ++i)
+        result = Insert(1, 1e-12);
+
+    DOUBLES_EQUAL(1e-12, result, 1e-18);
+}
+
+TEST_GROUP(ExponentialAverage)
+{
+    ExponentialAverage average;
+
+    double Insert(size_t size, double value)
+    {
+        double result = 0.0;
+        average.PrepareNewEntry(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            const double y = average.InsertAndAverage(i, value);
+            if (i == 0)
+                result = y;
+        }
+        return result;
+    }
+};
+
+TEST(ExponentialAverage, Cumulative)
+{
+    /* With zero averages, every entry since the last clear carries the same weight. */
+    average.SetNumberOfAverages(0);
+    double sum = 0.0;
+    for (int i = 1; i <= 100; ++i)
+    {
+        sum += static_cast<double>(i);
+        DOUBLES_EQUAL(sum / i, Insert(8, static_cast<double>(i)), 1e-12);
+    }
+}
+
+TEST(ExponentialAverage, Exponential)
+{
+    /* The first N entries are averaged uniformly, then the weight is 1/N. */
+    average.SetNumberOfAverages(4);
+    DOUBLES_EQUAL(4.0, Insert(8, 4.0), 1e-12);
+    DOUBLES_EQUAL(2.0, Insert(8, 0.0), 1e-12);
+    DOUBLES_EQUAL(3.0, Insert(8, 5.0), 1e-12);
+    DOUBLES_EQUAL(3.0, Insert(8, 3.0), 1e-12);
+    DOUBLES_EQUAL(3.0 + 0.25 * (7.0 - 3.0), Insert(8, 7.0), 1e-12);
+
+    /* A step settles towards the new value. */
+    double result = 0.0;
+    for (int i = 0; i < 200; ++i)
+        result = Insert(8, 10.0);
+    DOUBLES_EQUAL(10.0, result, 1e-9);
+}
+
+TEST(ExponentialAverage, Clear)
+{
+    average.SetNumberOfAverages(8);
+    Insert(8, 1.0);
+    Insert(8, 2.0);
+    average.Clear();
+    DOUBLES_EQUAL(7.0, Insert(8, 7.0), 1e-12);
+
+    /* A change of size or number of averages also restarts the averaging. */
+    DOUBLES_EQUAL(3.0, Insert(16, 3.0), 1e-12);
+    average.SetNumberOfAverages(2);
+    DOUBLES_EQUAL(5.0, Insert(16, 5.0), 1e-12);
+}
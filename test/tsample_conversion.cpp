@@ -0,0 +1,282 @@
+#include "sample_conversion.h"
+#include "CppUTest/TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+TEST_GROUP(SampleConversion)
+{
+    static constexpr double CODE_NORMALIZATION = 65536.0;
+    static constexpr double INPUT_RANGE = 500.0;
+    static constexpr double DC_OFFSET = 25.0;
+
+    std::default_random_engine generator{1234};
+
+    template <typename T>
+    std::vector<T> Random(size_t count)
+    {
+        std::uniform_int_distribution<int32_t> distribution{-32768, 32767};
+        std::vector<T> data(count);
+        for (auto &v : data)
+            v = static_cast<T>(distribution(generator));
+        return data;
+    }
+
+    std::vector<double> Window(size_t count)
+    {
+        std::vector<double> window(count);
+        for (size_t i = 0; i < count; ++i)
+            window[i] = 0.5 * (1.0 - std::cos(2.0 * M_PI * static_cast<double>(i) / count));
+        return window;
+    }
+
+    /* Compare every combination of options for every instruction set against
+       a straightforward evaluation. The trace is of type `U`. */
+    template <typename T, typename U = double>
+    void Check(size_t count, size_t nof_fft_samples)
+    {
+        const auto data = Random<T>(count);
+        const auto window = Window(nof_fft_samples);
+
+        for (const auto instruction_set : {SampleConversion::InstructionSet::SCALAR,
+                                           SampleConversion::InstructionSet::SSE41,
+                                           SampleConversion::InstructionSet::AVX2})
+        {
+            for (const bool convert_vertical : {false, true})
+            {
+                for (const bool with_window : {false, true})
+                {
+                    const SampleConversion conversion(CODE_NORMALIZATION, INPUT_RANGE, DC_OFFSET,
+                                                      convert_vertical, instruction_set);
+
+                    /* The sentinel value checks that we don't write past
+                       `nof_fft_samples`. */
+                    std::vector<U> y(count);
+                    std::vector<double> fft(count, -2.0);
+                    conversion.Convert(data.data(), count, y.data(), fft.data(), nof_fft_samples,
+                                       with_window ? window.data() : NULL);
+
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        const double code = static_cast<double>(data[i]);
+                        const double expected =
+                            convert_vertical
+                                ? (code / CODE_NORMALIZATION * INPUT_RANGE - DC_OFFSET) / 1e3
+                                : code;
+                        const bool single = std::is_same<U, float>::value;
+                        const double tolerance = single ? 1e-7 * (1.0 + std::abs(expected)) : 1e-12;
+                        DOUBLES_EQUAL(expected, y[i], tolerance);
+
+                        if (i < nof_fft_samples)
+                        {
+                            double unit = code / (CODE_NORMALIZATION / 2.0);
+                            if (with_window)
+                                unit *= window[i];
+                            DOUBLES_EQUAL(unit, fft[i], 1e-12);
+                        }
+                        else
+                        {
+                            DOUBLES_EQUAL(-2.0, fft[i], 0.0);
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+TEST(SampleConversion, Int16)
+{
+    Check<int16_t>(1024, 1024);
+    Check<int16_t>(1023, 1023);
+    Check<int16_t>(1027, 1000);
+    Check<int16_t>(3, 1);
+}
+
+TEST(SampleConversion, Int32)
+{
+    Check<int32_t>(1024, 1024);
+    Check<int32_t>(1023, 1023);
+    Check<int32_t>(1027, 1000);
+    Check<int32_t>(3, 1);
+}
+
+TEST(SampleConversion, SinglePrecision)
+{
+    Check<int16_t, float>(1024, 1024);
+    Check<int16_t, float>(1027, 1000);
+    Check<int32_t, float>(1023, 1023);
+    Check<int32_t, float>(3, 1);
+}
+
+TEST(SampleConversion, TraceOnly)
+{
+    const std::vector<int16_t> data{-32768, -1, 0, 1, 32767};
+    const SampleConversion conversion(CODE_NORMALIZATION, INPUT_RANGE, DC_OFFSET, false);
+    std::vector<double> y(data.size());
+    conversion.Convert(data.data(), data.size(), y.data(), NULL, data.size(), NULL);
+
+    for (size_t i = 0; i < data.size(); ++i)
+        DOUBLES_EQUAL(static_cast<double>(data[i]), y[i], 0.0);
+}
+
+TEST(SampleConversion, NoTrace)
+{
+    /* Without a trace, the transform input and the statistics are the same as
+       when the trace is written. */
+    constexpr size_t COUNT = 1027;
+    const auto data = Random<int16_t>(COUNT);
+    const auto window = Window(1000);
+
+    for (const auto instruction_set : {SampleConversion::InstructionSet::SCALAR,
+                                       SampleConversion::InstructionSet::SSE41,
+                                       SampleConversion::InstructionSet::AVX2})
+    {
+        const SampleConversion conversion(CODE_NORMALIZATION, INPUT_RANGE, DC_OFFSET, true,
+                                          instruction_set);
+        std::vector<double> y(COUNT);
+        std::vector<double> expected_fft(COUNT, -2.0);
+        SampleStatistics expected{};
+        conversion.Convert(data.data(), COUNT, y.data(), expected_fft.data(), window.size(),
+                           window.data(), &expected);
+
+        std::vector<double> fft(COUNT, -2.0);
+        SampleStatistics statistics{};
+        conversion.Convert(data.data(), COUNT, static_cast<double *>(NULL), fft.data(),
+                           window.size(), window.data(), &statistics);
+
+        for (size_t i = 0; i < COUNT; ++i)
+            DOUBLES_EQUAL(expected_fft[i], fft[i], 0.0);
+        LONGS_EQUAL(expected.count, statistics.count);
+        DOUBLES_EQUAL(expected.min, statistics.min, 0.0);
+        DOUBLES_EQUAL(expected.max, statistics.max, 0.0);
+        DOUBLES_EQUAL(expected.sum, statistics.sum, 0.0);
+        DOUBLES_EQUAL(expected.sum_of_squares, statistics.sum_of_squares, 0.0);
+    }
+}
+
+TEST(SampleConversion, Statistics)
+{
+    /* The statistics of the codes are the same for every instruction set and
+       every split between the transform input and the trace. */
+    constexpr size_t COUNT = 1027;
+    auto data = Random<int16_t>(COUNT);
+    data[5] = -32768;
+    data[17] = 32767;
+    data[COUNT - 1] = 32767;
+
+    double min = data[0];
+    double max = data[0];
+    double mean = 0.0;
+    size_t nof_clipped_low = 0;
+    size_t nof_clipped_high = 0;
+    for (const auto &code : data)
+    {
+        min = std::min(min, static_cast<double>(code));
+        max = std::max(max, static_cast<double>(code));
+        mean += static_cast<double>(code) / COUNT;
+        nof_clipped_low += (code == -32768) ? 1 : 0;
+        nof_clipped_high += (code == 32767) ? 1 : 0;
+    }
+
+    double variance = 0.0;
+    for (const auto &code : data)
+        variance += (code - mean) * (code - mean) / COUNT;
+
+    for (const auto instruction_set : {SampleConversion::InstructionSet::SCALAR,
+                                       SampleConversion::InstructionSet::SSE41,
+                                       SampleConversion::InstructionSet::AVX2})
+    {
+        for (const size_t nof_fft_samples : {size_t{0}, size_t{1000}, COUNT})
+        {
+            const SampleConversion conversion(CODE_NORMALIZATION, INPUT_RANGE, DC_OFFSET, true,
+                                              instruction_set);
+            std::vector<float> y(COUNT);
+            std::vector<double> fft(COUNT);
+            SampleStatistics statistics{};
+            conversion.Convert(data.data(), COUNT, y.data(), fft.data(), nof_fft_samples, NULL,
+                               &statistics);
+
+            LONGS_EQUAL(COUNT, statistics.count);
+            DOUBLES_EQUAL(min, statistics.min, 0.0);
+            DOUBLES_EQUAL(max, statistics.max, 0.0);
+            DOUBLES_EQUAL(mean, statistics.Mean(), 1e-9);
+            DOUBLES_EQUAL(variance, statistics.Variance(), 1e-6 * variance);
+            LONGS_EQUAL(nof_clipped_low, statistics.nof_clipped_low);
+            LONGS_EQUAL(nof_clipped_high, statistics.nof_clipped_high);
+        }
+    }
+
+    /* The trace is an affine transformation of the codes. */
+    const SampleConversion conversion(CODE_NORMALIZATION, INPUT_RANGE, DC_OFFSET, true);
+    DOUBLES_EQUAL(INPUT_RANGE / CODE_NORMALIZATION / 1e3, conversion.TraceScale(), 1e-15);
+    DOUBLES_EQUAL(-DC_OFFSET / 1e3, conversion.TraceOffset(), 1e-15);
+}
+
+TEST(SampleConversion, InstructionSet)
+{
+    /* We never go beyond what's supported. */
+    const auto supported = SampleConversion::GetSupportedInstructionSet();
+    const SampleConversion conversion(CODE_NORMALIZATION, INPUT_RANGE, DC_OFFSET, true,
+                                      SampleConversion::InstructionSet::AVX2);
+    CHECK(static_cast<int>(conversion.GetInstructionSet()) <= static_cast<int>(supported));
+}
+
+TEST(SampleConversion, Decibels)
+{
+    /* Compare against the library function over the dynamic range we expect to
+       see in a spectrum, including the edges of the mantissa intervals and
+       values the library function has to handle. Every instruction set must
+       produce the exact same result. */
+    constexpr size_t COUNT = 4099;
+    constexpr double OFFSET = -3.0;
+
+    std::uniform_real_distribution<double> distribution{-300.0, 10.0};
+    std::vector<double> power(COUNT);
+    for (auto &p : power)
+        p = std::pow(10.0, distribution(generator));
+
+    power[0] = 1.0;
+    power[1] = M_SQRT2;
+    power[2] = std::nextafter(M_SQRT2, 2.0);
+    power[3] = 0.5 * M_SQRT2;
+    power[4] = std::numeric_limits<double>::min();
+    power[5] = std::numeric_limits<double>::max();
+    power[6] = 0.0;
+    power[7] = std::numeric_limits<double>::denorm_min();
+    power[8] = std::numeric_limits<double>::infinity();
+    power[COUNT - 1] = 0.0;
+
+    std::vector<double> reference(COUNT);
+    SampleConversion::Decibels(power.data(), COUNT, OFFSET, reference.data(),
+                               SampleConversion::InstructionSet::SCALAR);
+
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        const double expected = 10.0 * std::log10(power[i]) + OFFSET;
+        if (std::isinf(expected))
+            CHECK(expected == reference[i]);
+        else
+            DOUBLES_EQUAL(expected, reference[i], 1e-11);
+    }
+
+    for (const auto instruction_set : {SampleConversion::InstructionSet::SSE41,
+                                       SampleConversion::InstructionSet::AVX2})
+    {
+        std::vector<double> y(COUNT);
+        std::vector<float> y_single(COUNT);
+        SampleConversion::Decibels(power.data(), COUNT, OFFSET, y.data(), instruction_set);
+        SampleConversion::Decibels(power.data(), COUNT, OFFSET, y_single.data(), instruction_set);
+
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            CHECK(std::memcmp(&reference[i], &y[i], sizeof(double)) == 0);
+            CHECK(static_cast<float>(reference[i]) == y_single[i]);
+        }
+    }
+}
@@ -107,4 +107,9 @@ TEST(SineGenerator, RepeatedStartStop)
 
         LONGS_EQUAL(SCAPE_EOK, generator.PushMessageWaitForResponse({GeneratorMessageId::DISABLE}));
     }
+
+    /* The returned records are recycled. */
+    const auto statistics = generator.GetBufferPoolStatistics();
+    CHECK(statistics.nof_hits > 0);
+    CHECK(statistics.nof_buffers_held <= statistics.capacity);
 }
@@ -0,0 +1,163 @@
+#include <thread>
+#include <chrono>
+#include <memory>
+#include "spsc_queue.h"
+
+#include "CppUTest/TestHarness.h"
+
+TEST_GROUP(SpscQueue)
+{
+    SpscQueue<int> queue{10};
+
+    void teardown()
+    {
+        queue.Stop();
+    }
+};
+
+TEST(SpscQueue, StartStop)
+{
+    LONGS_EQUAL(SCAPE_ENOTREADY, queue.Stop());
+    LONGS_EQUAL(SCAPE_EOK, queue.Start());
+    LONGS_EQUAL(SCAPE_ENOTREADY, queue.Start());
+    LONGS_EQUAL(SCAPE_EOK, queue.Stop());
+
+    SpscQueue<int> unbounded{0};
+    LONGS_EQUAL(SCAPE_EINVAL, unbounded.Start());
+    SpscQueue<int> persistent{10, true};
+    LONGS_EQUAL(SCAPE_EUNSUPPORTED, persistent.Start());
+}
+
+TEST(SpscQueue, Capacity)
+{
+    LONGS_EQUAL(SCAPE_EOK, queue.Start());
+    CHECK(queue.IsEmpty());
+
+    /* The capacity is exact even though the ring is rounded up to 16 slots. */
+    for (int i = 0; i < 10; ++i)
+        LONGS_EQUAL(SCAPE_EOK, queue.Write(i));
+    CHECK(queue.IsFull());
+    DOUBLES_EQUAL(1.0, queue.GetOccupancy(), 0.0);
+    LONGS_EQUAL(SCAPE_EAGAIN, queue.Write(10));
+    LONGS_EQUAL(SCAPE_EAGAIN, queue.Write(10, 20));
+
+    int value = 0;
+    for (int i = 0; i < 5; ++i)
+    {
+        LONGS_EQUAL(SCAPE_EOK, queue.Read(value, 0));
+        LONGS_EQUAL(i, value);
+    }
+    DOUBLES_EQUAL(0.5, queue.GetOccupancy(), 0.0);
+
+    /* Wrap around the ring. */
+    for (int i = 10; i < 15; ++i)
+        LONGS_EQUAL(SCAPE_EOK, queue.Write(i));
+    for (int i = 5; i < 15; ++i)
+    {
+        LONGS_EQUAL(SCAPE_EOK, queue.Read(value, 0));
+        LONGS_EQUAL(i, value);
+    }
+
+    LONGS_EQUAL(SCAPE_EAGAIN, queue.Read(value, 0));
+    CHECK(queue.IsEmpty());
+
+    int milliseconds = -1;
+    LONGS_EQUAL(SCAPE_EOK, queue.GetTimeSinceLastActivity(milliseconds));
+    CHECK(milliseconds >= 0);
+}
+
+TEST(SpscQueue, Restart)
+{
+    /* Restarting the queue discards the entries, releasing them on the next read. */
+    SpscQueue<std::shared_ptr<int>> pointers{4};
+    LONGS_EQUAL(SCAPE_EOK, pointers.Start());
+
+    auto entry = std::make_shared<int>(1);
+    LONGS_EQUAL(SCAPE_EOK, pointers.Write(entry));
+    LONGS_EQUAL(SCAPE_EOK, pointers.Write(entry));
+    LONGS_EQUAL(3, entry.use_count());
+
+    LONGS_EQUAL(SCAPE_EOK, pointers.Stop());
+    LONGS_EQUAL(SCAPE_EOK, pointers.Start());
+    CHECK(pointers.IsEmpty());
+    LONGS_EQUAL(SCAPE_EOK, pointers.Write(std::make_shared<int>(2)));
+
+    std::shared_ptr<int> value;
+    LONGS_EQUAL(SCAPE_EOK, pointers.Read(value, 0));
+    LONGS_EQUAL(2, *value);
+    LONGS_EQUAL(1, entry.use_count());
+    LONGS_EQUAL(SCAPE_EOK, pointers.Stop());
+}
+
+TEST(SpscQueue, RestartFull)
+{
+    /* The slots of the discarded entries become available to the producer as
+       soon as a blocked reader has skipped past them. */
+    LONGS_EQUAL(SCAPE_EOK, queue.Start());
+    for (int i = 0; i < 10; ++i)
+        LONGS_EQUAL(SCAPE_EOK, queue.Write(i));
+    LONGS_EQUAL(SCAPE_EOK, queue.Stop());
+    LONGS_EQUAL(SCAPE_EOK, queue.Start());
+
+    int value = -1;
+    std::thread reader([&]() { LONGS_EQUAL(SCAPE_EOK, queue.Read(value, 2000)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int i = 10; i < 20; ++i)
+        LONGS_EQUAL(SCAPE_EOK, queue.Write(i));
+    reader.join();
+    LONGS_EQUAL(10, value);
+    LONGS_EQUAL(SCAPE_EOK, queue.Stop());
+}
+
+TEST(SpscQueue, Transfer)
+{
+    /* Stream values through the queue with both sides blocking, expecting
+       every value to arrive in order. */
+    constexpr int COUNT = 100000;
+    LONGS_EQUAL(SCAPE_EOK, queue.Start());
+
+    std::thread producer([&]() {
+        for (int i = 0; i < COUNT; ++i)
+            LONGS_EQUAL(SCAPE_EOK, queue.Write(i, -1));
+    });
+
+    int value = -1;
+    for (int i = 0; i < COUNT; ++i)
+    {
+        LONGS_EQUAL(SCAPE_EOK, queue.Read(value, 1000));
+        LONGS_EQUAL(i, value);
+    }
+
+    producer.join();
+    LONGS_EQUAL(SCAPE_EOK, queue.Stop());
+}
+
+TEST(SpscQueue, AbruptStop)
+{
+    LONGS_EQUAL(SCAPE_EOK, queue.Start());
+    std::thread aborter([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        LONGS_EQUAL(SCAPE_EOK, queue.Stop());
+    });
+
+    int value = 0;
+    LONGS_EQUAL(SCAPE_EINTERRUPTED, queue.Read(value, -1));
+    aborter.join();
+}
+
+TEST(SpscQueue, StopRacingRead)
+{
+    /* A stop that lands between the reader's start check and its wait must
+       not leave the reader blocked. */
+    for (int i = 0; i < 1000; ++i)
+    {
+        LONGS_EQUAL(SCAPE_EOK, queue.Start());
+        std::thread aborter([&]() { LONGS_EQUAL(SCAPE_EOK, queue.Stop()); });
+
+        int value = 0;
+        const int result = queue.Read(value, -1);
+        CHECK(result == SCAPE_ENOTREADY || result == SCAPE_EINTERRUPTED);
+        aborter.join();
+    }
+}
@@ -196,3 +196,80 @@ TEST(ThreadSafeQueue, ReadPredicate)
 
     LONGS_EQUAL(SCAPE_EOK, queue.Stop());
 }
+
+TEST(ThreadSafeQueue, Timeout)
+{
+    LONGS_EQUAL(SCAPE_EOK, capped_queue.Start());
+
+    /* The timeout is measured in elapsed time, for reads and writes alike. */
+    int value = 0;
+    auto start = std::chrono::steady_clock::now();
+    LONGS_EQUAL(SCAPE_EAGAIN, capped_queue.Read(value, 50));
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50));
+
+    for (int i = 0; i < 10; ++i)
+        LONGS_EQUAL(SCAPE_EOK, capped_queue.Write(i));
+
+    start = std::chrono::steady_clock::now();
+    LONGS_EQUAL(SCAPE_EAGAIN, capped_queue.Write(10, 50));
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50));
+
+    LONGS_EQUAL(SCAPE_EOK, capped_queue.Stop());
+}
+
+TEST(ThreadSafeQueue, AbruptStopWriter)
+{
+    LONGS_EQUAL(SCAPE_EOK, capped_queue.Start());
+    for (int i = 0; i < 10; ++i)
+        LONGS_EQUAL(SCAPE_EOK, capped_queue.Write(i));
+
+    std::thread aborter([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        LONGS_EQUAL(SCAPE_EOK, capped_queue.Stop());
+    });
+
+    LONGS_EQUAL(SCAPE_EINTERRUPTED, capped_queue.Write(10, -1));
+    aborter.join();
+}
+
+TEST(ThreadSafeQueue, PredicateWakeup)
+{
+    /* Two readers blocking on different entries both get woken up, regardless
+       of the order in which the entries arrive. */
+    LONGS_EQUAL(SCAPE_EOK, queue.Start());
+
+    int first = 0;
+    int second = 0;
+    std::thread first_reader([&]() {
+        LONGS_EQUAL(SCAPE_EOK, queue.Read(first, 2000, [](const int &e) { return e == 1; }));
+    });
+    std::thread second_reader([&]() {
+        LONGS_EQUAL(SCAPE_EOK, queue.Read(second, 2000, [](const int &e) { return e == 2; }));
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    LONGS_EQUAL(SCAPE_EOK, queue.Write(2));
+    LONGS_EQUAL(SCAPE_EOK, queue.Write(1));
+
+    first_reader.join();
+    second_reader.join();
+    LONGS_EQUAL(1, first);
+    LONGS_EQUAL(2, second);
+    LONGS_EQUAL(SCAPE_EOK, queue.Stop());
+}
+
+TEST(ThreadSafeQueue, StopRacingRead)
+{
+    /* A stop that lands between the reader's start check and its wait must
+       not leave the reader blocked. */
+    for (int i = 0; i < 1000; ++i)
+    {
+        LONGS_EQUAL(SCAPE_EOK, queue.Start());
+        std::thread aborter([&]() { LONGS_EQUAL(SCAPE_EOK, queue.Stop()); });
+
+        int value = 0;
+        const int result = queue.Read(value, -1);
+        CHECK(result == SCAPE_ENOTREADY || result == SCAPE_EINTERRUPTED);
+        aborter.join();
+    }
+}
@@ -0,0 +1,138 @@
+#include "data_types.h"
+#include "CppUTest/TestHarness.h"
+
+#include <vector>
+
+TEST_GROUP(Waterfall)
+{
+    /* Insert a row of `size` values, all set to `value`. */
+    uint64_t Insert(Waterfall &waterfall, size_t size, RecordValue value)
+    {
+        const std::vector<RecordValue> y(size, value);
+        return waterfall.Insert(y.data(), y.size());
+    }
+
+    /* Get the first value of each row in the view, newest first. */
+    std::vector<RecordValue> Rows(const Waterfall &waterfall, uint64_t sequence)
+    {
+        const auto lock = waterfall.Lock();
+        Waterfall::Span first;
+        Waterfall::Span second;
+        const size_t nof_rows = waterfall.GetSpans(sequence, first, second);
+        LONGS_EQUAL(nof_rows, first.rows + second.rows);
+
+        std::vector<RecordValue> result{};
+        for (const auto &span : {first, second})
+        {
+            for (size_t i = 0; i < span.rows; ++i)
+                result.push_back(span.data[i * waterfall.columns]);
+        }
+        return result;
+    }
+};
+
+TEST(Waterfall, InsertOrder)
+{
+    Waterfall waterfall(4, 8, 8, 0.0, 1.0);
+    LONGS_EQUAL(8, waterfall.columns);
+    LONGS_EQUAL(1, waterfall.decimation);
+    CHECK(Rows(waterfall, 0).empty());
+
+    LONGS_EQUAL(1, Insert(waterfall, 8, 1));
+    LONGS_EQUAL(2, Insert(waterfall, 8, 2));
+    LONGS_EQUAL(3, Insert(waterfall, 8, 3));
+
+    const auto rows = Rows(waterfall, 3);
+    LONGS_EQUAL(3, rows.size());
+    DOUBLES_EQUAL(3, rows[0], 0);
+    DOUBLES_EQUAL(2, rows[1], 0);
+    DOUBLES_EQUAL(1, rows[2], 0);
+}
+
+TEST(Waterfall, Wrap)
+{
+    Waterfall waterfall(4, 8, 8, 0.0, 1.0);
+    for (int i = 1; i <= 10; ++i)
+        Insert(waterfall, 8, static_cast<RecordValue>(i));
+
+    /* Only the four newest rows remain, split over two spans after the wrap. */
+    const auto lock = waterfall.Lock();
+    Waterfall::Span first;
+    Waterfall::Span second;
+    LONGS_EQUAL(4, waterfall.GetSpans(10, first, second));
+    LONGS_EQUAL(2, first.rows);
+    LONGS_EQUAL(2, second.rows);
+    DOUBLES_EQUAL(10, first.data[0], 0);
+    DOUBLES_EQUAL(9, first.data[waterfall.columns], 0);
+    DOUBLES_EQUAL(8, second.data[0], 0);
+    DOUBLES_EQUAL(7, second.data[waterfall.columns], 0);
+}
+
+TEST(Waterfall, Bounds)
+{
+    /* The columns of a zoomed in spectrum cover its bins, wherever they are. */
+    Waterfall waterfall(4, 101, 1024, 1e6, 100.0);
+    LONGS_EQUAL(101, waterfall.columns);
+    DOUBLES_EQUAL(1e6 - 50.0, waterfall.x_min, 1e-6);
+    DOUBLES_EQUAL(1e6 + 100 * 100.0 + 50.0, waterfall.x_max, 1e-6);
+}
+
+TEST(Waterfall, Copy)
+{
+    Waterfall waterfall(4, 8, 8, 0.0, 1.0);
+    for (int i = 1; i <= 10; ++i)
+        Insert(waterfall, 8, static_cast<RecordValue>(i));
+
+    /* The copy joins the spans on either side of the wrap, newest first. */
+    std::vector<RecordValue> data{};
+    LONGS_EQUAL(3, waterfall.Copy(9, data));
+    LONGS_EQUAL(3 * waterfall.columns, data.size());
+    for (size_t row = 0; row < 3; ++row)
+    {
+        for (size_t c = 0; c < waterfall.columns; ++c)
+            DOUBLES_EQUAL(9 - static_cast<double>(row), data[row * waterfall.columns + c], 0);
+    }
+
+    LONGS_EQUAL(0, waterfall.Copy(6, data));
+    CHECK(data.empty());
+}
+
+TEST(Waterfall, OlderSequence)
+{
+    Waterfall waterfall(4, 8, 8, 0.0, 1.0);
+    for (int i = 1; i <= 5; ++i)
+        Insert(waterfall, 8, static_cast<RecordValue>(i));
+
+    /* The view of an older record excludes both the newer rows and the rows
+       they've overwritten. */
+    const auto rows = Rows(waterfall, 3);
+    LONGS_EQUAL(2, rows.size());
+    DOUBLES_EQUAL(3, rows[0], 0);
+    DOUBLES_EQUAL(2, rows[1], 0);
+
+    CHECK(Rows(waterfall, 1).empty());
+    CHECK(Rows(waterfall, 6).empty());
+}
+
+TEST(Waterfall, Decimation)
+{
+    Waterfall waterfall(2, 10, 4, 0.0, 1.0);
+    LONGS_EQUAL(3, waterfall.decimation);
+    LONGS_EQUAL(4, waterfall.columns);
+
+    /* The last column covers a partial group of bins. */
+    DOUBLES_EQUAL(-0.5, waterfall.x_min, 1e-12);
+    DOUBLES_EQUAL(11.5, waterfall.x_max, 1e-12);
+
+    std::vector<RecordValue> y{1, 5, 2, 0, 0, 7, 3, 3, 3, 9};
+    waterfall.Insert(y.data(), y.size());
+
+    const auto lock = waterfall.Lock();
+    Waterfall::Span first;
+    Waterfall::Span second;
+    LONGS_EQUAL(1, waterfall.GetSpans(1, first, second));
+    DOUBLES_EQUAL(5, first.data[0], 0);
+    DOUBLES_EQUAL(7, first.data[1], 0);
+    DOUBLES_EQUAL(3, first.data[2], 0);
+    DOUBLES_EQUAL(9, first.data[3], 0);
+}
@@ -0,0 +1,202 @@
+#include "worker_pool.h"
+#include "error.h"
+#include "CppUTest/TestHarness.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+TEST_GROUP(WorkerPool)
+{
+};
+
+TEST(WorkerPool, ParallelFor)
+{
+    /* Every index is visited exactly once, for any number of threads. */
+    for (const size_t nof_threads : {0, 1, 3})
+    {
+        WorkerPool pool(nof_threads);
+        LONGS_EQUAL(nof_threads + 1, pool.GetConcurrency());
+
+        for (const size_t count : {0, 1, 2, 7, 1000})
+        {
+            std::vector<std::atomic<int>> visits(count);
+            pool.ParallelFor(count, [&](size_t begin, size_t end) {
+                CHECK(begin < end);
+                for (size_t i = begin; i < end; ++i)
+                    visits[i]++;
+            });
+
+            for (const auto &v : visits)
+                LONGS_EQUAL(1, v.load());
+        }
+    }
+}
+
+TEST(WorkerPool, Nested)
+{
+    /* A call from within a parallel region must not deadlock, even if every
+       thread of the pool is busy. */
+    WorkerPool pool(2);
+    std::atomic<size_t> sum{0};
+    pool.ParallelFor(8, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            pool.ParallelFor(100, [&](size_t inner_begin, size_t inner_end) {
+                sum += inner_end - inner_begin;
+            });
+        }
+    });
+
+    LONGS_EQUAL(800, sum.load());
+}
+
+TEST(WorkerPool, Shared)
+{
+    const auto pool = WorkerPool::Shared();
+    CHECK(pool != NULL);
+    CHECK(pool == WorkerPool::Shared());
+    CHECK(pool->GetConcurrency() >= 1);
+}
+
+TEST(WorkerPool, Post)
+{
+    /* Without any threads, the task runs on the calling thread. */
+    for (const size_t nof_threads : {0, 1, 4})
+    {
+        WorkerPool pool(nof_threads);
+        std::mutex mutex;
+        std::condition_variable signal;
+        size_t nof_completed = 0;
+
+        constexpr size_t NOF_TASKS = 1000;
+        for (size_t i = 0; i < NOF_TASKS; ++i)
+        {
+            pool.Post([&]() {
+                std::unique_lock lock{mutex};
+                if (++nof_completed == NOF_TASKS)
+                    signal.notify_all();
+            });
+        }
+
+        std::unique_lock lock{mutex};
+        CHECK(signal.wait_for(lock, std::chrono::seconds(5),
+                              [&] { return nof_completed == NOF_TASKS; }));
+    }
+}
+
+TEST(WorkerPool, Strand)
+{
+    /* Tasks posted to a strand run one at a time in order, while the strands
+       themselves are spread over the pool. */
+    auto pool = std::make_shared<WorkerPool>(4);
+    constexpr size_t NOF_STRANDS = 8;
+    constexpr size_t NOF_TASKS = 500;
+
+    std::vector<std::unique_ptr<WorkerPool::Strand>> strands;
+    std::vector<std::vector<size_t>> order(NOF_STRANDS);
+    std::vector<std::atomic<int>> active(NOF_STRANDS);
+    std::atomic<bool> overlap{false};
+    std::atomic<size_t> nof_completed{0};
+
+    for (size_t s = 0; s < NOF_STRANDS; ++s)
+        strands.push_back(std::make_unique<WorkerPool::Strand>(pool));
+
+    for (size_t i = 0; i < NOF_TASKS; ++i)
+    {
+        for (size_t s = 0; s < NOF_STRANDS; ++s)
+        {
+            strands[s]->Post([&, s, i]() {
+                if (active[s]++ != 0)
+                    overlap = true;
+                order[s].push_back(i);
+
+                /* Data parallel work from within a strand must not deadlock. */
+                if (i % 100 == 0)
+                    pool->ParallelFor(64, [](size_t, size_t) {});
+
+                active[s]--;
+                nof_completed++;
+            });
+        }
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (nof_completed < NOF_STRANDS * NOF_TASKS && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    LONGS_EQUAL(NOF_STRANDS * NOF_TASKS, nof_completed.load());
+    CHECK(!overlap);
+    for (const auto &o : order)
+    {
+        LONGS_EQUAL(NOF_TASKS, o.size());
+        for (size_t i = 0; i < o.size(); ++i)
+            LONGS_EQUAL(i, o[i]);
+    }
+}
+
+TEST(WorkerPool, StrandFairness)
+{
+    /* A strand that always has tasks queued must not hold on to the only
+       worker, starving the other strands. */
+    auto pool = std::make_shared<WorkerPool>(1);
+    WorkerPool::Strand busy(pool);
+    WorkerPool::Strand other(pool);
+    std::atomic<bool> should_stop{false};
+    std::atomic<bool> has_run{false};
+    std::atomic<int> nof_pending{0};
+
+    std::function<void()> Work = [&]() {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        if (!should_stop)
+        {
+            nof_pending++;
+            busy.Post(Work);
+        }
+        nof_pending--;
+    };
+
+    /* Keep two tasks in flight. */
+    nof_pending += 2;
+    busy.Post(Work);
+    busy.Post(Work);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    other.Post([&]() { has_run = true; });
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!has_run && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    const bool has_run_while_busy = has_run;
+    should_stop = true;
+    while (nof_pending > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    CHECK(has_run_while_busy);
+}
+
+TEST(WorkerPool, Affinity)
+{
+    /* Pinning the threads must not prevent them from doing any work. */
+    WorkerPool pool(2, {0});
+    std::atomic<size_t> sum{0};
+    pool.ParallelFor(100, [&](size_t begin, size_t end) { sum += end - begin; });
+    LONGS_EQUAL(100, sum.load());
+}
+
+TEST(WorkerPool, ParseCpuList)
+{
+    std::vector<int> cpus;
+    LONGS_EQUAL(SCAPE_EOK, WorkerPool::ParseCpuList("3", cpus));
+    CHECK(std::vector<int>({3}) == cpus);
+    LONGS_EQUAL(SCAPE_EOK, WorkerPool::ParseCpuList("0,2-4,7", cpus));
+    CHECK(std::vector<int>({0, 2, 3, 4, 7}) == cpus);
+
+    for (const auto *str : {"", "a", "1-", "-1", "4-2", "1,,2", "1-2-3", "1x"})
+        LONGS_EQUAL(SCAPE_EINVAL, WorkerPool::ParseCpuList(str, cpus));
+
+    /* The output is left untouched on failure. */
+    CHECK(std::vector<int>({0, 2, 3, 4, 7}) == cpus);
+}